@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 /*! \file json.h
  * The file contains public api of retro-json library.
@@ -12,6 +13,10 @@
  * Opaque structure that generalizes values of all possible kinds of json.
  */
 struct jsonValue;
+struct jsonSnapshot;
+struct jsonWriter;
+struct jsonPointer;
+struct jsonQuery;
 
 /*!
  * \brief Release memory held by the value.
@@ -27,9 +32,130 @@ bool json_init(void);
 
 /*!
  * \brief Release library resources.
+ * \details Memory of values is released too, so every value must be freed with json_value_free() before, and no
+ * other thread may use the library while the function runs. Debug builds assert that no value is left.
  */
 void json_exit(void);
 
+/*!
+ * \brief Memory allocator the library uses for everything it allocates.
+ * \details Functions behave like malloc(), realloc() and free() of the C library and get context as the first argument.
+ */
+struct jsonAllocator {
+    void *(*allocate)(void *context, size_t size); //!< Returns NULL on failure.
+    void *(*reallocate)(void *context, void *ptr, size_t size); //!< Returns NULL on failure, ptr stays valid then.
+    void (*release)(void *context, void *ptr); //!< Ignores NULL ptr.
+    void *context; //!< Passed to the functions as is.
+};
+
+/*!
+ * \brief Replace memory allocator.
+ * \details Allocator is global. Memory is always released by the allocator that is set at that moment, so replace it
+ * before json_init() or while the library holds no memory, i.e. after json_exit(). The function is not thread safe.
+ * \param allocator New allocator, which is copied. NULL restores the C library allocator.
+ * \return False if some function of the allocator is missing, true otherwise.
+ */
+bool json_set_allocator(const struct jsonAllocator *allocator);
+
+/*! \name Allocation tracking
+ *
+ * The library can put a small header in front of every block it allocates and collect statistics per call site in
+ * its sources: numbers of allocations, reallocations and frees, bytes requested, and bytes that are live now and were
+ * live at most. Sampling limits the cost to one allocation in a given number per thread, other blocks only get a
+ * header. Tracking is off by default in release builds. It must be switched on before the first allocation, i.e.
+ * before json_init(). Debug builds always track every allocation, to check for leaks.
+ *
+ * \{ */
+
+/*!
+ * \brief Statistics of one call site that allocates memory.
+ */
+struct jsonAllocationSite {
+    const char *file; //!< Source file of the library.
+    int line; //!< Line in file.
+    size_t allocations; //!< Number of sampled blocks allocated here.
+    size_t reallocations; //!< Number of sampled blocks resized here. Resized block is attributed to this site.
+    size_t frees; //!< Number of blocks attributed to the site that were freed.
+    size_t bytes; //!< Bytes requested by allocations and reallocations.
+    size_t live_bytes; //!< Bytes of blocks attributed to the site that are not freed yet.
+    size_t peak_live_bytes; //!< Maximum of live_bytes over time.
+    size_t live_blocks; //!< Number of blocks attributed to the site that are not freed yet.
+};
+
+/*!
+ * \brief Switch allocation tracking on or off.
+ * \details Only the sampling period may be changed after the first allocation. The function is not thread safe.
+ * \param sample_period Track one allocation in that many, 0 switches tracking off.
+ * \return Was it successful or not.
+ */
+bool json_track_allocations(unsigned sample_period);
+
+/*!
+ * \brief Take snapshot of the statistics.
+ * \param out Array for the statistics or NULL.
+ * \param size Size of out array. The function doesn't write more entries than that.
+ * \returns Number of call sites with statistics, which may be greater than size.
+ */
+size_t json_allocation_sites(struct jsonAllocationSite *out, size_t size);
+
+/*!
+ * \brief Print the statistics as a table, one call site per line.
+ * \param out Where to print.
+ */
+void json_allocation_dump(FILE *out);
+
+/*! \} */
+
+/*! \name Memory usage
+ *
+ * Footprint of a tree broken down by what the bytes are spent on. Nodes and object keys come from pools, so they're
+ * counted as objects; everything else is a block of its own. Sizes are what the library asked for, allocator
+ * overhead isn't included. Shared values are counted in every tree that refers to them.
+ *
+ * \{ */
+
+/*!
+ * \brief Bytes a tree takes, by category.
+ */
+struct jsonMemoryUsage {
+    size_t nodes; //!< Number of nodes.
+    size_t node_bytes; //!< Bytes of nodes.
+    size_t keys; //!< Number of object keys.
+    size_t key_bytes; //!< Bytes of key headers, their text is counted as string bytes.
+    size_t string_bytes; //!< Bytes of text in strings and keys, including terminating nulls.
+    size_t string_unused_bytes; //!< Capacity of string buffers beyond their text.
+    size_t array_bytes; //!< Bytes of array slots that hold elements.
+    size_t array_unused_bytes; //!< Bytes of array slots beyond the size.
+    size_t entry_bytes; //!< Bytes of object table entries that hold fields.
+    size_t entry_empty_bytes; //!< Bytes of object table entries that were never used.
+    size_t entry_deleted_bytes; //!< Bytes of object table entries left by deleted fields.
+    size_t allocations; //!< Number of blocks, not counting pooled nodes and keys.
+    size_t total_bytes; //!< Sum of all the bytes above.
+};
+
+/*!
+ * \brief Measure the memory a tree takes.
+ * \details Snapshot values aren't supported, their memory belongs to the snapshot.
+ * \param value Root of the tree.
+ * \param usage Where to put the report.
+ * \return Was it successful or not.
+ */
+bool json_memory_usage(struct jsonValue *value, struct jsonMemoryUsage *usage);
+
+/*!
+ * \brief Trim a tree to its size and lay its nodes out anew for locality.
+ * \details Nodes and key headers are moved to two runs of fresh memory in depth-first order, next to their parents.
+ * The root stays where it is, pointers to any other node of the tree become invalid. The rest is only trimmed, not
+ * gathered: arrays, string text and object tables each get a block of their own of exactly the size they need, placed
+ * wherever the allocator puts it, and objects lose deleted entries. Shared values are left where they are. Snapshot
+ * values aren't supported, json_snapshot_encode() lays out a whole tree in one block.
+ * \param value Root of the tree.
+ * \return Was it successful or not. The tree stays valid on failure, but may be compacted only partially.
+ */
+bool json_compact(struct jsonValue *value);
+
+/*! \} */
+
 /*!
  * \brief Types of json values.
  */
@@ -61,6 +187,7 @@ struct jsonValue *json_create_string(const char *string);
 
 /*!
  * \brief Construct json node of type JVK_OBJ.
+ * \details Objects hold fewer than 2^31 members, creating or growing one beyond that fails with JSON_ERROR_LIMIT.
  * \param initial_capacity Estimated number of entries expected to be in the object. Might be zero.
  * \return Created node.
  */
@@ -180,7 +307,8 @@ size_t json_object_number_of_values(struct jsonValue *object);
 
 /*!
  * \brief Add field to the object.
- * \details Object is a multimap so you can add multiple values at the same key.
+ * \details Object is a multimap so you can add multiple values at the same key. Snapshot values can't be added,
+ * copy them with json_copy() first.
  * \param object Json value of type JVK_OBJ.
  * \param key Name of the field.
  * \param value New value of the field.
@@ -258,6 +386,7 @@ struct jsonValue *json_object_lookup_next(struct jsonValue *object, const char *
 
 /*!
  * \brief Add \p value to the end of array.
+ * \details Snapshot values can't be added, copy them with json_copy() first.
  * \param array Where to add.
  * \param value What value to add.
  * \return Success or not.
@@ -281,6 +410,45 @@ struct jsonValue *json_array_at(struct jsonValue *array, size_t index);
 
 /*! \} */
 
+/*!
+ * \brief Nesting depth of objects and arrays the parser accepts unless told otherwise.
+ */
+#define JSON_DEFAULT_MAX_DEPTH 128
+
+/*!
+ * \brief Nesting depth json_bind() accepts whatever the options say.
+ * \details Binding recurses once per level of structs and arrays, self-referential schemas reached through arrays
+ * included, so deeper input fails with JSON_ERROR_LIMIT.
+ */
+#define JSON_BIND_MAX_DEPTH 1024
+
+/*!
+ * \brief Encodings of text the parser reads. Strings of parsed values are UTF-8 whatever the input is.
+ */
+enum jsonEncoding {
+    JSON_ENCODING_AUTO, //!< Told by a byte order mark, or by zero bytes around the first character, or else UTF-8.
+    JSON_ENCODING_UTF8, //!< UTF-8
+    JSON_ENCODING_UTF16LE, //!< UTF-16, little endian
+    JSON_ENCODING_UTF16BE, //!< UTF-16, big endian
+    JSON_ENCODING_UTF32LE, //!< UTF-32, little endian
+    JSON_ENCODING_UTF32BE //!< UTF-32, big endian
+};
+
+/*!
+ * \brief How json_parse_with() parses text.
+ * \details Zero initialized options require the whole input to be one value nested at most JSON_DEFAULT_MAX_DEPTH
+ * levels deep, with strings that are well-formed UTF-8. Escaped surrogates must come in pairs then, since half a pair
+ * can't be written as UTF-8. The encoding is detected, so UTF-16 and UTF-32 input is parsed as it is. Offsets of
+ * errors count bytes, columns count characters.
+ */
+struct jsonParseOptions {
+    size_t max_depth; //!< Maximum number of objects and arrays nested in each other, 0 means JSON_DEFAULT_MAX_DEPTH.
+    bool allow_trailing_bytes; //!< Stop after the first value instead of requiring it to take the whole input.
+    bool trusted_utf8; //!< Don't check that strings are well-formed UTF-8, for input known to be.
+    enum jsonEncoding encoding; //!< Encoding of the input. A byte order mark of that encoding is skipped.
+    bool share_equal_values; //!< Make equal values below the root share one node, see json_parse_with().
+};
+
 /*!
  * \brief Parse json from string.
  * \param json UTF-8 encoded null terminated string.
@@ -293,7 +461,7 @@ struct jsonValue *json_parse(const char *json, bool all);
 
 /*!
  * \brief Parse json from memory buffer.
- * \param buffer UTF-8 encoded and NOT NULL TERMINATED.
+ * \param buffer UTF-8, UTF-16 or UTF-32 encoded, see JSON_ENCODING_AUTO, and NOT NULL TERMINATED.
  * \param size Size of buffer.
  * \param all Is it required to parse whole buffer or unparsed trailing bytes are allowed.
  * \return
@@ -302,10 +470,121 @@ struct jsonValue *json_parse(const char *json, bool all);
  */
 struct jsonValue *json_parse_mem(const char *buffer, size_t size, bool all);
 
+/*!
+ * \brief Parse json from memory buffer the way options say.
+ * \details The parser doesn't recurse, so deep documents only cost heap memory. Freeing, copying, sharing, printing
+ * and json_memory_usage() don't recurse either. Comparing, hashing, diffing, compacting and binary encoders recurse
+ * once per level, so trees much deeper than JSON_DEFAULT_MAX_DEPTH may exhaust the stack there.
+ *
+ * With share_equal_values set, equal values met anywhere below the root, containers and scalars alike, are parsed into
+ * one node shared the way json_copy_shared() shares them, which saves memory on documents that repeat themselves.
+ * Everything below the root is sealed then: it can be read by several threads at once, and changed only through
+ * json_object_lookup_mut() and json_array_at_mut(). Equal values are found through their kept hashes, see
+ * json_hash(), at the cost of a table of all the different values while parsing.
+ * \param buffer Encoded as options say and NOT NULL TERMINATED.
+ * \param size Size of buffer.
+ * \param options How to parse. NULL means zero initialized options.
+ * \return
+ * - parsed value;
+ * - NULL, if something went wrong.
+ */
+struct jsonValue *json_parse_with(const char *buffer, size_t size, const struct jsonParseOptions *options);
+
+/*!
+ * \brief What json_validate() found out about valid input.
+ */
+struct jsonValidation {
+    size_t depth; //!< Deepest nesting of objects and arrays, 0 for a scalar.
+    size_t end; //!< Offset of the first byte after the value, spaces after it not included.
+};
+
+/*!
+ * \brief Check that buffer holds well-formed json without building it.
+ * \details Accepts exactly what json_parse_with() does, but allocates no values and copies neither strings nor
+ * numbers. Only documents nested deeper than a few thousand levels make it allocate a little memory. Errors are
+ * reported the same way as by the parser.
+ * \param buffer Encoded as options say and NOT NULL TERMINATED.
+ * \param size Size of buffer.
+ * \param options How to parse. NULL means zero initialized options.
+ * \param validation Receives depth and end of the value, may be NULL. Left unspecified on failure.
+ * \return
+ * - true, if the input is valid;
+ * - false, if it isn't or something went wrong.
+ */
+bool json_validate(const char *buffer, size_t size, const struct jsonParseOptions *options,
+        struct jsonValidation *validation);
+
+/*!
+ * \brief Parse only the members of objects that are asked for.
+ * \details Allowed keys are json pointers, e.g. "/id" or "/user/name", see json_pointer_compile(). Objects on the
+ * way to an allowed key are kept, with only the members leading to allowed keys, and values of allowed keys are
+ * parsed whole. Arrays on the way are kept with all their elements, each filtered like the array itself, so "/name"
+ * picks names of objects of a top-level array, too. Elements that aren't objects or arrays are kept as they are.
+ * Members that aren't allowed are checked like json_validate() does, but neither built nor unescaped.
+ * \param buffer Encoded as options say and NOT NULL TERMINATED.
+ * \param size Size of buffer.
+ * \param allowed_keys Json pointers of values to keep. Pointer "" keeps everything.
+ * \param n Number of allowed keys.
+ * \param options How to parse. NULL means zero initialized options.
+ * \return
+ * - parsed value;
+ * - NULL, if an allowed key isn't a json pointer, the text isn't valid or something went wrong.
+ */
+struct jsonValue *json_parse_filtered(const char *buffer, size_t size, const char *const *allowed_keys, size_t n,
+        const struct jsonParseOptions *options);
+
+/*!
+ * \brief Line terminators the printer may use.
+ */
+enum jsonNewline {
+    JSON_NEWLINE_LF, //!< "\n"
+    JSON_NEWLINE_CRLF //!< "\r\n"
+};
+
+/*!
+ * \brief How json_print() lays out the text.
+ * \details Zero initialized options give compact output with no whitespace at all.
+ */
+struct jsonPrintOptions {
+    bool pretty; //!< Put every element on its own line and indent it. Otherwise print compact text.
+    char indent_char; //!< Character used for indentation, e.g. ' ' or '\t'. Only used if pretty.
+    unsigned indent_width; //!< Number of indent_char per nesting level. Only used if pretty.
+    enum jsonNewline newline; //!< Line terminator. Only used if pretty.
+    bool ascii_only; //!< Escape every non ASCII character as \\uXXXX (surrogate pairs if needed).
+    bool sort_keys; //!< Print object entries ordered by key. Values of the same key keep the order they were added.
+};
+
+/*!
+ * \brief Options json_pretty_print() uses: one tab per level, "\n", no escaping of non ASCII, unsorted keys.
+ */
+extern const struct jsonPrintOptions json_pretty_options;
+
+/*!
+ * \brief Prints json value.
+ * \details Acts like snprintf i.e. passing size = 0 allows to precalculate out buffer size. Then you may allocate
+ * buffer of returned size + 1 and pass to the function again. If size != 0 output guaranteed have trailing '\0'.
+ * \param out Output buffer or NULL.
+ * \param size Size of out buffer. The function doesn't write more than that.
+ * \param value Json value to print.
+ * \param options Layout of the text. NULL means json_pretty_options.
+ * \returns Number of bytes (excluding terminating '\0') that would be written if output buffer was of infinite size.
+ * Zero if something went wrong.
+ */
+size_t json_print(char *out, size_t size, struct jsonValue *value, const struct jsonPrintOptions *options);
+
+/*!
+ * \brief Length of the text json_print() produces, computed without producing the text.
+ * \details Walks the tree once summing lengths of strings and their escape sequences, digits of numbers and
+ * indentation. json_print() with zero size returns the same.
+ * \param value Json value to measure.
+ * \param options Layout of the text. NULL means json_pretty_options.
+ * \returns Number of bytes json_print() writes, excluding terminating '\0'.
+ */
+size_t json_serialized_size(struct jsonValue *value, const struct jsonPrintOptions *options);
+
 /*!
  * \brief Prints json value in a pretty way.
- * \details Acts like snprint i.e. passing size = 0 allows to precalculate out buffer size. Then you may allocate
- * buffer of required size and pass to the function again. If size != 0 output guaranteed have trailing '\0'.
+ * \details Same as json_print() with json_pretty_options.
  * \param out Output buffer or NULL.
  * \param size Size of out buffer. The function doesn't write more than that.
  * \param value Json value to print.
@@ -313,6 +592,237 @@ struct jsonValue *json_parse_mem(const char *buffer, size_t size, bool all);
  */
 size_t json_pretty_print(char *out, size_t size, struct jsonValue *value);
 
+/*! \name Writer
+ *
+ * Writer produces json text from a sequence of calls like json_writer_begin_object(), json_writer_key(),
+ * json_writer_number() and json_writer_end_object() without building a tree. It puts commas, line breaks and
+ * indentation the same way json_print() does with the same options, except that keys are never sorted. Text goes
+ * either to a buffer, with snprintf semantics like json_print(), or to a sink function that receives it in chunks.
+ *
+ * A writer created with validation rejects calls that would make the text invalid: keys outside of objects, values in
+ * objects without a key, mismatched closing calls, more than one top level value, strings that aren't UTF-8 and numbers
+ * that aren't finite. Without validation only the nesting is tracked and such calls produce broken text. In both cases
+ * the first failed call makes the writer unusable and json_writer_finish() returns 0.
+ *
+ * \{ */
+
+/*!
+ * \brief Create writer that prints to a buffer.
+ * \param out Output buffer or NULL.
+ * \param size Size of out buffer. The writer doesn't write more than that.
+ * \param options Layout of the text. NULL means json_pretty_options.
+ * \param validate Should the writer check that the calls make valid json.
+ * \return
+ * - writer, which must be released with json_writer_finish();
+ * - NULL, if something went wrong.
+ */
+struct jsonWriter *json_writer_create(char *out, size_t size, const struct jsonPrintOptions *options, bool validate);
+
+/*!
+ * \brief Create writer that passes text to a sink.
+ * \param sink Function that consumes next chunk of the text. Returns false to stop the writer.
+ * \param context Passed to sink as is.
+ * \param options Layout of the text. NULL means json_pretty_options.
+ * \param validate Should the writer check that the calls make valid json.
+ * \return
+ * - writer, which must be released with json_writer_finish();
+ * - NULL, if something went wrong.
+ */
+struct jsonWriter *json_writer_create_sink(bool (*sink)(void *context, const char *data, size_t size),
+        void *context, const struct jsonPrintOptions *options, bool validate);
+
+/*!
+ * \brief Open object.
+ * \return Was it successful or not.
+ */
+bool json_writer_begin_object(struct jsonWriter *writer);
+
+/*!
+ * \brief Close innermost object.
+ * \return Was it successful or not.
+ */
+bool json_writer_end_object(struct jsonWriter *writer);
+
+/*!
+ * \brief Open array.
+ * \return Was it successful or not.
+ */
+bool json_writer_begin_array(struct jsonWriter *writer);
+
+/*!
+ * \brief Close innermost array.
+ * \return Was it successful or not.
+ */
+bool json_writer_end_array(struct jsonWriter *writer);
+
+/*!
+ * \brief Write key of the next object entry. The next call must write its value.
+ * \return Was it successful or not.
+ */
+bool json_writer_key(struct jsonWriter *writer, const char *key);
+
+/*!
+ * \brief Write string.
+ * \return Was it successful or not.
+ */
+bool json_writer_string(struct jsonWriter *writer, const char *string);
+
+/*!
+ * \brief Write string of given size, which may contain '\0'.
+ * \return Was it successful or not.
+ */
+bool json_writer_string_mem(struct jsonWriter *writer, const char *string, size_t size);
+
+/*!
+ * \brief Write number.
+ * \return Was it successful or not.
+ */
+bool json_writer_number(struct jsonWriter *writer, double number);
+
+/*!
+ * \brief Write boolean.
+ * \return Was it successful or not.
+ */
+bool json_writer_boolean(struct jsonWriter *writer, bool boolean);
+
+/*!
+ * \brief Write null.
+ * \return Was it successful or not.
+ */
+bool json_writer_null(struct jsonWriter *writer);
+
+/*!
+ * \brief Write whole json value.
+ * \return Was it successful or not.
+ */
+bool json_writer_value(struct jsonWriter *writer, struct jsonValue *value);
+
+/*!
+ * \brief Finish the text and release the writer.
+ * \details Passes the rest of the text to the sink, or terminates the buffer with '\0' like json_print().
+ * \returns Number of bytes (excluding terminating '\0') of the whole text, i.e. that would be written if output buffer
+ * was of infinite size. Zero if something went wrong.
+ */
+size_t json_writer_finish(struct jsonWriter *writer);
+
+/*! \} */
+
+/*! \name Binary formats
+ *
+ * Encoders and decoders between json values and CBOR (RFC 8949) or MessagePack. Numbers that are integers are encoded
+ * as integers, others as single precision floats if that's lossless or as double precision floats otherwise. Objects
+ * are encoded as maps with all their entries including repeated keys. Decoders accept text strings only as map keys,
+ * don't support byte strings and extension types, and turn CBOR tags into the tagged item. Arrays and objects are
+ * allocated once with the size from their length prefix.
+ *
+ * \{ */
+
+/*!
+ * \brief Encode json value as CBOR.
+ * \details Acts like json_print(): passing size = 0 allows to precalculate out buffer size.
+ * \param out Output buffer or NULL.
+ * \param size Size of out buffer. The function doesn't write more than that.
+ * \param value Json value to encode.
+ * \returns Number of bytes that would be written if output buffer was of infinite size.
+ */
+size_t json_cbor_encode(void *out, size_t size, struct jsonValue *value);
+
+/*!
+ * \brief Decode json value from CBOR.
+ * \param buffer Encoded data item.
+ * \param size Size of buffer.
+ * \param all Is it required to decode whole buffer or unparsed trailing bytes are allowed.
+ * \return
+ * - decoded value;
+ * - NULL, if something went wrong.
+ */
+struct jsonValue *json_cbor_decode(const void *buffer, size_t size, bool all);
+
+/*!
+ * \brief Encode json value as MessagePack.
+ * \details Acts like json_print(): passing size = 0 allows to precalculate out buffer size.
+ * \param out Output buffer or NULL.
+ * \param size Size of out buffer. The function doesn't write more than that.
+ * \param value Json value to encode.
+ * \returns Number of bytes that would be written if output buffer was of infinite size, 0 if a string, array or
+ * object is too long for the 32 bit lengths of MessagePack.
+ */
+size_t json_msgpack_encode(void *out, size_t size, struct jsonValue *value);
+
+/*!
+ * \brief Decode json value from MessagePack.
+ * \param buffer Encoded object.
+ * \param size Size of buffer.
+ * \param all Is it required to decode whole buffer or unparsed trailing bytes are allowed.
+ * \return
+ * - decoded value;
+ * - NULL, if something went wrong.
+ */
+struct jsonValue *json_msgpack_decode(const void *buffer, size_t size, bool all);
+
+/*! \} */
+
+/*! \name Snapshots
+ *
+ * A snapshot is a relocatable image of a json value that can be saved to a file and later mapped into memory and used
+ * in place, without parsing and allocating. Values of a snapshot are read-only: getters, lookups and json_copy() work
+ * on them, but setters fail, and printers, encoders and json_are_equal() require a json_copy() of the value first.
+ * json_value_free() ignores them. Snapshots are written in native byte order and are rejected on a machine with
+ * different one. Only the header of a snapshot is checked when it's opened, so snapshots should come from trusted
+ * sources.
+ *
+ * \{ */
+
+/*!
+ * \brief Write snapshot of json value.
+ * \details Acts like json_print(): passing size = 0 allows to precalculate out buffer size.
+ * \param out Output buffer or NULL. Must be aligned to 8 bytes.
+ * \param size Size of out buffer. The function doesn't write more than that.
+ * \param value Json value to make snapshot of.
+ * \returns Number of bytes that would be written if output buffer was of infinite size, 0 on error.
+ */
+size_t json_snapshot_encode(void *out, size_t size, struct jsonValue *value);
+
+/*!
+ * \brief Write snapshot of json value to a file.
+ * \param path Path of the file to create or truncate.
+ * \param value Json value to make snapshot of.
+ * \return Was it successful or not.
+ */
+bool json_snapshot_save(const char *path, struct jsonValue *value);
+
+/*!
+ * \brief Map snapshot file into memory.
+ * \param path Path of the snapshot file.
+ * \return
+ * - opened snapshot, which must be closed with json_snapshot_close();
+ * - NULL, if something went wrong.
+ */
+struct jsonSnapshot *json_snapshot_open(const char *path);
+
+/*!
+ * \brief Use snapshot from memory buffer.
+ * \param buffer Snapshot as written by json_snapshot_encode(). Must be aligned to 8 bytes and outlive the snapshot.
+ * \param size Size of buffer.
+ * \return
+ * - opened snapshot, which must be closed with json_snapshot_close();
+ * - NULL, if something went wrong.
+ */
+struct jsonSnapshot *json_snapshot_open_mem(const void *buffer, size_t size);
+
+/*!
+ * \brief Get root value of snapshot.
+ * \details Returned value and all values reachable from it are valid until the snapshot is closed.
+ */
+struct jsonValue *json_snapshot_root(struct jsonSnapshot *snapshot);
+
+/*!
+ * \brief Close snapshot.
+ */
+void json_snapshot_close(struct jsonSnapshot *snapshot);
+
+/*! \} */
+
 /*!
  * \brief Duplicate json value.
  * \param value What to make copy of.
@@ -320,6 +830,310 @@ size_t json_pretty_print(char *out, size_t size, struct jsonValue *value);
  */
 struct jsonValue *json_copy(struct jsonValue *value);
 
+/*! \name Sharing
+ *
+ * json_copy_shared() makes a copy that shares everything below its top level with the original instead of copying
+ * it. Shared values are sealed: setters, json_array_append() and json_object_add() refuse to change them. To change a
+ * value inside a copy get it with json_object_lookup_mut() or json_array_at_mut(), which copy the shared value they
+ * return the same way, so only the path to the change is copied. Any tree may be freed at any time and from any
+ * thread, shared values are freed with their last owner. A tree that isn't changed may be read and copied by several
+ * threads at once.
+ *
+ * \{ */
+
+/*!
+ * \brief Copy a value sharing its children with the original.
+ * \details The copy itself is not shared, so it may be changed. Strings, numbers, booleans and nulls are copied
+ * with json_copy().
+ * \param value What to make copy of.
+ * \returns A copy of \p value or NULL.
+ */
+struct jsonValue *json_copy_shared(struct jsonValue *value);
+
+/*!
+ * \brief Check whether a value is sealed because it's shared by several trees.
+ * \param value Some json value.
+ * \return Whether \p value can't be changed.
+ */
+bool json_is_shared(struct jsonValue *value);
+
+/*!
+ * \brief Lookup the last value added to a key for changing it.
+ * \details If the value is shared, it's replaced in \p object by a copy made with json_copy_shared().
+ * \param object Object that is not shared.
+ * \param key Name of the field.
+ * \returns Value that may be changed or NULL if there's no such field or something went wrong.
+ */
+struct jsonValue *json_object_lookup_mut(struct jsonValue *object, const char *key);
+
+/*!
+ * \brief Get an array element for changing it.
+ * \details If the element is shared, it's replaced in \p array by a copy made with json_copy_shared().
+ * \param array Array that is not shared.
+ * \param index Index of the element.
+ * \returns Element that may be changed or NULL if the index is out of range or something went wrong.
+ */
+struct jsonValue *json_array_at_mut(struct jsonValue *array, size_t index);
+
+/*! \} */
+
+/*! \name JSON Pointer
+ *
+ * Pointers as defined by RFC 6901, e.g. "/a/b~1c/0", are compiled once and may then be used with any number of
+ * documents, also by several threads at once. Compiling splits a pointer into its reference tokens, unescapes and
+ * hashes them, so getting a value only walks the document. Like json_object_lookup(), a pointer finds the value added
+ * last to a key.
+ *
+ * \{ */
+
+/*!
+ * \brief Compile json pointer.
+ * \param text Json pointer: "" or reference tokens, each preceded by '/'.
+ * \return
+ * - compiled pointer, which must be freed with json_pointer_free();
+ * - NULL, if the text isn't a json pointer or something went wrong.
+ */
+struct jsonPointer *json_pointer_compile(const char *text);
+
+/*!
+ * \brief Get the value a pointer refers to.
+ * \details A reference token applied to an array must be an index without leading zeros. Values of snapshots may
+ * be walked too.
+ * \param pointer Compiled json pointer.
+ * \param value Document to look into.
+ * \return Value that pointer refers to, NULL if there's no such value.
+ */
+struct jsonValue *json_pointer_get(const struct jsonPointer *pointer, struct jsonValue *value);
+
+/*!
+ * \brief Release memory held by a compiled pointer.
+ */
+void json_pointer_free(struct jsonPointer *pointer);
+
+/*! \} */
+
+/*! \name Patches
+ *
+ * JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7386) change the target in place. Values are moved by pointer,
+ * only values taken from the patch are copied. Applying a patch is all or nothing: if any operation fails, changes
+ * made by the ones before are undone, and the target is left as it was. Shared values on the way to a change are
+ * copied the way json_object_lookup_mut() does, the copies stay. The patch may be a snapshot value, but mustn't be a
+ * part of the target.
+ *
+ * \{ */
+
+/*!
+ * \brief Apply JSON Patch.
+ * \details Operations add, remove, replace, move, copy and test are applied in order. Paths refer to the last value
+ * added to a key, adding to a key that's there replaces that value.
+ * \param target Value to change, must not be shared. The root node stays the same even if it's replaced.
+ * \param patch Array of operations.
+ * \return
+ * - true, if the whole patch was applied;
+ * - false, if the patch is malformed, its path doesn't exist, a test failed (JSON_ERROR_PATCH) or something went
+ *   wrong. The target is unchanged then.
+ */
+bool json_patch_apply(struct jsonValue *target, struct jsonValue *patch);
+
+/*!
+ * \brief Apply JSON Merge Patch.
+ * \details Members of an object patch are merged into an object target recursively, a null member removes all values
+ * of its key. A patch that isn't an object replaces the target.
+ * \param target Value to change, must not be shared. The root node stays the same even if it's replaced.
+ * \param patch Value to merge into the target.
+ * \return
+ * - true, if the patch was applied;
+ * - false, if something went wrong. The target is unchanged then.
+ */
+bool json_merge_patch_apply(struct jsonValue *target, struct jsonValue *patch);
+
+/*!
+ * \brief Make JSON Patch that turns one value into another.
+ * \details Equal subtrees are skipped, changed members are diffed recursively. Elements of arrays are matched by their
+ * longest common subsequence, so an element inserted or removed in the middle costs one operation. Only add, remove
+ * and replace are used. Objects are compared by the last value of each key, the values pointers reach, so the patch
+ * doesn't restore repeated keys of \p right.
+ * \param left Value the patch is for.
+ * \param right Value applying the patch to \p left gives.
+ * \return
+ * - array of operations, empty if the values are equal. Values in it are copies;
+ * - NULL, if either value belongs to a snapshot (JSON_ERROR_READ_ONLY) or something went wrong.
+ */
+struct jsonValue *json_diff(struct jsonValue *left, struct jsonValue *right);
+
+/*! \} */
+
+/*! \name Queries
+ *
+ * Queries select values the way JSONPath does. A query is "$", the value it's applied to, followed by steps:
+ * - .name or ['name'] selects a member of an object, the name may be in double quotes too;
+ * - .* or [*] selects all members of an object or elements of an array;
+ * - [n] selects an element of an array, negative n counts from the end;
+ * - [start:end:by] selects a slice of an array the way Python does, each part may be left out;
+ * - [?(\@path op literal)] selects members or elements for which the condition holds. The path is made of .name,
+ *   ['name'] and [n] and may be empty. op is one of ==, !=, <, <=, >, >=, and literal is a number, a string in single
+ *   or double quotes, true, false or null. Without op and literal the condition is that the path exists. Only values
+ *   of the same kind compare, strings byte by byte;
+ * - ..step applies the step at any depth below instead of to children only, e.g. $..id selects all members named
+ *   "id".
+ *
+ * A value is selected at most once. Compiled queries may be used by several threads at once.
+ *
+ * \{ */
+
+/*!
+ * \brief Compile query.
+ * \param text Query as described above.
+ * \return
+ * - compiled query, which must be freed with json_query_free();
+ * - NULL, if the text isn't a query or something went wrong.
+ */
+struct jsonQuery *json_query_compile(const char *text);
+
+/*!
+ * \brief Select values of a tree.
+ * \details Values are selected depth first, members of objects in the order json_object_get_entry() sees them.
+ * Acts like json_print(): passing size = 0 allows to count the values.
+ * \param query Compiled query.
+ * \param value Tree to select from, may be a snapshot value.
+ * \param out Where to store pointers to selected values, they belong to the tree.
+ * \param size Number of pointers \p out has room for.
+ * \returns Number of selected values, which may be more than \p size.
+ */
+size_t json_query_select(const struct jsonQuery *query, struct jsonValue *value, struct jsonValue **out,
+        size_t size);
+
+/*!
+ * \brief Select values of json text while parsing it.
+ * \details Only values that are selected are built, text around them is just checked to be well-formed. Filters and
+ * indices counted from the end need their candidates built before they are known to be selected, so they save less.
+ * Values are selected in the order they appear in the text. A value selected inside of another selected value comes
+ * right after it as a copy.
+ * \param query Compiled query.
+ * \param buffer Encoded as options say and NOT NULL TERMINATED.
+ * \param size Size of buffer.
+ * \param options How to parse. NULL means zero initialized options.
+ * \return
+ * - array of selected values;
+ * - NULL, if the text isn't valid or something went wrong.
+ */
+struct jsonValue *json_query_parse(const struct jsonQuery *query, const char *buffer, size_t size,
+        const struct jsonParseOptions *options);
+
+/*!
+ * \brief Release memory held by a compiled query.
+ */
+void json_query_free(struct jsonQuery *query);
+
+/*! \} */
+
+/*! \name Binding
+ *
+ * Json objects may be parsed straight into C structs, without building values. A struct is described by a schema,
+ * which lists a field for each key to read:
+ * \code
+ * struct point { double x, y; };
+ * struct shape { char *name; struct point center; struct jsonBoundArray points; };
+ *
+ * static const struct jsonField point_fields[] = {
+ *     { "x", offsetof(struct point, x), JSON_FIELD_DOUBLE },
+ *     { "y", offsetof(struct point, y), JSON_FIELD_DOUBLE },
+ * };
+ * static const struct jsonSchema point = { sizeof(struct point), point_fields, 2 };
+ * static const struct jsonField shape_fields[] = {
+ *     { "name", offsetof(struct shape, name), JSON_FIELD_STRING },
+ *     { "center", offsetof(struct shape, center), JSON_FIELD_STRUCT, .schema = &point },
+ *     { "points", offsetof(struct shape, points), JSON_FIELD_ARRAY, JSON_FIELD_STRUCT, &point },
+ * };
+ * static const struct jsonSchema shape = { sizeof(struct shape), shape_fields, 3 };
+ * \endcode
+ * Schemas are compiled once into a binder, which hashes the keys, and which may be used by several threads at once.
+ * Members with keys the schema doesn't list are checked but skipped. Fields of keys that are missing or null are left
+ * zero. Of repeated keys the last one counts.
+ *
+ * \{ */
+
+/*!
+ * \brief Types of fields.
+ */
+enum jsonFieldType {
+    JSON_FIELD_BOOL, //!< bool, from true or false.
+    JSON_FIELD_INT, //!< long long, from a number without fraction or exponent that fits.
+    JSON_FIELD_DOUBLE, //!< double, from a number.
+    JSON_FIELD_STRING, //!< char *, from a string. Allocated, null terminated UTF-8.
+    JSON_FIELD_STRUCT, //!< struct described by a schema, from an object.
+    JSON_FIELD_ARRAY //!< struct jsonBoundArray, from an array of items all of one type, which isn't an array.
+};
+
+/*!
+ * \brief Field of an array type: items, one after another, allocated.
+ */
+struct jsonBoundArray {
+    void *items; //!< Items of the field's item type, NULL if there are none.
+    size_t size; //!< Number of items.
+};
+
+struct jsonSchema;
+
+/*!
+ * \brief Where to put the value of a key.
+ */
+struct jsonField {
+    const char *key; //!< Key of the member, UTF-8.
+    size_t offset; //!< Offset of the field in the struct.
+    enum jsonFieldType type; //!< Type of the field.
+    enum jsonFieldType item_type; //!< Type of items, if the field is an array.
+    const struct jsonSchema *schema; //!< Schema of the field or of its items, if they are structs.
+};
+
+/*!
+ * \brief Description of a struct. Schemas may refer to each other and to themselves through arrays.
+ */
+struct jsonSchema {
+    size_t size; //!< sizeof the struct.
+    const struct jsonField *fields; //!< Fields to read, keys must differ.
+    size_t n; //!< Number of fields.
+};
+
+struct jsonBinder;
+
+/*!
+ * \brief Compile schema, and all schemas it refers to, into a binder.
+ * \param schema Schema of the structs to parse objects into. It must outlive the binder.
+ * \return
+ * - binder, which must be freed with json_binder_free();
+ * - NULL, if a schema is inconsistent or something went wrong.
+ */
+struct jsonBinder *json_binder_compile(const struct jsonSchema *schema);
+
+/*!
+ * \brief Parse a json object into a struct.
+ * \details The struct is zeroed first. Values of a wrong type are errors with code JSON_ERROR_SCHEMA and the
+ * position of the value. Input is nested at most as deep as options allow and never deeper than JSON_BIND_MAX_DEPTH.
+ * \param binder Compiled schema.
+ * \param buffer Encoded as options say and NOT NULL TERMINATED.
+ * \param size Size of buffer.
+ * \param out Struct to fill in, which must be freed with json_bind_free() afterwards.
+ * \param options How to parse. NULL means zero initialized options.
+ * \return
+ * - true, if the struct was filled in;
+ * - false, if the text isn't valid, doesn't fit the schema or something went wrong. The struct is zero then.
+ */
+bool json_bind(const struct jsonBinder *binder, const char *buffer, size_t size, void *out,
+        const struct jsonParseOptions *options);
+
+/*!
+ * \brief Release strings and arrays of a struct filled in by json_bind() and zero it.
+ */
+void json_bind_free(const struct jsonBinder *binder, void *out);
+
+/*!
+ * \brief Release memory held by a binder.
+ */
+void json_binder_free(struct jsonBinder *binder);
+
+/*! \} */
+
 /*!
  * \brief Checks whether two json values are semantically equal.
  * \param left Some json value.
@@ -328,17 +1142,73 @@ struct jsonValue *json_copy(struct jsonValue *value);
  * corresponding node in the \p right or NULL if \p right has some node and \p left doesn't. User may pass NULL if this
  * value is not interesting.
  * \param[out] right_out Same as left_out but for the \p right.
- * \return Whether \p left semantically equal to \p right.
+ * \return Whether \p left semantically equal to \p right. Values of a repeated key must be equal in any order.
  */
 bool json_are_equal(struct jsonValue *left, struct jsonValue *right,
         struct jsonValue **left_out, struct jsonValue **right_out);
 
+/*!
+ * \brief Structural hash of a json value.
+ * \details Values equal by json_are_equal() hash the same, the order of object members doesn't matter, so values may
+ * serve as keys of hash tables. Shared arrays and objects never change, so their hashes are kept once computed, and
+ * json_are_equal() tells shared containers with different kept hashes apart without looking inside. Other values are
+ * hashed anew on every call, down to the shared containers below them.
+ * \param value Some json value.
+ * \return
+ * - hash of the value, never 0;
+ * - 0, if the value belongs to a snapshot (JSON_ERROR_READ_ONLY) or is NULL.
+ */
+unsigned long long json_hash(struct jsonValue *value);
+
+/*! \name Errors
+ *
+ * A failing function records what went wrong for the calling thread. Recording an error never allocates memory, text
+ * for json_strerror() is put together only when it's asked for.
+ *
+ * \{ */
+
+/*!
+ * \brief Kinds of errors.
+ */
+enum jsonErrorCode {
+    JSON_ERROR_NONE, //!< There was no error.
+    JSON_ERROR_ARGUMENT, //!< Argument is NULL, of a wrong kind or out of range.
+    JSON_ERROR_READ_ONLY, //!< Value is shared or belongs to a snapshot and can't be used that way.
+    JSON_ERROR_OUT_OF_MEMORY, //!< Allocation failed.
+    JSON_ERROR_SYNTAX, //!< Input is malformed.
+    JSON_ERROR_LIMIT, //!< Input exceeds a limit, e.g. nesting depth.
+    JSON_ERROR_UNSUPPORTED, //!< Input is well formed, but can't be represented as json.
+    JSON_ERROR_IO, //!< Reading or writing a file failed.
+    JSON_ERROR_WRITER, //!< Writer was misused or its sink failed.
+    JSON_ERROR_SCHEMA, //!< Input is well formed, but doesn't fit the schema it's bound to.
+    JSON_ERROR_PATCH //!< Patch doesn't apply: a path doesn't exist or a test failed.
+};
+
+/*!
+ * \brief Description of an error.
+ */
+struct jsonError {
+    enum jsonErrorCode code; //!< Kind of the error.
+    const char *message; //!< Static text without the position, never NULL.
+    size_t offset; //!< Byte of the input where the error was found, if it was found in input.
+    unsigned long line; //!< Line of the text where the error was found, starting from 1. 0 if there's no line.
+    unsigned long column; //!< Column of the text where the error was found, starting from 1.
+};
+
+/*!
+ * \brief The last error in THIS THREAD.
+ * \details It's kept until another error happens or a parser or decoder is called again.
+ * \return Error, with code JSON_ERROR_NONE if there was none. Never returns NULL.
+ */
+const struct jsonError *json_last_error(void);
+
 /*!
  * \brief String representation of an error.
- * \return Text describing error happend during the last call to a library
- * function in THIS THREAD or string "NULL" if the last call was successful or
- * there were no cals at all. Never returns NULL.
+ * \return Text describing the last error in THIS THREAD with its position, if it has one, or an empty string if
+ * there was no error. It stays valid until the next call in this thread. Never returns NULL.
  */
 const char *json_strerror(void);
 
+/*! \} */
+
 #endif
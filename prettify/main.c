@@ -43,14 +43,14 @@ int main(int argc, char ** argv) {
         result = EXIT_FAILURE;
         goto finish;
     }
-    value = json_parse(memory, true);
+    value = json_parse_mem(memory, info.st_size, true);
     if (!value) {
         fprintf(stderr, "Failed to parse json: %s.\n", json_strerror());
         result = EXIT_FAILURE;
         goto finish;
     }
     setvbuf(stdout, NULL, _IOFBF, 0);
-    size_t size = json_pretty_print(NULL, 0, value);
+    size_t size = json_serialized_size(value, NULL) + 1;
     char *buffer = malloc(size);
     json_pretty_print(buffer, size, value);
     puts(buffer);
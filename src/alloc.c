@@ -1,35 +1,77 @@
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <uchar.h>
 
 #include "json_internal.h"
 
+static void *default_allocate(void *context, size_t size) {
+    (void) context;
+    return malloc(size);
+}
+
+static void *default_reallocate(void *context, void *ptr, size_t size) {
+    (void) context;
+    return realloc(ptr, size);
+}
+
+static void default_release(void *context, void *ptr) {
+    (void) context;
+    free(ptr);
+}
+
+static struct jsonAllocator allocator = {
+    .allocate = default_allocate,
+    .reallocate = default_reallocate,
+    .release = default_release,
+    .context = NULL,
+};
+
+extern void allocator_set(const struct jsonAllocator *new_allocator) {
+    if (new_allocator) {
+        allocator = *new_allocator;
+    } else {
+        allocator.allocate = default_allocate;
+        allocator.reallocate = default_reallocate;
+        allocator.release = default_release;
+        allocator.context = NULL;
+    }
+}
+
 extern void *json_malloc_(size_t size) {
-    void *ptr = malloc(size);
+    void *ptr = allocator.allocate(allocator.context, size);
     if (!ptr) {
-        set_error(error_out_of_memory);
+        set_error(JSON_ERROR_OUT_OF_MEMORY, "out of memory");
     }
     return ptr;
 }
 
 extern void *json_calloc_(size_t size) {
-    void *ptr = calloc(size, 1);
+    void *ptr;
+    // calloc() may get zeroed pages from the system without touching them.
+    if (allocator.allocate == default_allocate) {
+        ptr = calloc(size, 1);
+    } else {
+        ptr = allocator.allocate(allocator.context, size);
+        if (ptr) {
+            memset(ptr, 0, size);
+        }
+    }
     if (!ptr) {
-        set_error(error_out_of_memory);
+        set_error(JSON_ERROR_OUT_OF_MEMORY, "out of memory");
     }
     return ptr;
 }
 
 extern void *json_realloc_(void *ptr, size_t size) {
-    ptr = realloc(ptr, size);
+    ptr = allocator.reallocate(allocator.context, ptr, size);
     if (!ptr) {
-        set_error(error_out_of_memory);
+        set_error(JSON_ERROR_OUT_OF_MEMORY, "out of memory");
     }
     return ptr;
 }
 
 extern void json_free_(void *ptr) {
-    free(ptr);
+    allocator.release(allocator.context, ptr);
 }
-
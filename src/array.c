@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <uchar.h>
 
@@ -17,6 +18,7 @@ extern void array_init(struct jsonArray *array) {
     array->capacity = 0;
     array->size = 0;
     array->values = NULL;
+    atomic_init(&array->hash, 0);
 }
 
 extern void array_free_internal(struct jsonArray *array) {
@@ -32,6 +34,21 @@ extern void array_free_internal(struct jsonArray *array) {
     array->values = NULL;
 }
 
+/* Copy of exactly the array's size that points to the same values. */
+extern bool array_clone(struct jsonArray *copy, const struct jsonArray *array) {
+    array_init(copy);
+    if (!array->size) {
+        return true;
+    }
+    copy->values = json_malloc(array->size * sizeof(struct jsonValue *));
+    if (!copy->values) {
+        return false;
+    }
+    memcpy(copy->values, array->values, array->size * sizeof(struct jsonValue *));
+    copy->capacity = copy->size = array->size;
+    return true;
+}
+
 /* Makes this true: new array->capacity = max(old array->capacity, new_capacity)  */
 extern bool array_reserve(struct jsonArray *array, size_t new_capacity) {
     assert(array);
@@ -69,3 +86,26 @@ extern bool array_append(struct jsonArray *array, struct jsonValue *value) {
     array->values[array->size++] = value;
     return true;
 }
+
+/* Allocates only when the array is full, so an element removed before can
+ * always be put back. */
+extern bool array_insert(struct jsonArray *array, size_t index, struct jsonValue *value) {
+    assert(array);
+    assert(index <= array->size);
+    if (!array_double(array, array->size + 1)) {
+        return false;
+    }
+    memmove(&array->values[index + 1], &array->values[index], (array->size - index) * sizeof(struct jsonValue *));
+    array->values[index] = value;
+    ++array->size;
+    return true;
+}
+
+extern struct jsonValue *array_remove(struct jsonArray *array, size_t index) {
+    assert(array);
+    assert(index < array->size);
+    struct jsonValue *value = array->values[index];
+    --array->size;
+    memmove(&array->values[index], &array->values[index + 1], (array->size - index) * sizeof(struct jsonValue *));
+    return value;
+}
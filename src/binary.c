@@ -0,0 +1,147 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+extern void encoder_init(struct encoder *encoder, void *out, size_t size) {
+    assert(encoder);
+    encoder->out = out;
+    encoder->size = out ? size : 0;
+    encoder->position = 0;
+}
+
+extern void encode_byte(struct encoder *encoder, unsigned char byte) {
+    if (encoder->position < encoder->size) {
+        encoder->out[encoder->position] = byte;
+    }
+    ++encoder->position;
+}
+
+extern void encode_bytes(struct encoder *encoder, const void *bytes, size_t n) {
+    if (encoder->position < encoder->size) {
+        size_t room = encoder->size - encoder->position;
+        memcpy(encoder->out + encoder->position, bytes, n < room ? n : room);
+    }
+    encoder->position += n;
+}
+
+/* Writes n lowest bytes of value in big endian order. */
+extern void encode_uint(struct encoder *encoder, uint64_t value, int n) {
+    for (int i = n - 1; i >= 0; --i) {
+        encode_byte(encoder, (unsigned char) (value >> (8 * i)));
+    }
+}
+
+extern void encode_double(struct encoder *encoder, double number) {
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    encode_uint(encoder, bits, 8);
+}
+
+extern void encode_float(struct encoder *encoder, float number) {
+    uint32_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    encode_uint(encoder, bits, 4);
+}
+
+extern bool number_is_int64(double number, int64_t *out) {
+    if (!(-0x1p63 <= number && number < 0x1p63)) {
+        return false;
+    }
+    int64_t integer = (int64_t) number;
+    if ((double) integer != number || (number == 0 && signbit(number))) {
+        return false;
+    }
+    *out = integer;
+    return true;
+}
+
+extern bool number_is_float(double number) {
+    return isnan(number) || (double) (float) number == number;
+}
+
+extern void decoder_init(struct decoder *decoder, const void *in, size_t size) {
+    assert(decoder);
+    decoder->in = in;
+    decoder->size = size;
+    decoder->offset = 0;
+    decoder->depth = 0;
+}
+
+extern const unsigned char *decode_bytes(struct decoder *decoder, size_t n) {
+    if (decoder->size - decoder->offset < n) {
+        input_error(JSON_ERROR_SYNTAX, "unexpected end of input", decoder->size);
+        return NULL;
+    }
+    const unsigned char *bytes = decoder->in + decoder->offset;
+    decoder->offset += n;
+    return bytes;
+}
+
+extern bool decode_uint(struct decoder *decoder, int n, uint64_t *out) {
+    const unsigned char *bytes = decode_bytes(decoder, n);
+    if (!bytes) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < n; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    *out = value;
+    return true;
+}
+
+extern bool decode_double(struct decoder *decoder, double *out) {
+    uint64_t bits;
+    if (!decode_uint(decoder, 8, &bits)) {
+        return false;
+    }
+    memcpy(out, &bits, sizeof(*out));
+    return true;
+}
+
+extern bool decode_float(struct decoder *decoder, double *out) {
+    uint64_t bits;
+    if (!decode_uint(decoder, 4, &bits)) {
+        return false;
+    }
+    uint32_t bits32 = (uint32_t) bits;
+    float number;
+    memcpy(&number, &bits32, sizeof(number));
+    *out = number;
+    return true;
+}
+
+/* Upper bound for the number of elements a container may have if each of them
+ * takes at least element_size bytes of the remaining input. Keeps hostile
+ * length prefixes from making us allocate more than the input could fill. */
+extern size_t decoder_capacity_hint(struct decoder *decoder, uint64_t length, size_t element_size) {
+    size_t left = (decoder->size - decoder->offset) / element_size;
+    return length < left ? (size_t) length : left;
+}
+
+extern struct jsonValue *decoded_string(const unsigned char *bytes, size_t n) {
+    struct jsonValue *value = value_alloc();
+    if (!value) {
+        return NULL;
+    }
+    value->kind = JVK_STR;
+    if (!string_init_mem(&value->v.string, (const char *) bytes, n)) {
+        pool_free(POOL_VALUE, value);
+        return NULL;
+    }
+    return value;
+}
+
+extern struct jsonString *decoded_key(const unsigned char *bytes, size_t n) {
+    struct jsonString *key = pool_alloc(POOL_STRING);
+    if (!key) {
+        return NULL;
+    }
+    if (!string_init_mem(key, (const char *) bytes, n)) {
+        pool_free(POOL_STRING, key);
+        return NULL;
+    }
+    return key;
+}
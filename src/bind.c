@@ -0,0 +1,427 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+/* Field with its key hashed, and the struct its value or items are bound
+ * to, if they are structs. */
+struct boundField {
+    const struct jsonField *field;
+    unsigned hash;
+    size_t nested;
+};
+
+/* Fields of a schema in an open addressing table. Slots hold indices of
+ * fields plus one, 0 marks an empty slot. */
+struct boundStruct {
+    const struct jsonSchema *schema;
+    struct boundField *fields;
+    size_t *slots;
+    size_t mask;
+};
+
+struct jsonBinder {
+    size_t size;
+    struct boundStruct structs[];
+};
+
+static size_t item_size(enum jsonFieldType type, const struct jsonSchema *schema) {
+    switch (type) {
+    case JSON_FIELD_BOOL:
+        return sizeof(bool);
+    case JSON_FIELD_INT:
+        return sizeof(long long);
+    case JSON_FIELD_DOUBLE:
+        return sizeof(double);
+    case JSON_FIELD_STRING:
+        return sizeof(char *);
+    case JSON_FIELD_STRUCT:
+        return schema->size;
+    case JSON_FIELD_ARRAY:
+        return sizeof(struct jsonBoundArray);
+    }
+    return 0;
+}
+
+/* Type whose values end up in the field, items for arrays. */
+static enum jsonFieldType value_type(const struct jsonField *field) {
+    return field->type == JSON_FIELD_ARRAY ? field->item_type : field->type;
+}
+
+static bool check_field(const struct jsonSchema *schema, const struct jsonField *field) {
+    if (!field->key) {
+        set_error(JSON_ERROR_ARGUMENT, "field has no key");
+        return false;
+    }
+    if (field->type > JSON_FIELD_ARRAY || (field->type == JSON_FIELD_ARRAY && field->item_type >= JSON_FIELD_ARRAY)) {
+        set_error(JSON_ERROR_ARGUMENT, "field has no valid type");
+        return false;
+    }
+    if (value_type(field) == JSON_FIELD_STRUCT && !field->schema) {
+        set_error(JSON_ERROR_ARGUMENT, "field of a struct type has no schema");
+        return false;
+    }
+    size_t size = item_size(field->type, field->schema);
+    if (field->offset > schema->size || schema->size - field->offset < size) {
+        set_error(JSON_ERROR_ARGUMENT, "field doesn't fit into its struct");
+        return false;
+    }
+    return true;
+}
+
+/* Index of the struct bound to a schema, adding it if it's new. */
+static size_t struct_of(struct jsonBinder *binder, const struct jsonSchema *schema) {
+    for (size_t i = 0; i < binder->size; ++i) {
+        if (binder->structs[i].schema == schema) {
+            return i;
+        }
+    }
+    binder->structs[binder->size] = (struct boundStruct) { schema, NULL, NULL, 0 };
+    return binder->size++;
+}
+
+static size_t find_field(const struct boundStruct *bound, const char *key, unsigned hash) {
+    for (size_t i = hash & bound->mask; bound->slots[i]; i = (i + 1) & bound->mask) {
+        const struct boundField *field = &bound->fields[bound->slots[i] - 1];
+        if (field->hash == hash && !strcmp(field->field->key, key)) {
+            return bound->slots[i];
+        }
+    }
+    return 0;
+}
+
+static bool compile_struct(struct jsonBinder *binder, size_t index) {
+    struct boundStruct *bound = &binder->structs[index];
+    const struct jsonSchema *schema = bound->schema;
+    size_t capacity = 2;
+    while (capacity < schema->n * 2) {
+        capacity *= 2;
+    }
+    bound->mask = capacity - 1;
+    bound->slots = json_calloc(capacity * sizeof(size_t));
+    bound->fields = json_malloc((schema->n ? schema->n : 1) * sizeof(struct boundField));
+    if (!bound->slots || !bound->fields) {
+        return false;
+    }
+    for (size_t i = 0; i < schema->n; ++i) {
+        const struct jsonField *field = &schema->fields[i];
+        if (!check_field(schema, field)) {
+            return false;
+        }
+        unsigned hash = string_hash(field->key);
+        if (find_field(bound, field->key, hash)) {
+            set_error(JSON_ERROR_ARGUMENT, "schema has a key twice");
+            return false;
+        }
+        size_t nested = value_type(field) == JSON_FIELD_STRUCT ? struct_of(binder, field->schema) : 0;
+        bound->fields[i] = (struct boundField) { field, hash, nested };
+        size_t slot = hash & bound->mask;
+        while (bound->slots[slot]) {
+            slot = (slot + 1) & bound->mask;
+        }
+        bound->slots[slot] = i + 1;
+    }
+    return true;
+}
+
+/* Counts schemas reachable from the root, each one once, so the binder can
+ * be allocated in one piece. */
+static size_t count_schemas(const struct jsonSchema **seen, size_t size, const struct jsonSchema *schema) {
+    for (size_t i = 0; i < size; ++i) {
+        if (seen[i] == schema) {
+            return size;
+        }
+    }
+    seen[size++] = schema;
+    return size;
+}
+
+extern void binder_free(struct jsonBinder *binder) {
+    if (!binder) {
+        return;
+    }
+    for (size_t i = 0; i < binder->size; ++i) {
+        json_free(binder->structs[i].fields);
+        json_free(binder->structs[i].slots);
+    }
+    json_free(binder);
+}
+
+extern struct jsonBinder *binder_compile(const struct jsonSchema *schema) {
+    assert(schema);
+    // Schemas are walked breadth first, the list of them being the queue.
+    size_t capacity = 8;
+    size_t size = 0;
+    const struct jsonSchema **seen = json_malloc(capacity * sizeof(*seen));
+    if (!seen) {
+        return NULL;
+    }
+    size = count_schemas(seen, size, schema);
+    for (size_t i = 0; i < size; ++i) {
+        if (seen[i]->n && !seen[i]->fields) {
+            set_error(JSON_ERROR_ARGUMENT, "schema has no fields");
+            json_free(seen);
+            return NULL;
+        }
+        for (size_t j = 0; j < seen[i]->n; ++j) {
+            const struct jsonField *field = &seen[i]->fields[j];
+            if (value_type(field) != JSON_FIELD_STRUCT || !field->schema) {
+                continue;
+            }
+            if (size == capacity) {
+                const struct jsonSchema **new_seen = json_realloc(seen, capacity * 2 * sizeof(*seen));
+                if (!new_seen) {
+                    json_free(seen);
+                    return NULL;
+                }
+                seen = new_seen;
+                capacity *= 2;
+            }
+            size = count_schemas(seen, size, field->schema);
+        }
+    }
+    json_free(seen);
+    struct jsonBinder *binder = json_malloc(sizeof(struct jsonBinder) + size * sizeof(struct boundStruct));
+    if (!binder) {
+        return NULL;
+    }
+    binder->size = 0;
+    struct_of(binder, schema);
+    for (size_t i = 0; i < binder->size; ++i) {
+        if (!compile_struct(binder, i)) {
+            binder_free(binder);
+            return NULL;
+        }
+    }
+    return binder;
+}
+
+static void free_struct(const struct jsonBinder *binder, size_t index, void *out);
+
+/* Releases what a value of the type holds, leaving it zero. */
+static void free_value(const struct jsonBinder *binder, enum jsonFieldType type, enum jsonFieldType item_type,
+        size_t nested, void *out) {
+    switch (type) {
+    case JSON_FIELD_STRING:
+        json_free(*(char **) out);
+        break;
+    case JSON_FIELD_STRUCT:
+        free_struct(binder, nested, out);
+        break;
+    case JSON_FIELD_ARRAY: {
+        struct jsonBoundArray *array = out;
+        size_t size = item_size(item_type, binder->structs[nested].schema);
+        for (size_t i = 0; i < array->size; ++i) {
+            free_value(binder, item_type, item_type, nested, (char *) array->items + i * size);
+        }
+        json_free(array->items);
+        break;
+    }
+    default:
+        break;
+    }
+    memset(out, 0, item_size(type, binder->structs[nested].schema));
+}
+
+static void free_struct(const struct jsonBinder *binder, size_t index, void *out) {
+    const struct boundStruct *bound = &binder->structs[index];
+    for (size_t i = 0; i < bound->schema->n; ++i) {
+        const struct boundField *field = &bound->fields[i];
+        free_value(binder, field->field->type, field->field->item_type, field->nested,
+                (char *) out + field->field->offset);
+    }
+}
+
+extern void bind_free(const struct jsonBinder *binder, void *out) {
+    free_struct(binder, 0, out);
+}
+
+/* Parsing into fields recurses once per struct and array. Schemas that refer
+ * to themselves through arrays take input of any depth, so the depth is
+ * checked against max_depth, which is never more than JSON_BIND_MAX_DEPTH. */
+struct binding {
+    const struct jsonBinder *binder;
+    struct jsonString key;
+    size_t max_depth;
+};
+
+static bool bind_struct(struct binding *binding, size_t index, void *out, size_t depth);
+static bool bind_value(struct binding *binding, enum jsonFieldType type, enum jsonFieldType item_type, size_t nested,
+        void *out, size_t depth);
+
+static bool bind_number(enum jsonFieldType type, void *out) {
+    const char *text = parser_number();
+    if (!text) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    if (type == JSON_FIELD_DOUBLE) {
+        *(double *) out = strtod(text, &end);
+        return true;
+    }
+    long long number = strtoll(text, &end, 10);
+    if (*end) {
+        parser_error(JSON_ERROR_SCHEMA, "integer was expected");
+        return false;
+    }
+    if (errno == ERANGE) {
+        parser_error(JSON_ERROR_SCHEMA, "integer is out of range");
+        return false;
+    }
+    *(long long *) out = number;
+    return true;
+}
+
+static bool bind_string(void *out) {
+    struct jsonString string;
+    string_init(&string);
+    if (!parser_string(&string)) {
+        string_free_internal(&string);
+        return false;
+    }
+    *(char **) out = string.data;
+    return true;
+}
+
+static bool bind_array(struct binding *binding, enum jsonFieldType type, size_t nested, struct jsonBoundArray *out,
+        size_t depth) {
+    size_t size = item_size(type, binding->binder->structs[nested].schema);
+    size_t capacity = 0;
+    parser_consume_optionally("[");
+    skip_spaces();
+    if (parser_consume_optionally("]")) {
+        return true;
+    }
+    do {
+        if (out->size == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 4;
+            void *items = json_realloc(out->items, new_capacity * size);
+            if (!items) {
+                return false;
+            }
+            out->items = items;
+            capacity = new_capacity;
+        }
+        void *item = (char *) out->items + out->size++ * size;
+        memset(item, 0, size);
+        if (!bind_value(binding, type, type, nested, item, depth)) {
+            return false;
+        }
+        skip_spaces();
+    } while (parser_consume_optionally(","));
+    return parser_consume("]", "']' was expected");
+}
+
+static bool bind_value(struct binding *binding, enum jsonFieldType type, enum jsonFieldType item_type, size_t nested,
+        void *out, size_t depth) {
+    skip_spaces();
+    int c = parser_peek();
+    if (c == 'n') {
+        return parser_consume("null", "'null' was expected");
+    }
+    switch (type) {
+    case JSON_FIELD_BOOL:
+        if (c == 't') {
+            *(bool *) out = true;
+            return parser_consume("true", "'true' was expected");
+        }
+        if (c == 'f') {
+            return parser_consume("false", "'false' was expected");
+        }
+        parser_error(JSON_ERROR_SCHEMA, "boolean was expected");
+        return false;
+    case JSON_FIELD_INT:
+    case JSON_FIELD_DOUBLE:
+        if (c == '-' || ('0' <= c && c <= '9')) {
+            return bind_number(type, out);
+        }
+        parser_error(JSON_ERROR_SCHEMA, "number was expected");
+        return false;
+    case JSON_FIELD_STRING:
+        if (c == '"') {
+            return bind_string(out);
+        }
+        parser_error(JSON_ERROR_SCHEMA, "string was expected");
+        return false;
+    case JSON_FIELD_STRUCT:
+        if (c == '{') {
+            return bind_struct(binding, nested, out, depth);
+        }
+        parser_error(JSON_ERROR_SCHEMA, "object was expected");
+        return false;
+    case JSON_FIELD_ARRAY:
+        if (c == '[') {
+            if (depth == binding->max_depth) {
+                parser_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded");
+                return false;
+            }
+            return bind_array(binding, item_type, nested, out, depth + 1);
+        }
+        parser_error(JSON_ERROR_SCHEMA, "array was expected");
+        return false;
+    }
+    return false;
+}
+
+/* Looks up each key as it's read. A key that's there again replaces what its
+ * field got before. */
+static bool bind_struct(struct binding *binding, size_t index, void *out, size_t depth) {
+    if (depth == binding->max_depth) {
+        parser_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded");
+        return false;
+    }
+    const struct boundStruct *bound = &binding->binder->structs[index];
+    size_t ignored = 0;
+    parser_consume_optionally("{");
+    skip_spaces();
+    if (parser_consume_optionally("}")) {
+        return true;
+    }
+    do {
+        if (!parser_key(&binding->key)) {
+            return false;
+        }
+        size_t i = find_field(bound, binding->key.data, binding->key.hash);
+        if (!i) {
+            skip_spaces();
+            if (!validate_json_text(false, binding->max_depth - depth - 1, &ignored, &ignored)) {
+                return false;
+            }
+        } else {
+            const struct boundField *field = &bound->fields[i - 1];
+            void *target = (char *) out + field->field->offset;
+            free_value(binding->binder, field->field->type, field->field->item_type, field->nested, target);
+            if (!bind_value(binding, field->field->type, field->field->item_type, field->nested, target, depth + 1)) {
+                return false;
+            }
+        }
+        skip_spaces();
+    } while (parser_consume_optionally(","));
+    return parser_consume("}", "'}' was expected");
+}
+
+extern bool bind_parse(const struct jsonBinder *binder, void *out, bool all, size_t max_depth) {
+    if (max_depth > JSON_BIND_MAX_DEPTH) {
+        max_depth = JSON_BIND_MAX_DEPTH;
+    }
+    struct binding binding = { binder, { 0, 0, NULL, 0 }, max_depth };
+    string_init(&binding.key);
+    memset(out, 0, binder->structs[0].schema->size);
+    skip_spaces();
+    bool ok = bind_value(&binding, JSON_FIELD_STRUCT, JSON_FIELD_STRUCT, 0, out, 0);
+    if (ok) {
+        skip_spaces();
+        if (all && EOF != parser_peek()) {
+            parser_error(JSON_ERROR_SYNTAX, "trailing bytes");
+            ok = false;
+        }
+    }
+    if (!ok) {
+        free_struct(binder, 0, out);
+    }
+    string_free_internal(&binding.key);
+    return ok;
+}
@@ -0,0 +1,376 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+#define MAJOR_UNSIGNED  0
+#define MAJOR_NEGATIVE  1
+#define MAJOR_BYTES     2
+#define MAJOR_TEXT      3
+#define MAJOR_ARRAY     4
+#define MAJOR_MAP       5
+#define MAJOR_TAG       6
+#define MAJOR_SIMPLE    7
+
+#define INFO_INDEFINITE 31
+
+#define SIMPLE_FALSE    0xF4
+#define SIMPLE_TRUE     0xF5
+#define SIMPLE_NULL     0xF6
+#define FLOAT_SINGLE    0xFA
+#define FLOAT_DOUBLE    0xFB
+#define BREAK           0xFF
+
+static void encode_head(struct encoder *encoder, unsigned major, uint64_t argument) {
+    unsigned char type = major << 5;
+    if (argument < 24) {
+        encode_byte(encoder, type | argument);
+    } else if (argument <= 0xFF) {
+        encode_byte(encoder, type | 24);
+        encode_uint(encoder, argument, 1);
+    } else if (argument <= 0xFFFF) {
+        encode_byte(encoder, type | 25);
+        encode_uint(encoder, argument, 2);
+    } else if (argument <= 0xFFFFFFFF) {
+        encode_byte(encoder, type | 26);
+        encode_uint(encoder, argument, 4);
+    } else {
+        encode_byte(encoder, type | 27);
+        encode_uint(encoder, argument, 8);
+    }
+}
+
+static void encode_text(struct encoder *encoder, struct jsonString *string) {
+    size_t n = string->size ? string->size - 1 : 0;
+    encode_head(encoder, MAJOR_TEXT, n);
+    encode_bytes(encoder, string->data, n);
+}
+
+static void encode_number(struct encoder *encoder, double number) {
+    int64_t integer;
+    if (number_is_int64(number, &integer)) {
+        if (integer >= 0) {
+            encode_head(encoder, MAJOR_UNSIGNED, integer);
+        } else {
+            encode_head(encoder, MAJOR_NEGATIVE, (uint64_t) -(integer + 1));
+        }
+    } else if (number_is_float(number)) {
+        encode_byte(encoder, FLOAT_SINGLE);
+        encode_float(encoder, (float) number);
+    } else {
+        encode_byte(encoder, FLOAT_DOUBLE);
+        encode_double(encoder, number);
+    }
+}
+
+static void encode_value(struct encoder *encoder, struct jsonValue *value) {
+    switch (value->kind) {
+    case JVK_STR:
+        encode_text(encoder, &value->v.string);
+        break;
+    case JVK_NUM:
+        encode_number(encoder, value->v.number);
+        break;
+    case JVK_OBJ: {
+        struct jsonObject *object = &value->v.object;
+        encode_head(encoder, MAJOR_MAP, object->size);
+        for (size_t i = 0; i < object->capacity; ++i) {
+            struct jsonObjectEntry *entry = &object->entries[i];
+            if (!entry->key || entry->key == &key_deleted) {
+                continue;
+            }
+            encode_text(encoder, entry->key);
+            encode_value(encoder, entry->value);
+        }
+        break;
+    }
+    case JVK_ARR: {
+        struct jsonArray *array = &value->v.array;
+        encode_head(encoder, MAJOR_ARRAY, array->size);
+        for (size_t i = 0; i < array->size; ++i) {
+            encode_value(encoder, array->values[i]);
+        }
+        break;
+    }
+    case JVK_BOOL:
+        encode_byte(encoder, value->v.boolean ? SIMPLE_TRUE : SIMPLE_FALSE);
+        break;
+    case JVK_NULL:
+    default:
+        encode_byte(encoder, SIMPLE_NULL);
+        break;
+    }
+}
+
+extern size_t cbor_encode(void *out, size_t size, struct jsonValue *value) {
+    struct encoder encoder;
+    encoder_init(&encoder, out, size);
+    encode_value(&encoder, value);
+    return encoder.position;
+}
+
+/* Additional information of the initial byte: the argument itself, or the
+ * number of bytes that follow and hold it. */
+static bool decode_argument(struct decoder *decoder, unsigned info, uint64_t *argument) {
+    if (info < 24) {
+        *argument = info;
+        return true;
+    }
+    if (info <= 27) {
+        return decode_uint(decoder, 1 << (info - 24), argument);
+    }
+    input_error(JSON_ERROR_SYNTAX, "malformed CBOR item", decoder->offset - 1);
+    return false;
+}
+
+static double half_to_double(uint16_t half) {
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double value;
+    if (exponent == 0) {
+        value = ldexp(mantissa, -24);
+    } else if (exponent != 31) {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    } else {
+        value = mantissa ? NAN : INFINITY;
+    }
+    return half & 0x8000 ? -value : value;
+}
+
+/* Text string as a span of the input. Chunks of indefinite length strings are
+ * joined into *joined which caller must free. */
+static bool decode_text(struct decoder *decoder, unsigned info, const unsigned char **bytes, size_t *n,
+        unsigned char **joined) {
+    uint64_t length;
+    *joined = NULL;
+    if (info != INFO_INDEFINITE) {
+        if (!decode_argument(decoder, info, &length)) {
+            return false;
+        }
+        *bytes = decode_bytes(decoder, length);
+        *n = length;
+        return *bytes;
+    }
+    size_t start = decoder->offset;
+    size_t total = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        decoder->offset = start;
+        size_t position = 0;
+        while (1) {
+            const unsigned char *type = decode_bytes(decoder, 1);
+            if (!type) {
+                goto fail;
+            }
+            if (*type == BREAK) {
+                break;
+            }
+            if (*type >> 5 != MAJOR_TEXT || (*type & 0x1F) == INFO_INDEFINITE) {
+                input_error(JSON_ERROR_SYNTAX, "malformed CBOR text chunk", decoder->offset - 1);
+                goto fail;
+            }
+            if (!decode_argument(decoder, *type & 0x1F, &length)) {
+                goto fail;
+            }
+            const unsigned char *chunk = decode_bytes(decoder, length);
+            if (!chunk) {
+                goto fail;
+            }
+            if (pass) {
+                memcpy(*joined + position, chunk, length);
+            }
+            position += length;
+        }
+        total = position;
+        if (!pass && !(*joined = json_malloc(total + 1))) {
+            return false;
+        }
+    }
+    *bytes = *joined;
+    *n = total;
+    return true;
+fail:
+    json_free(*joined);
+    *joined = NULL;
+    return false;
+}
+
+static struct jsonValue *decode_value(struct decoder *decoder);
+
+static struct jsonValue *decode_array(struct decoder *decoder, unsigned info) {
+    uint64_t length = 0;
+    bool indefinite = info == INFO_INDEFINITE;
+    if (!indefinite && !decode_argument(decoder, info, &length)) {
+        return NULL;
+    }
+    struct jsonValue *array = json_create_array(indefinite ? 0 : decoder_capacity_hint(decoder, length, 1));
+    if (!array) {
+        return NULL;
+    }
+    for (uint64_t i = 0; indefinite || i < length; ++i) {
+        if (indefinite && decoder->offset < decoder->size && decoder->in[decoder->offset] == BREAK) {
+            ++decoder->offset;
+            break;
+        }
+        struct jsonValue *element = decode_value(decoder);
+        if (!element) {
+            goto fail;
+        }
+        if (!array_append(&array->v.array, element)) {
+            json_value_free(element);
+            goto fail;
+        }
+    }
+    return array;
+fail:
+    json_value_free(array);
+    return NULL;
+}
+
+static struct jsonValue *decode_map(struct decoder *decoder, unsigned info) {
+    uint64_t length = 0;
+    bool indefinite = info == INFO_INDEFINITE;
+    if (!indefinite && !decode_argument(decoder, info, &length)) {
+        return NULL;
+    }
+    struct jsonValue *object = json_create_object(indefinite ? 0 : decoder_capacity_hint(decoder, length, 2));
+    if (!object) {
+        return NULL;
+    }
+    for (uint64_t i = 0; indefinite || i < length; ++i) {
+        const unsigned char *type = decode_bytes(decoder, 1);
+        if (!type) {
+            goto fail;
+        }
+        if (indefinite && *type == BREAK) {
+            break;
+        }
+        if (*type >> 5 != MAJOR_TEXT) {
+            input_error(JSON_ERROR_UNSUPPORTED, "CBOR map key is not a text string", decoder->offset - 1);
+            goto fail;
+        }
+        const unsigned char *bytes;
+        size_t n;
+        unsigned char *joined;
+        if (!decode_text(decoder, *type & 0x1F, &bytes, &n, &joined)) {
+            goto fail;
+        }
+        struct jsonString *key = decoded_key(bytes, n);
+        json_free(joined);
+        if (!key) {
+            goto fail;
+        }
+        struct jsonValue *value = decode_value(decoder);
+        if (!value || !object_add(&object->v.object, key, value)) {
+            string_free(key);
+            json_value_free(value);
+            goto fail;
+        }
+    }
+    return object;
+fail:
+    json_value_free(object);
+    return NULL;
+}
+
+static struct jsonValue *decode_simple(struct decoder *decoder, unsigned char type) {
+    uint64_t bits;
+    double number;
+    switch (type) {
+    case SIMPLE_FALSE:
+        return json_create_boolean(false);
+    case SIMPLE_TRUE:
+        return json_create_boolean(true);
+    case SIMPLE_NULL:
+    case SIMPLE_NULL + 1: // undefined
+        return json_create_null();
+    case 0xF9:
+        if (!decode_uint(decoder, 2, &bits)) {
+            return NULL;
+        }
+        return json_create_number(half_to_double((uint16_t) bits));
+    case FLOAT_SINGLE:
+        if (!decode_float(decoder, &number)) {
+            return NULL;
+        }
+        return json_create_number(number);
+    case FLOAT_DOUBLE:
+        if (!decode_double(decoder, &number)) {
+            return NULL;
+        }
+        return json_create_number(number);
+    default:
+        input_error(JSON_ERROR_UNSUPPORTED, "unsupported CBOR simple value", decoder->offset - 1);
+        return NULL;
+    }
+}
+
+static struct jsonValue *decode_item(struct decoder *decoder) {
+    const unsigned char *type = decode_bytes(decoder, 1);
+    if (!type) {
+        return NULL;
+    }
+    unsigned info = *type & 0x1F;
+    uint64_t argument;
+    switch (*type >> 5) {
+    case MAJOR_UNSIGNED:
+        if (!decode_argument(decoder, info, &argument)) {
+            return NULL;
+        }
+        return json_create_number((double) argument);
+    case MAJOR_NEGATIVE:
+        if (!decode_argument(decoder, info, &argument)) {
+            return NULL;
+        }
+        return json_create_number(-1.0 - (double) argument);
+    case MAJOR_TEXT: {
+        const unsigned char *bytes;
+        size_t n;
+        unsigned char *joined;
+        if (!decode_text(decoder, info, &bytes, &n, &joined)) {
+            return NULL;
+        }
+        struct jsonValue *string = decoded_string(bytes, n);
+        json_free(joined);
+        return string;
+    }
+    case MAJOR_ARRAY:
+        return decode_array(decoder, info);
+    case MAJOR_MAP:
+        return decode_map(decoder, info);
+    case MAJOR_TAG:
+        // tags only annotate the item that follows
+        if (!decode_argument(decoder, info, &argument)) {
+            return NULL;
+        }
+        return decode_value(decoder);
+    case MAJOR_SIMPLE:
+        return decode_simple(decoder, *type);
+    case MAJOR_BYTES:
+    default:
+        input_error(JSON_ERROR_UNSUPPORTED, "CBOR byte strings are not supported", decoder->offset - 1);
+        return NULL;
+    }
+}
+
+static struct jsonValue *decode_value(struct decoder *decoder) {
+    if (++decoder->depth > DECODER_MAX_DEPTH) {
+        input_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded", decoder->offset);
+        return NULL;
+    }
+    struct jsonValue *value = decode_item(decoder);
+    --decoder->depth;
+    return value;
+}
+
+extern struct jsonValue *cbor_decode(const void *buffer, size_t size, bool all) {
+    struct decoder decoder;
+    decoder_init(&decoder, buffer, size);
+    struct jsonValue *value = decode_value(&decoder);
+    if (all && value && decoder.offset != decoder.size) {
+        input_error(JSON_ERROR_SYNTAX, "trailing bytes", decoder.offset);
+        json_value_free(value);
+        value = NULL;
+    }
+    return value;
+}
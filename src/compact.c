@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+/* Fresh objects handed out in the order the tree is walked, so a subtree ends
+ * up next to its parent. Only nodes and key headers come from these runs,
+ * blocks of text, values and entries are just reallocated to their size. */
+struct compactor {
+    struct jsonValue *nodes;
+    struct jsonString *keys;
+    bool failed;
+};
+
+/* Moves text into a block of its exact size. On failure the old block is
+ * kept, it's still valid. */
+static void compact_string(struct compactor *compactor, struct jsonString *string) {
+    if (!string->data) {
+        return;
+    }
+    char *data = json_malloc(string->size);
+    if (!data) {
+        compactor->failed = true;
+        return;
+    }
+    memcpy(data, string->data, string->size);
+    json_free(string->data);
+    string->data = data;
+    string->capacity = string->size;
+}
+
+static struct jsonValue *compact_node(struct compactor *compactor, struct jsonValue *value);
+
+static void compact_array(struct compactor *compactor, struct jsonArray *array) {
+    if (!array->size) {
+        json_free(array->values);
+        array_init(array);
+    } else {
+        struct jsonValue **values = json_malloc(array->size * sizeof(struct jsonValue *));
+        if (values) {
+            memcpy(values, array->values, array->size * sizeof(struct jsonValue *));
+            json_free(array->values);
+            array->values = values;
+            array->capacity = array->size;
+        } else {
+            compactor->failed = true;
+        }
+    }
+    for (size_t i = 0; i < array->size; ++i) {
+        array->values[i] = compact_node(compactor, array->values[i]);
+    }
+}
+
+static void compact_object(struct compactor *compactor, struct jsonObject *object) {
+    if (!object_shrink(object)) {
+        compactor->failed = true;
+    }
+    for (size_t i = 0; i < object->capacity; ++i) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        if (!entry->key || entry->key == &key_deleted) {
+            continue;
+        }
+        struct jsonString *key = compactor->keys++;
+        *key = *entry->key;
+        pool_free(POOL_STRING, entry->key);
+        entry->key = key;
+        compact_string(compactor, key);
+        entry->value = compact_node(compactor, entry->value);
+    }
+}
+
+static void compact_children(struct compactor *compactor, struct jsonValue *value) {
+    switch (value->kind) {
+    case JVK_STR:
+        compact_string(compactor, &value->v.string);
+        break;
+    case JVK_ARR:
+        compact_array(compactor, &value->v.array);
+        break;
+    case JVK_OBJ:
+        compact_object(compactor, &value->v.object);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Shared values may be read by other threads and are left where they are. */
+static struct jsonValue *compact_node(struct compactor *compactor, struct jsonValue *value) {
+    if (value_is_snapshot(value) || value_is_sealed(value)) {
+        return value;
+    }
+    struct jsonValue *node = compactor->nodes++;
+    *node = *value;
+    pool_free(POOL_VALUE, value);
+    compact_children(compactor, node);
+    return node;
+}
+
+/* Returns unused objects of a run one by one, that's how they're freed. */
+static void give_back(enum poolKind kind, void *objects, size_t n, size_t size) {
+    for (size_t i = 0; i < n; ++i) {
+        pool_free(kind, (char *) objects + i * size);
+    }
+}
+
+/* The root stays where it is, so the caller's pointer remains valid. Nodes
+ * and keys below it are counted first, so they can be taken from runs of
+ * their own. */
+extern bool compact(struct jsonValue *value) {
+    assert(value);
+    if (value_is_sealed(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "value is shared");
+        return false;
+    }
+    struct jsonMemoryUsage usage;
+    if (!memory_usage(value, &usage)) {
+        return false;
+    }
+    struct compactor compactor = { NULL, NULL, false };
+    if (usage.nodes > 1 && !(compactor.nodes = pool_alloc_run(POOL_VALUE, usage.nodes - 1))) {
+        return false;
+    }
+    if (usage.keys && !(compactor.keys = pool_alloc_run(POOL_STRING, usage.keys))) {
+        give_back(POOL_VALUE, compactor.nodes, usage.nodes - 1, sizeof(struct jsonValue));
+        return false;
+    }
+    struct jsonValue *nodes = compactor.nodes;
+    struct jsonString *keys = compactor.keys;
+    compact_children(&compactor, value);
+    // Shared subtrees were counted, but not moved.
+    give_back(POOL_VALUE, compactor.nodes, usage.nodes - 1 - (size_t) (compactor.nodes - nodes),
+            sizeof(struct jsonValue));
+    give_back(POOL_STRING, compactor.keys, usage.keys - (size_t) (compactor.keys - keys), sizeof(struct jsonString));
+    return !compactor.failed;
+}
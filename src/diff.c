@@ -0,0 +1,268 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "json_internal.h"
+
+// Arrays whose differing middles need a bigger table than this are compared
+// element by element instead of being matched.
+#define MAX_TABLE_CELLS (1u << 20)
+
+struct differ {
+    struct jsonValue *patch;
+    struct jsonString path; // Kept terminated, the terminator isn't counted.
+};
+
+static bool push_key(struct differ *differ, const char *key) {
+    bool ok = string_append(&differ->path, '/');
+    for (; ok && *key; ++key) {
+        if (*key == '~') {
+            ok = string_append_mem(&differ->path, "~0", 2);
+        } else if (*key == '/') {
+            ok = string_append_mem(&differ->path, "~1", 2);
+        } else {
+            ok = string_append(&differ->path, *key);
+        }
+    }
+    if (!ok || !string_append(&differ->path, '\0')) {
+        return false;
+    }
+    --differ->path.size;
+    return true;
+}
+
+static bool push_index(struct differ *differ, size_t index) {
+    char text[24];
+    int n = snprintf(text, sizeof(text), "/%zu", index);
+    if (!string_append_mem(&differ->path, text, (size_t) n + 1)) {
+        return false;
+    }
+    --differ->path.size;
+    return true;
+}
+
+static void pop(struct differ *differ, size_t size) {
+    differ->path.size = size;
+    if (differ->path.data) {
+        differ->path.data[size] = '\0';
+    }
+}
+
+static bool add_member(struct jsonValue *object, const char *key, struct jsonValue *value) {
+    if (!value) {
+        return false;
+    }
+    struct jsonString *string = string_create_str(key);
+    if (!string || !object_add(&object->v.object, string, value)) {
+        string_free(string);
+        json_value_free(value);
+        return false;
+    }
+    return true;
+}
+
+/* Appends an operation on the current path. The value is copied. */
+static bool emit(struct differ *differ, const char *op, struct jsonValue *value) {
+    struct jsonValue *operation = json_create_object(value ? 3 : 2);
+    if (!operation) {
+        return false;
+    }
+    bool ok = add_member(operation, "op", json_create_string(op))
+        && add_member(operation, "path", json_create_string(differ->path.data ? differ->path.data : ""))
+        && (!value || add_member(operation, "value", json_copy(value)))
+        && array_append(&differ->patch->v.array, operation);
+    if (!ok) {
+        json_value_free(operation);
+    }
+    return ok;
+}
+
+static bool diff(struct differ *differ, struct jsonValue *left, struct jsonValue *right);
+
+static size_t count_values(struct jsonObject *object, const char *key) {
+    size_t n = 0;
+    for (struct jsonValue *value = object_next(object, key, NULL); value; value = object_next(object, key, value)) {
+        ++n;
+    }
+    return n;
+}
+
+/* Pointers only reach the last value of a key, so members are matched by
+ * their last values. */
+static bool diff_objects(struct differ *differ, struct jsonObject *left, struct jsonObject *right) {
+    size_t size = differ->path.size;
+    for (size_t i = 0; i < left->capacity; ++i) {
+        struct jsonString *key;
+        struct jsonValue *value;
+        object_get_entry(left, i, &key, &value);
+        if (!key || *object_slot_hashed(left, key->data, key->hash) != value) {
+            continue;
+        }
+        struct jsonValue **slot = right->capacity ? object_slot_hashed(right, key->data, key->hash) : NULL;
+        if (!push_key(differ, key->data)) {
+            return false;
+        }
+        bool ok = true;
+        if (slot) {
+            ok = diff(differ, value, *slot);
+        } else {
+            // Each removal uncovers the value added before.
+            size_t n = left->size == left->unique_size ? 1 : count_values(left, key->data);
+            for (size_t j = 0; ok && j < n; ++j) {
+                ok = emit(differ, "remove", NULL);
+            }
+        }
+        pop(differ, size);
+        if (!ok) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < right->capacity; ++i) {
+        struct jsonString *key;
+        struct jsonValue *value;
+        object_get_entry(right, i, &key, &value);
+        if (!key || *object_slot_hashed(right, key->data, key->hash) != value
+                || (left->capacity && object_slot_hashed(left, key->data, key->hash))) {
+            continue;
+        }
+        bool ok = push_key(differ, key->data) && emit(differ, "add", value);
+        pop(differ, size);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same(struct jsonValue *left, uint64_t left_hash, struct jsonValue *right, uint64_t right_hash) {
+    return left_hash == right_hash && values_are_equal(left, right);
+}
+
+/* Elements left[0, n) were replaced with right[0, m) at the position: the
+ * ones that pair up are diffed, the rest removed or added. */
+static bool diff_gap(struct differ *differ, struct jsonValue **left, size_t n, struct jsonValue **right, size_t m,
+        size_t *position) {
+    size_t size = differ->path.size;
+    for (size_t i = 0; i < n || i < m; ++i) {
+        bool ok = push_index(differ, *position);
+        if (i < n && i < m) {
+            ok = ok && diff(differ, left[i], right[i]);
+        } else if (i < n) {
+            ok = ok && emit(differ, "remove", NULL);
+        } else {
+            ok = ok && emit(differ, "add", right[i]);
+        }
+        pop(differ, size);
+        if (!ok) {
+            return false;
+        }
+        if (i < m) {
+            ++*position;
+        }
+    }
+    return true;
+}
+
+/* Elements that are the same at both ends are skipped, the middles are
+ * matched by their longest common subsequence. Hashes make most mismatches
+ * cheap to find. */
+static bool diff_arrays(struct differ *differ, struct jsonArray *left, struct jsonArray *right) {
+    struct jsonValue **a = left->values;
+    struct jsonValue **b = right->values;
+    size_t n = left->size;
+    size_t m = right->size;
+    size_t position = 0;
+    while (n && m && same(a[0], value_hash(a[0]), b[0], value_hash(b[0]))) {
+        ++a, ++b, --n, --m, ++position;
+    }
+    while (n && m && same(a[n - 1], value_hash(a[n - 1]), b[m - 1], value_hash(b[m - 1]))) {
+        --n, --m;
+    }
+    if (!n || !m || n >= MAX_TABLE_CELLS || m >= MAX_TABLE_CELLS || (n + 1) * (m + 1) > MAX_TABLE_CELLS) {
+        return diff_gap(differ, a, n, b, m, &position);
+    }
+    uint64_t *hashes = json_malloc((n + m) * sizeof(uint64_t));
+    uint32_t *lengths = json_malloc((n + 1) * (m + 1) * sizeof(uint32_t));
+    if (!hashes || !lengths) {
+        json_free(hashes);
+        json_free(lengths);
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        hashes[i] = value_hash(a[i]);
+    }
+    for (size_t j = 0; j < m; ++j) {
+        hashes[n + j] = value_hash(b[j]);
+    }
+    // lengths[i][j] is the length of the common subsequence of a[i, n) and b[j, m).
+#define LENGTH(i, j) lengths[(i) * (m + 1) + (j)]
+    for (size_t i = n + 1; i--;) {
+        for (size_t j = m + 1; j--;) {
+            if (i == n || j == m) {
+                LENGTH(i, j) = 0;
+            } else if (same(a[i], hashes[i], b[j], hashes[n + j])) {
+                LENGTH(i, j) = LENGTH(i + 1, j + 1) + 1;
+            } else {
+                uint32_t down = LENGTH(i + 1, j);
+                uint32_t right_length = LENGTH(i, j + 1);
+                LENGTH(i, j) = down > right_length ? down : right_length;
+            }
+        }
+    }
+    bool ok = true;
+    size_t i = 0;
+    size_t j = 0;
+    size_t gap_i = 0;
+    size_t gap_j = 0;
+    while (ok && i < n && j < m) {
+        if (LENGTH(i, j) == LENGTH(i + 1, j + 1) + 1 && same(a[i], hashes[i], b[j], hashes[n + j])) {
+            ok = diff_gap(differ, a + gap_i, i - gap_i, b + gap_j, j - gap_j, &position);
+            ++position;
+            gap_i = ++i;
+            gap_j = ++j;
+        } else if (LENGTH(i + 1, j) >= LENGTH(i, j + 1)) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+#undef LENGTH
+    json_free(hashes);
+    json_free(lengths);
+    return ok && diff_gap(differ, a + gap_i, n - gap_i, b + gap_j, m - gap_j, &position);
+}
+
+static bool diff(struct differ *differ, struct jsonValue *left, struct jsonValue *right) {
+    if (left == right) {
+        return true;
+    }
+    if (left->kind == right->kind && left->kind == JVK_OBJ) {
+        return diff_objects(differ, &left->v.object, &right->v.object);
+    }
+    if (left->kind == right->kind && left->kind == JVK_ARR) {
+        return diff_arrays(differ, &left->v.array, &right->v.array);
+    }
+    if (same(left, value_hash(left), right, value_hash(right))) {
+        return true;
+    }
+    return emit(differ, "replace", right);
+}
+
+/* Patch is built as the values are walked, operations on the same path
+ * follow each other in the order they must be applied. */
+extern struct jsonValue *diff_values(struct jsonValue *left, struct jsonValue *right) {
+    assert(left);
+    assert(right);
+    struct differ differ = { json_create_array(0), { 0 } };
+    if (!differ.patch) {
+        return NULL;
+    }
+    string_init(&differ.path);
+    bool ok = diff(&differ, left, right);
+    string_free_internal(&differ.path);
+    if (!ok) {
+        json_value_free(differ.patch);
+        return NULL;
+    }
+    return differ.patch;
+}
@@ -1,76 +1,53 @@
-#include <stdarg.h>
 #include <stdio.h>
 
 #include "json_internal.h"
 
-const char *error_out_of_memory = "out of memory";
+// Long enough for any message with its position.
+#define ERROR_TEXT_SIZE 256
 
-tss_t error_key;
+/* Errors are recorded as they are found, which must be cheap: invalid input
+ * is common. Text for json_strerror() is only put together when asked for. */
+static thread_local struct jsonError last = { JSON_ERROR_NONE, "", 0, 0, 0 };
+static thread_local bool has_offset;
+static thread_local char text[ERROR_TEXT_SIZE];
 
-static void free_error(void *error) {
-    if (!error || error == error_out_of_memory) {
-        return;
-    }
-    json_free(error);
+extern void clear_error(void) {
+    set_error(JSON_ERROR_NONE, "");
 }
 
-extern bool error_init(void) {
-    return thrd_success == tss_create(&error_key, free_error);
+extern void set_error(enum jsonErrorCode code, const char *message) {
+    last.code = code;
+    last.message = message;
+    last.offset = 0;
+    last.line = 0;
+    last.column = 0;
+    has_offset = false;
 }
 
-extern void error_exit(void) {
-    char *error = tss_get(error_key);
-    free_error(error);
-    tss_delete(error_key);
+extern void input_error(enum jsonErrorCode code, const char *message, size_t offset) {
+    set_error(code, message);
+    last.offset = offset;
+    has_offset = true;
 }
 
-extern void set_error(const char *e) {
-    char *error = tss_get(error_key);
-    free_error(error);
-    tss_set(error_key, (char *) e);
-    if (e && e != error_out_of_memory) {
-        json_mem_detach((char *) e);
-    }
-}
-
-static char *vasprintf(const char *fmt, va_list args) {
-    va_list args_copy;
-    va_copy(args_copy, args);
-    int n = vsnprintf(NULL, 0, fmt, args_copy);
-    va_end(args_copy);
-    if (n < 0) {
-        return NULL;
-    }
-    char *text = json_malloc(n + 1);
-    if (!text) {
-        return NULL;
-    }
-    n = vsnprintf(text, n + 1, fmt, args);
-    if (n < 0) {
-        json_free(text);
-        return NULL;
-    }
-    return text;
+extern void text_error(enum jsonErrorCode code, const char *message, size_t offset, unsigned long line,
+        unsigned long column) {
+    input_error(code, message, offset);
+    last.line = line;
+    last.column = column;
 }
 
-static char *asprintf(const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    char *result = vasprintf(fmt, args);
-    va_end(args);
-    return result;
+extern const struct jsonError *error_last(void) {
+    return &last;
 }
 
-extern void errorf(const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    char *message = vasprintf(fmt, args);
-    va_end(args);
-    if (!message) {
-        set_error(NULL);
-        return;
+extern const char *error_text(void) {
+    if (last.line) {
+        snprintf(text, sizeof(text), "at %lu:%lu %s", last.line, last.column, last.message);
+    } else if (has_offset) {
+        snprintf(text, sizeof(text), "%s at byte %zu", last.message, last.offset);
+    } else {
+        return last.message;
     }
-    set_error(asprintf("at %u:%u %s", line, column, message));
-    json_free(message);
+    return text;
 }
-
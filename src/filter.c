@@ -0,0 +1,225 @@
+#include <assert.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+#define FILTER_INLINE_DEPTH 32
+
+/* Allowed keys form a tree: a node has a child for each key allowed below it.
+ * Nodes are numbered, the root is 0, so 0 also means no node. */
+struct filterNode {
+    const char *key;
+    unsigned hash;
+    size_t child;
+    size_t sibling;
+    bool whole; // Value is kept with everything inside of it.
+};
+
+struct filter {
+    size_t n;
+    struct jsonPointer **pointers; // Keys of nodes point into them.
+    size_t size;
+    struct filterNode nodes[];
+};
+
+static size_t find_child(const struct filter *filter, size_t node, const char *key, unsigned hash) {
+    for (size_t child = filter->nodes[node].child; child; child = filter->nodes[child].sibling) {
+        if (filter->nodes[child].hash == hash && !strcmp(filter->nodes[child].key, key)) {
+            return child;
+        }
+    }
+    return 0;
+}
+
+static void add_path(struct filter *filter, const struct jsonPointer *pointer) {
+    size_t node = 0;
+    for (size_t i = 0; i < pointer->size; ++i) {
+        const struct pointerSegment *segment = &pointer->segments[i];
+        size_t child = find_child(filter, node, segment->key, segment->hash);
+        if (!child) {
+            child = filter->size++;
+            filter->nodes[child] = (struct filterNode) { segment->key, segment->hash, 0, filter->nodes[node].child,
+                false };
+            filter->nodes[node].child = child;
+        }
+        node = child;
+    }
+    filter->nodes[node].whole = true;
+}
+
+extern struct filter *filter_compile(const char *const *paths, size_t n) {
+    struct jsonPointer **pointers = json_calloc((n + 1) * sizeof(struct jsonPointer *));
+    if (!pointers) {
+        return NULL;
+    }
+    size_t size = 1;
+    for (size_t i = 0; i < n; ++i) {
+        if (!(pointers[i] = pointer_compile(paths[i]))) {
+            goto fail;
+        }
+        size += pointers[i]->size;
+    }
+    struct filter *filter = json_malloc(sizeof(struct filter) + size * sizeof(struct filterNode));
+    if (!filter) {
+        goto fail;
+    }
+    filter->n = n;
+    filter->pointers = pointers;
+    filter->size = 1;
+    filter->nodes[0] = (struct filterNode) { "", 0, 0, 0, false };
+    for (size_t i = 0; i < n; ++i) {
+        add_path(filter, pointers[i]);
+    }
+    return filter;
+fail:
+    for (size_t i = 0; i < n; ++i) {
+        json_free(pointers[i]);
+    }
+    json_free(pointers);
+    return NULL;
+}
+
+extern void filter_free(struct filter *filter) {
+    if (!filter) {
+        return;
+    }
+    for (size_t i = 0; i < filter->n; ++i) {
+        json_free(filter->pointers[i]);
+    }
+    json_free(filter->pointers);
+    json_free(filter);
+}
+
+struct filterFrame {
+    struct jsonValue *container;
+    size_t node;
+    bool started;
+};
+
+/* Adds a value to the open container, or makes it the root. */
+static bool attach(struct filterFrame *stack, size_t depth, struct jsonValue **root, struct jsonString *key,
+        struct jsonValue *value) {
+    if (!depth) {
+        *root = value;
+        return true;
+    }
+    struct jsonValue *parent = stack[depth - 1].container;
+    if (parent->kind == JVK_ARR) {
+        if (!array_append(&parent->v.array, value)) {
+            json_value_free(value);
+            return false;
+        }
+        return true;
+    }
+    struct jsonString *copy = string_duplicate(key);
+    if (!copy) {
+        json_value_free(value);
+        return false;
+    }
+    if (!object_add(&parent->v.object, copy, value)) {
+        string_free(copy);
+        json_value_free(value);
+        return false;
+    }
+    return true;
+}
+
+/* Objects and arrays on the way to allowed keys are built as they're read,
+ * with only the members the filter allows. Allowed values are parsed whole,
+ * members that aren't allowed are only checked. Elements of arrays are
+ * filtered like the array itself. */
+extern struct jsonValue *filter_parse(const struct filter *filter, bool all, size_t max_depth) {
+    struct filterFrame inline_stack[FILTER_INLINE_DEPTH];
+    struct filterFrame *stack = inline_stack;
+    size_t capacity = FILTER_INLINE_DEPTH;
+    size_t depth = 0;
+    struct jsonValue *root = NULL;
+    struct jsonString key;
+    string_init(&key);
+    size_t node = 0;
+    size_t ignored = 0;
+    while (true) {
+        skip_spaces();
+        int c = parser_peek();
+        if (filter->nodes[node].whole || (c != '{' && c != '[')) {
+            struct jsonValue *value = parse_json_text(false, max_depth - depth);
+            if (!value || !attach(stack, depth, &root, &key, value)) {
+                goto fail;
+            }
+        } else {
+            if (depth == max_depth) {
+                parser_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded");
+                goto fail;
+            }
+            if (depth == capacity) {
+                size_t new_capacity = capacity * 2;
+                struct filterFrame *new_stack = json_realloc(stack == inline_stack ? NULL : stack,
+                        new_capacity * sizeof(*stack));
+                if (!new_stack) {
+                    goto fail;
+                }
+                if (stack == inline_stack) {
+                    memcpy(new_stack, inline_stack, sizeof(inline_stack));
+                }
+                stack = new_stack;
+                capacity = new_capacity;
+            }
+            struct jsonValue *value = c == '{' ? json_create_object(0) : json_create_array(0);
+            if (!value || !attach(stack, depth, &root, &key, value)) {
+                goto fail;
+            }
+            parser_consume_optionally(c == '{' ? "{" : "[");
+            stack[depth++] = (struct filterFrame) { value, node, false };
+        }
+        // Close finished containers and skip members that aren't allowed
+        // until a value to keep is expected.
+        while (depth) {
+            struct filterFrame *frame = &stack[depth - 1];
+            bool object = frame->container->kind == JVK_OBJ;
+            skip_spaces();
+            if (parser_consume_optionally(object ? "}" : "]")) {
+                --depth;
+                continue;
+            }
+            if (frame->started && !parser_consume(",", "',' was expected")) {
+                goto fail;
+            }
+            frame->started = true;
+            if (!object) {
+                node = frame->node;
+                break;
+            }
+            if (!parser_key(&key)) {
+                goto fail;
+            }
+            node = find_child(filter, frame->node, key.data, key.hash);
+            if (node) {
+                break;
+            }
+            skip_spaces();
+            if (!validate_json_text(false, max_depth - depth, &ignored, &ignored)) {
+                goto fail;
+            }
+        }
+        if (!depth) {
+            break;
+        }
+    }
+    skip_spaces();
+    if (all && EOF != parser_peek()) {
+        parser_error(JSON_ERROR_SYNTAX, "trailing bytes");
+        goto fail;
+    }
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    string_free_internal(&key);
+    return root;
+fail:
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    string_free_internal(&key);
+    json_value_free(root);
+    return NULL;
+}
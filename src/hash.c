@@ -0,0 +1,65 @@
+#include <string.h>
+
+#include "json_internal.h"
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9u;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebu;
+    h ^= h >> 31;
+    return h;
+}
+
+/* Equal values hash the same, so members of objects are summed up in any
+ * order. Shared containers never change, their hashes are kept in them once
+ * computed and dropped when they're unsealed. Other values are hashed anew
+ * every time, down to the shared containers below them. */
+extern uint64_t value_hash(struct jsonValue *value) {
+    atomic_ullong *kept = value_is_sealed(value) ? value_kept_hash(value) : NULL;
+    if (kept) {
+        uint64_t h = atomic_load_explicit(kept, memory_order_relaxed);
+        if (h) {
+            return h;
+        }
+    }
+    uint64_t h = value->kind;
+    switch (value->kind) {
+    case JVK_STR:
+        h += string_hash(value->v.string.data);
+        break;
+    case JVK_NUM: {
+        double number = value->v.number == 0 ? 0 : value->v.number; // -0 equals 0
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        h += bits;
+        break;
+    }
+    case JVK_BOOL:
+        h += value->v.boolean;
+        break;
+    case JVK_ARR:
+        for (size_t i = 0; i < value->v.array.size; ++i) {
+            h = mix(h) + value_hash(value->v.array.values[i]);
+        }
+        break;
+    case JVK_OBJ:
+        for (size_t i = 0; i < value->v.object.capacity; ++i) {
+            struct jsonString *key;
+            struct jsonValue *member;
+            object_get_entry(&value->v.object, i, &key, &member);
+            if (key) {
+                h += mix(string_hash(key->data) ^ mix(value_hash(member)));
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    h = mix(h);
+    h += !h; // 0 means no hash is kept
+    if (kept) {
+        atomic_store_explicit(kept, h, memory_order_relaxed);
+    }
+    return h;
+}
@@ -0,0 +1,100 @@
+#include <assert.h>
+
+#include "json_internal.h"
+
+#define INITIAL_CAPACITY 256
+
+// Owners a node may get from interning, well below the limit of its counter.
+#define MAX_SHARES (SHARE_SEALED >> 1)
+
+struct internEntry {
+    uint64_t hash;
+    struct jsonValue *value;
+};
+
+/* Values parsed so far, each different from the others. The table doesn't
+ * own them, the tree being parsed does. */
+static thread_local struct internEntry *table;
+static thread_local size_t capacity;
+static thread_local size_t size;
+
+static bool grow(void) {
+    size_t new_capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+    struct internEntry *new_table = json_calloc(new_capacity * sizeof(struct internEntry));
+    if (!new_table) {
+        return false;
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+        if (table[i].value) {
+            size_t j = table[i].hash & (new_capacity - 1);
+            while (new_table[j].value) {
+                j = (j + 1) & (new_capacity - 1);
+            }
+            new_table[j] = table[i];
+        }
+    }
+    json_free(table);
+    table = new_table;
+    capacity = new_capacity;
+    return true;
+}
+
+/* Returns an equal value seen before with one more owner, freeing the given
+ * one, or the given value itself. Either way the value returned is sealed.
+ * Children of the value must be interned already, so comparing them mostly
+ * comes down to comparing pointers and kept hashes. */
+static struct jsonValue *intern(struct jsonValue *value) {
+    if ((size + 1) * 2 > capacity && !grow()) {
+        return NULL;
+    }
+    if (!share_seal(value)) {
+        return NULL;
+    }
+    uint64_t hash = value_hash(value);
+    size_t i = hash & (capacity - 1);
+    for (; table[i].value; i = (i + 1) & (capacity - 1)) {
+        struct jsonValue *seen = table[i].value;
+        if (table[i].hash == hash && values_are_equal(seen, value)
+                && (atomic_load_explicit(&seen->shares, memory_order_relaxed) & ~SHARE_SEALED) < MAX_SHARES) {
+            json_value_free(value);
+            return share_acquire(seen);
+        }
+    }
+    table[i] = (struct internEntry) { hash, value };
+    ++size;
+    return value;
+}
+
+/* Interns children of a container that's just been parsed. The container
+ * itself is interned once its parent is complete, the root never is. */
+extern bool intern_children(struct jsonValue *container) {
+    if (container->kind == JVK_ARR) {
+        for (size_t i = 0; i < container->v.array.size; ++i) {
+            struct jsonValue *kept = intern(container->v.array.values[i]);
+            if (!kept) {
+                return false;
+            }
+            container->v.array.values[i] = kept;
+        }
+        return true;
+    }
+    assert(container->kind == JVK_OBJ);
+    for (size_t i = 0; i < container->v.object.capacity; ++i) {
+        struct jsonObjectEntry *entry = &container->v.object.entries[i];
+        if (entry->key && entry->key != &key_deleted) {
+            struct jsonValue *kept = intern(entry->value);
+            if (!kept) {
+                return false;
+            }
+            entry->value = kept;
+        }
+    }
+    return true;
+}
+
+extern void intern_end(void) {
+    json_free(table);
+    table = NULL;
+    capacity = 0;
+    size = 0;
+}
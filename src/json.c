@@ -4,49 +4,163 @@
 
 #include "json_internal.h"
 
+static const char error_shared[] =
+    "value is shared, get it with json_object_lookup_mut() or json_array_at_mut() to change it";
+
 extern bool json_init(void) {
-    return error_init();
+    return true;
 }
 
 extern void json_exit(void) {
-    error_exit();
+    pool_exit();
 }
 
-extern void value_free_internal(struct jsonValue *value) {
-    if (!value) {
+extern bool json_set_allocator(const struct jsonAllocator *allocator) {
+    if (allocator && (!allocator->allocate || !allocator->reallocate || !allocator->release)) {
+        return false;
+    }
+    allocator_set(allocator);
+    return true;
+}
+
+extern bool json_track_allocations(unsigned sample_period) {
+    return track_set(sample_period);
+}
+
+extern size_t json_allocation_sites(struct jsonAllocationSite *out, size_t size) {
+    if (!out && size) {
+        set_error(JSON_ERROR_ARGUMENT, "out == NULL");
+        return 0;
+    }
+    return track_sites(out, size);
+}
+
+extern void json_allocation_dump(FILE *out) {
+    if (!out) {
+        set_error(JSON_ERROR_ARGUMENT, "out == NULL");
         return;
     }
-    switch (value->kind) {
-    case JVK_STR:
+    track_dump(out);
+}
+
+extern bool json_memory_usage(struct jsonValue *value, struct jsonMemoryUsage *usage) {
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return false;
+    }
+    if (!usage) {
+        set_error(JSON_ERROR_ARGUMENT, "usage == NULL");
+        return false;
+    }
+    return memory_usage(value, usage);
+}
+
+extern bool json_compact(struct jsonValue *value) {
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return false;
+    }
+    return compact(value);
+}
+
+/* Drops an owner of a child. Returns the child if it's a container that has
+ * to be freed, anything else is freed right away. */
+static struct jsonValue *release_child(struct jsonValue *value) {
+    if (!value || value_is_snapshot(value) || !share_release(value)) {
+        return NULL;
+    }
+    if (value->kind == JVK_OBJ || value->kind == JVK_ARR) {
+        return value;
+    }
+    if (value->kind == JVK_STR) {
         string_free_internal(&value->v.string);
+    }
+    pool_free(POOL_VALUE, value);
+    return NULL;
+}
+
+/* Frees what the value holds without recursing, so every tree that can be
+ * built can be freed. Members are taken from the end of a container. While
+ * a child container is freed, the slot it was taken from holds the container
+ * above its parent, the slot itself is found again by the parent's size. */
+extern void value_free_internal(struct jsonValue *value) {
+    if (!value) {
         return;
-    case JVK_NUM:
-        return;
-    case JVK_OBJ:
-        object_free_internal(&value->v.object);
-        return;
-    case JVK_ARR:
-        array_free_internal(&value->v.array);
-        return;
-    case JVK_BOOL:
-        return;
-    case JVK_NULL:
-        return;
-    default:
-        assert(false);
+    }
+    struct jsonValue *root = value;
+    struct jsonValue *up = NULL;
+    while (true) {
+        struct jsonValue *child = NULL;
+        if (value->kind == JVK_ARR) {
+            struct jsonArray *array = &value->v.array;
+            while (!child && array->size) {
+                struct jsonValue **slot = &array->values[--array->size];
+                child = release_child(*slot);
+                *slot = up;
+            }
+        } else if (value->kind == JVK_OBJ) {
+            struct jsonObject *object = &value->v.object;
+            while (!child && object->capacity) {
+                struct jsonObjectEntry *entry = &object->entries[--object->capacity];
+                if (entry->key && entry->key != &key_deleted) {
+                    // Value is NULL only in a copy that failed halfway, see json_copy().
+                    string_free(entry->key);
+                    child = release_child(entry->value);
+                    entry->value = up;
+                }
+            }
+        }
+        if (child) {
+            up = value;
+            value = child;
+            continue;
+        }
+        switch (value->kind) {
+        case JVK_STR:
+            string_free_internal(&value->v.string);
+            break;
+        case JVK_OBJ:
+            json_free(value->v.object.entries);
+            object_init(&value->v.object);
+            break;
+        case JVK_ARR:
+            array_free_internal(&value->v.array);
+            break;
+        case JVK_NUM:
+        case JVK_BOOL:
+        case JVK_NULL:
+            break;
+        default:
+            assert(false);
+        }
+        if (value == root) {
+            return;
+        }
+        pool_free(POOL_VALUE, value);
+        value = up;
+        up = value->kind == JVK_ARR ? value->v.array.values[value->v.array.size]
+            : value->v.object.entries[value->v.object.capacity].value;
     }
 }
 
+extern struct jsonValue *value_alloc(void) {
+    struct jsonValue *value = pool_alloc(POOL_VALUE);
+    if (value) {
+        atomic_init(&value->shares, 0);
+    }
+    return value;
+}
+
 extern void json_value_free(struct jsonValue *value) {
-    if (!value) {
+    if (!value || value_is_snapshot(value) || !share_release(value)) {
         return;
     }
     value_free_internal(value);
-    json_free(value);
+    pool_free(POOL_VALUE, value);
 }
 
 extern struct jsonValue *json_create_number(double number) {
-    struct jsonValue *json = json_malloc(sizeof(struct jsonValue));
+    struct jsonValue *json = value_alloc();
     if (!json) {
         return NULL;
     }
@@ -57,23 +171,23 @@ extern struct jsonValue *json_create_number(double number) {
 
 extern struct jsonValue *json_create_string(const char *string) {
     if (!string) {
-        errorf("string == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "string == NULL");
         return NULL;
     }
-    struct jsonValue *json = json_malloc(sizeof(struct jsonValue));
+    struct jsonValue *json = value_alloc();
     if (!json) {
         return NULL;
     }
     json->kind = JVK_STR;
     if (!string_init_str(&json->v.string, string)) {
-        json_free(json);
+        pool_free(POOL_VALUE, json);
         return NULL;
     }
     return json;
 }
 
 extern struct jsonValue *json_create_object(size_t initial_capacity) {
-    struct jsonValue *json = json_malloc(sizeof(struct jsonValue));
+    struct jsonValue *json = value_alloc();
     if (!json) {
         return NULL;
     }
@@ -81,14 +195,14 @@ extern struct jsonValue *json_create_object(size_t initial_capacity) {
     object_init(&json->v.object);
     if (!object_reserve(&json->v.object, initial_capacity)) {
         object_free_internal(&json->v.object);
-        json_free(json);
+        pool_free(POOL_VALUE, json);
         return NULL;
     }
     return json;
 }
 
 extern struct jsonValue *json_create_array(size_t initial_capacity) {
-    struct jsonValue *json = json_malloc(sizeof(struct jsonValue));
+    struct jsonValue *json = value_alloc();
     if (!json) {
         return NULL;
     }
@@ -96,14 +210,14 @@ extern struct jsonValue *json_create_array(size_t initial_capacity) {
     array_init(&json->v.array);
     if (!array_reserve(&json->v.array, initial_capacity)) {
         array_free_internal(&json->v.array);
-        json_free(json);
+        pool_free(POOL_VALUE, json);
         return NULL;
     }
     return json;
 }
 
 extern struct jsonValue *json_create_boolean(bool boolean) {
-    struct jsonValue *json = json_malloc(sizeof(struct jsonValue));
+    struct jsonValue *json = value_alloc();
     if (!json) {
         return NULL;
     }
@@ -113,7 +227,7 @@ extern struct jsonValue *json_create_boolean(bool boolean) {
 }
 
 extern struct jsonValue *json_create_null(void) {
-    struct jsonValue *json = json_malloc(sizeof(struct jsonValue));
+    struct jsonValue *json = value_alloc();
     if (!json) {
         return NULL;
     }
@@ -123,16 +237,20 @@ extern struct jsonValue *json_create_null(void) {
 
 extern bool json_get_number(struct jsonValue *number, double *value) {
     if (!value) {
-        errorf("value == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
         return false;
     }
     if (!number) {
-        errorf("number == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "number == NULL");
         *value = NAN;
         return false;
     }
+    if (number->kind == (JVK_SNAPSHOT | JVK_NUM)) {
+        *value = snapshot_number(number);
+        return true;
+    }
     if (number->kind != JVK_NUM) {
-        errorf("argument is not json number");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json number");
         *value = NAN;
         return false;
     }
@@ -142,16 +260,20 @@ extern bool json_get_number(struct jsonValue *number, double *value) {
 
 extern bool json_get_string(struct jsonValue *string, const char **value) {
     if (!value) {
-        errorf("value == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
         return false;
     }
     if (!string) {
-        errorf("string == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "string == NULL");
         *value = NULL;
         return false;
     }
+    if (string->kind == (JVK_SNAPSHOT | JVK_STR)) {
+        *value = snapshot_string(string);
+        return true;
+    }
     if (string->kind != JVK_STR) {
-        errorf("argument is not json string");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json string");
         *value = NULL;
         return false;
     }
@@ -161,16 +283,20 @@ extern bool json_get_string(struct jsonValue *string, const char **value) {
 
 extern bool json_get_boolean(struct jsonValue *boolean, bool *value) {
     if (!value) {
-        errorf("value == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
         return false;
     }
     if (!boolean) {
-        errorf("boolean == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "boolean == NULL");
         *value = false;
         return false;
     }
+    if (boolean->kind == (JVK_SNAPSHOT | JVK_BOOL)) {
+        *value = snapshot_boolean(boolean);
+        return true;
+    }
     if (boolean->kind != JVK_BOOL) {
-        errorf("argument is not json boolean");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json boolean");
         *value = false;
         return false;
     }
@@ -180,15 +306,15 @@ extern bool json_get_boolean(struct jsonValue *boolean, bool *value) {
 
 extern bool json_set_number(struct jsonValue *number, double value) {
     if (!number) {
-        errorf("number == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "number == NULL");
         return false;
     }
     if (number->kind != JVK_NUM) {
-        errorf("argument is not json number");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json number");
         return false;
     }
-    if (!value) {
-        errorf("value == NULL");
+    if (value_is_sealed(number)) {
+        set_error(JSON_ERROR_READ_ONLY, error_shared);
         return false;
     }
     number->v.number = value;
@@ -197,15 +323,19 @@ extern bool json_set_number(struct jsonValue *number, double value) {
 
 extern bool json_set_string(struct jsonValue *string, const char *value) {
     if (!string) {
-        errorf("string == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "string == NULL");
         return false;
     }
     if (string->kind != JVK_STR) {
-        errorf("argument is not json string");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json string");
+        return false;
+    }
+    if (value_is_sealed(string)) {
+        set_error(JSON_ERROR_READ_ONLY, error_shared);
         return false;
     }
     if (!value) {
-        errorf("value == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
         return false;
     }
     string_free_internal(&string->v.string);
@@ -214,15 +344,15 @@ extern bool json_set_string(struct jsonValue *string, const char *value) {
 
 extern bool json_set_boolean(struct jsonValue *boolean, bool value) {
     if (!boolean) {
-        errorf("boolean == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "boolean == NULL");
         return false;
     }
     if (boolean->kind != JVK_BOOL) {
-        errorf("argument is not json boolean");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json boolean");
         return false;
     }
-    if (!value) {
-        errorf("value == NULL");
+    if (value_is_sealed(boolean)) {
+        set_error(JSON_ERROR_READ_ONLY, error_shared);
         return false;
     }
     boolean->v.boolean = value;
@@ -231,15 +361,23 @@ extern bool json_set_boolean(struct jsonValue *boolean, bool value) {
 
 extern bool json_array_append(struct jsonValue *array, struct jsonValue *value) {
     if (!array) {
-        errorf("array == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "array == NULL");
         return false;
     }
     if (!value) {
-        errorf("value == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
         return false;
     }
     if (array->kind != JVK_ARR) {
-        errorf("argument is not json array");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json array");
+        return false;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return false;
+    }
+    if (value_is_sealed(array)) {
+        set_error(JSON_ERROR_READ_ONLY, error_shared);
         return false;
     }
     return array_append(&array->v.array, value);
@@ -247,11 +385,14 @@ extern bool json_array_append(struct jsonValue *array, struct jsonValue *value)
 
 extern size_t json_array_size(struct jsonValue *array) {
     if (!array) {
-        errorf("array == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "array == NULL");
         return false;
     }
+    if (array->kind == (JVK_SNAPSHOT | JVK_ARR)) {
+        return snapshot_size(array);
+    }
     if (array->kind != JVK_ARR) {
-        errorf("argument is not json array");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json array");
         return false;
     }
     return array ? array->v.array.size : 0;
@@ -259,62 +400,226 @@ extern size_t json_array_size(struct jsonValue *array) {
 
 extern struct jsonValue *json_array_at(struct jsonValue *array, size_t index) {
     if (!array) {
-        errorf("array == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "array == NULL");
         return false;
     }
+    if (array->kind == (JVK_SNAPSHOT | JVK_ARR)) {
+        return snapshot_array_at(array, index);
+    }
     if (array->kind != JVK_ARR) {
-        errorf("argument is not json array");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json array");
         return false;
     }
     return (array && index < array->v.array.size) ? array->v.array.values[index] : NULL;
 }
 
+extern struct jsonValue *json_array_at_mut(struct jsonValue *array, size_t index) {
+    if (!array) {
+        set_error(JSON_ERROR_ARGUMENT, "array == NULL");
+        return NULL;
+    }
+    if (array->kind != JVK_ARR) {
+        set_error(JSON_ERROR_ARGUMENT, "argument is not changeable json array");
+        return NULL;
+    }
+    if (value_is_sealed(array)) {
+        set_error(JSON_ERROR_READ_ONLY, error_shared);
+        return NULL;
+    }
+    if (index >= array->v.array.size) {
+        set_error(JSON_ERROR_ARGUMENT, "index out of range");
+        return NULL;
+    }
+    return share_unshare(&array->v.array.values[index]);
+}
+
 extern const char *json_strerror(void) {
-    char *error = tss_get(error_key);
-    return error ? error : "";
+    return error_text();
+}
+
+extern const struct jsonError *json_last_error(void) {
+    return error_last();
 }
 
 extern struct jsonValue *json_parse(const char *json, bool all) {
     if (!json) {
-        errorf("json == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "json == NULL");
+        return NULL;
+    }
+    struct jsonParseOptions options = { .allow_trailing_bytes = !all };
+    return json_parse_with(json, strlen(json), &options);
+}
+
+struct jsonValue *json_parse_mem(const char *buffer, size_t size, bool all) {
+    struct jsonParseOptions options = { .allow_trailing_bytes = !all };
+    return json_parse_with(buffer, size, &options);
+}
+
+extern struct jsonValue *json_parse_with(const char *buffer, size_t size, const struct jsonParseOptions *options) {
+    if (!buffer) {
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
         return NULL;
     }
-    parser_begin(json, strlen(json));
-    struct jsonValue *value = parse_json_text(all);
+    static const struct jsonParseOptions defaults = { 0 };
+    if (!options) {
+        options = &defaults;
+    }
+    parser_begin(buffer, size, options);
+    if (options->share_equal_values) {
+        parser_intern();
+    }
+    struct jsonValue *value = parse_json_text(!options->allow_trailing_bytes,
+            options->max_depth ? options->max_depth : JSON_DEFAULT_MAX_DEPTH);
     parser_end();
-    assert(!!value != !!strcmp(json_strerror(), ""));
+    assert(!value == !!error_last()->code);
     return value;
 }
 
-struct jsonValue *json_parse_mem(const char *buffer, size_t size, bool all) {
+extern bool json_validate(const char *buffer, size_t size, const struct jsonParseOptions *options,
+        struct jsonValidation *validation) {
+    if (!buffer) {
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
+        return false;
+    }
+    static const struct jsonParseOptions defaults = { 0 };
+    if (!options) {
+        options = &defaults;
+    }
+    struct jsonValidation ignored;
+    if (!validation) {
+        validation = &ignored;
+    }
+    parser_begin(buffer, size, options);
+    bool result = validate_json_text(!options->allow_trailing_bytes,
+            options->max_depth ? options->max_depth : JSON_DEFAULT_MAX_DEPTH, &validation->depth, &validation->end);
+    parser_end();
+    assert(result == !error_last()->code);
+    return result;
+}
+
+extern struct jsonValue *json_parse_filtered(const char *buffer, size_t size, const char *const *allowed_keys,
+        size_t n, const struct jsonParseOptions *options) {
     if (!buffer) {
-        errorf("buffer == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
+        return NULL;
+    }
+    if (!allowed_keys && n) {
+        set_error(JSON_ERROR_ARGUMENT, "allowed_keys == NULL");
         return NULL;
     }
-    parser_begin(buffer, size);
-    struct jsonValue *value = parse_json_text(all);
+    for (size_t i = 0; i < n; ++i) {
+        if (!allowed_keys[i]) {
+            set_error(JSON_ERROR_ARGUMENT, "allowed_keys[i] == NULL");
+            return NULL;
+        }
+    }
+    static const struct jsonParseOptions defaults = { 0 };
+    if (!options) {
+        options = &defaults;
+    }
+    clear_error();
+    struct filter *filter = filter_compile(allowed_keys, n);
+    if (!filter) {
+        return NULL;
+    }
+    parser_begin(buffer, size, options);
+    struct jsonValue *value = filter_parse(filter, !options->allow_trailing_bytes,
+            options->max_depth ? options->max_depth : JSON_DEFAULT_MAX_DEPTH);
     parser_end();
-    assert(!!value != !!strcmp(json_strerror(), ""));
+    filter_free(filter);
+    assert(!value == !!error_last()->code);
     return value;
 }
 
-extern size_t json_pretty_print(char *out, size_t size, struct jsonValue *value) {
+extern size_t json_print(char *out, size_t size, struct jsonValue *value, const struct jsonPrintOptions *options) {
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return 0;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return 0;
+    }
+    struct printer printer;
+    printer_init(&printer, out, size, options);
+    if (!printer.size) {
+        return print_json_value_size(&printer, value);
+    }
+    bool result = print_json_value(&printer, value);
+    size = printer_finish(&printer);
+    return result ? size : 0;
+}
+
+extern size_t json_cbor_encode(void *out, size_t size, struct jsonValue *value) {
     if (!value) {
-        errorf("value == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return 0;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return 0;
+    }
+    return cbor_encode(out, size, value);
+}
+
+extern struct jsonValue *json_cbor_decode(const void *buffer, size_t size, bool all) {
+    if (!buffer) {
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
+        return NULL;
+    }
+    clear_error();
+    return cbor_decode(buffer, size, all);
+}
+
+extern size_t json_msgpack_encode(void *out, size_t size, struct jsonValue *value) {
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return 0;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
         return 0;
     }
-    pretty_print_begin(out, size);
-    print_json_value(value);
-    return pretty_print_end();
+    return msgpack_encode(out, size, value);
+}
+
+extern struct jsonValue *json_msgpack_decode(const void *buffer, size_t size, bool all) {
+    if (!buffer) {
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
+        return NULL;
+    }
+    clear_error();
+    return msgpack_decode(buffer, size, all);
+}
+
+extern size_t json_serialized_size(struct jsonValue *value, const struct jsonPrintOptions *options) {
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return 0;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return 0;
+    }
+    struct printer printer;
+    printer_init(&printer, NULL, 0, options);
+    return print_json_value_size(&printer, value);
+}
+
+extern size_t json_pretty_print(char *out, size_t size, struct jsonValue *value) {
+    return json_print(out, size, value, &json_pretty_options);
 }
 
 extern size_t json_object_number_of_keys(struct jsonValue *object) {
     if (!object) {
-        errorf("object == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "object == NULL");
         return 0;
     }
+    if (object->kind == (JVK_SNAPSHOT | JVK_OBJ)) {
+        return snapshot_unique_size(object);
+    }
     if (object->kind != JVK_OBJ) {
-        errorf("argument is not json object");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json object");
         return 0;
     }
     return object->v.object.unique_size;
@@ -322,11 +627,14 @@ extern size_t json_object_number_of_keys(struct jsonValue *object) {
 
 extern size_t json_object_number_of_values(struct jsonValue *object) {
     if (!object) {
-        errorf("object == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "object == NULL");
         return 0;
     }
+    if (object->kind == (JVK_SNAPSHOT | JVK_OBJ)) {
+        return snapshot_size(object);
+    }
     if (object->kind != JVK_OBJ) {
-        errorf("argument is not json object");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json object");
         return 0;
     }
     return object->v.object.size;
@@ -334,33 +642,50 @@ extern size_t json_object_number_of_values(struct jsonValue *object) {
 
 extern bool json_object_add(struct jsonValue *object, const char *key, struct jsonValue *value) {
     if (!object) {
-        errorf("object == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "object == NULL");
         return false;
     }
     if (object->kind != JVK_OBJ) {
-        errorf("argument is not json object");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json object");
         return false;
     }
     if (!key) {
-        errorf("key == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "key == NULL");
         return false;
     }
     if (!value) {
-        errorf("value == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return false;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return false;
+    }
+    if (value_is_sealed(object)) {
+        set_error(JSON_ERROR_READ_ONLY, error_shared);
         return false;
     }
-    struct jsonString *jkey = string_create();
-    string_init_str(jkey, key);
-    return object_add(&object->v.object, jkey, value);
+    struct jsonString *jkey = string_create_str(key);
+    if (!jkey) {
+        return false;
+    }
+    if (!object_add(&object->v.object, jkey, value)) {
+        string_free(jkey);
+        return false;
+    }
+    return true;
 }
 
 extern size_t json_object_capacity(struct jsonValue *object) {
     if (!object) {
-        errorf("object == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "object == NULL");
         return 0;
     }
+    if (object->kind == (JVK_SNAPSHOT | JVK_OBJ)) {
+        return snapshot_size(object);
+    }
     if (object->kind != JVK_OBJ) {
-        errorf("argument is not json object");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json object");
         return 0;
     }
     return object->v.object.capacity;
@@ -368,39 +693,57 @@ extern size_t json_object_capacity(struct jsonValue *object) {
 
 extern bool json_object_get_entry(struct jsonValue *object, size_t i, const char **key, struct jsonValue **value) {
     if (!object) {
-        errorf("object == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "object == NULL");
         return false;
     }
+    if (object->kind == (JVK_SNAPSHOT | JVK_OBJ)) {
+        if (snapshot_size(object) <= i) {
+            set_error(JSON_ERROR_ARGUMENT, "index out of range");
+            return false;
+        }
+        snapshot_object_get_entry(object, i, key, value);
+        return true;
+    }
     if (object->kind != JVK_OBJ) {
-        errorf("argument is not json object");
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json object");
         return false;
     }
     if (object->v.object.capacity <= i) {
-        errorf("index out of range");
+        set_error(JSON_ERROR_ARGUMENT, "index out of range");
         return false;
     }
     struct jsonString *jkey = NULL;
     object_get_entry(&object->v.object, i, &jkey, value);
-    if (jkey) {
-        *key = jkey->data;
-    }
+    *key = jkey ? jkey->data : NULL;
     return true;
 }
 
+extern struct jsonValue *json_object_get_value(struct jsonValue *object, size_t i) {
+    const char *key = NULL;
+    struct jsonValue *value = NULL;
+    if (!json_object_get_entry(object, i, &key, &value)) {
+        return NULL;
+    }
+    return value;
+}
+
 extern struct jsonValue *
 json_object_lookup_next(struct jsonValue *object, const char *key, struct jsonValue *value) {
     if (!object) {
-        errorf("object == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "object == NULL");
         return NULL;
     }
-    if (object->kind != JVK_OBJ) {
-        errorf("argument is not json object");
-        return false;
-    }
     if (!key) {
-        errorf("key == NULL");
+        set_error(JSON_ERROR_ARGUMENT, "key == NULL");
         return NULL;
     }
+    if (object->kind == (JVK_SNAPSHOT | JVK_OBJ)) {
+        return snapshot_object_next(object, key, string_hash(key), value);
+    }
+    if (object->kind != JVK_OBJ) {
+        set_error(JSON_ERROR_ARGUMENT, "argument is not json object");
+        return false;
+    }
     return object_next(&object->v.object, key, value);
 }
 
@@ -408,95 +751,166 @@ extern struct jsonValue *json_object_lookup(struct jsonValue *object, const char
     return json_object_lookup_next(object, key, NULL);
 }
 
-static struct jsonValue *duplicate_object(struct jsonObject *object) {
-    assert(object);
-    struct jsonValue *copy = json_create_object(object->size);
+extern struct jsonValue *json_object_lookup_mut(struct jsonValue *object, const char *key) {
+    if (!object) {
+        set_error(JSON_ERROR_ARGUMENT, "object == NULL");
+        return NULL;
+    }
+    if (!key) {
+        set_error(JSON_ERROR_ARGUMENT, "key == NULL");
+        return NULL;
+    }
+    if (object->kind != JVK_OBJ) {
+        set_error(JSON_ERROR_ARGUMENT, "argument is not changeable json object");
+        return NULL;
+    }
+    if (value_is_sealed(object)) {
+        set_error(JSON_ERROR_READ_ONLY, error_shared);
+        return NULL;
+    }
+    struct jsonValue **slot = object_slot(&object->v.object, key);
+    return slot ? share_unshare(slot) : NULL;
+}
+
+// Pending copies json_copy() keeps without allocating.
+#define COPY_INLINE_STACK 64
+
+/* Copies one node. Children of a container copy are the original ones until
+ * json_copy() gets to them. */
+static struct jsonValue *clone_node(struct jsonValue *value) {
+    if (value_is_snapshot(value)) {
+        return snapshot_copy(value);
+    }
+    struct jsonValue *copy = value_alloc();
     if (!copy) {
         return NULL;
     }
-    struct jsonString *key_copy = NULL;
-    struct jsonValue *value_copy = NULL;
-    size_t n = object->capacity;
-    for (size_t i = 0; i < n; ++i) {
-        struct jsonString *key = NULL;
-        struct jsonValue *value = NULL;
-        object_get_entry(object, i, &key, &value);
-        if (!key) {
-            continue;
-        }
-        key_copy = string_create_str(key->data);
-        if (!key_copy) {
-            goto fail;
-        }
-        value_copy = json_copy(value);
-        if (!value_copy) {
-            goto fail;
-        }
-        if (!object_add(&copy->v.object, key_copy, value_copy)) {
-            goto fail;
-        }
-        key_copy = NULL;
-        value_copy = NULL;
+    copy->kind = value->kind;
+    bool ok = true;
+    switch (value->kind) {
+    case JVK_STR:
+        ok = string_clone(&copy->v.string, &value->v.string);
+        break;
+    case JVK_OBJ:
+        ok = object_clone(&copy->v.object, &value->v.object);
+        break;
+    case JVK_ARR:
+        ok = array_clone(&copy->v.array, &value->v.array);
+        break;
+    default:
+        copy->v = value->v;
+        break;
+    }
+    if (!ok) {
+        pool_free(POOL_VALUE, copy);
+        return NULL;
     }
     return copy;
-fail:
-    string_free_internal(key_copy);
-    json_free(copy);
-    return NULL;
 }
 
-static struct jsonValue *duplicate_array(struct jsonArray *array) {
-    assert(array);
-    size_t n = array->size;
-    struct jsonValue *copy = json_create_array(n);
-    if (copy) {
-        return NULL;
+/* Slots of the copy that still point to original values are kept on a stack
+ * instead of recursing. Each one is replaced by a copy of its value, whose own
+ * slots go on the stack in reverse, so the copy is made in depth-first order. */
+extern struct jsonValue *json_copy(struct jsonValue *value) {
+    if (!value) {
+        return value;
     }
-    struct jsonValue *value_copy = NULL;
-    for (size_t i = 0; i < n; ++i) {
-        struct jsonValue *value = array->values[i];
-        assert(value);
-        value_copy = json_copy(value);
-        if (!value_copy) {
-            goto fail;
+    struct jsonValue *root = value;
+    struct jsonValue **inline_stack[COPY_INLINE_STACK];
+    struct jsonValue ***stack = inline_stack;
+    size_t capacity = COPY_INLINE_STACK;
+    size_t size = 0;
+    stack[size++] = &root;
+    while (size) {
+        struct jsonValue **slot = stack[--size];
+        struct jsonValue *original = *slot;
+        // Room for the children is made before the node is cloned, so slots
+        // of a copy point to original values only while they're on the stack.
+        size_t children = original->kind == JVK_ARR ? original->v.array.size
+            : original->kind == JVK_OBJ ? original->v.object.capacity : 0;
+        if (capacity - size < children) {
+            size_t new_capacity = capacity;
+            while (new_capacity - size < children) {
+                new_capacity *= 2;
+            }
+            struct jsonValue ***new_stack = json_realloc(stack == inline_stack ? NULL : stack,
+                    new_capacity * sizeof(*stack));
+            if (!new_stack) {
+                *slot = NULL;
+                goto fail;
+            }
+            if (stack == inline_stack) {
+                memcpy(new_stack, inline_stack, size * sizeof(*stack));
+            }
+            stack = new_stack;
+            capacity = new_capacity;
         }
-        if (!json_array_append(copy, value_copy)) {
+        struct jsonValue *copy = clone_node(original);
+        if (!copy) {
+            *slot = NULL;
             goto fail;
         }
+        *slot = copy;
+        if (value_is_snapshot(original)) {
+            continue;
+        }
+        if (copy->kind == JVK_ARR) {
+            for (size_t i = children; i--; ) {
+                stack[size++] = &copy->v.array.values[i];
+            }
+        } else if (copy->kind == JVK_OBJ) {
+            for (size_t i = children; i--; ) {
+                if (copy->v.object.entries[i].value) {
+                    stack[size++] = &copy->v.object.entries[i].value;
+                }
+            }
+        }
     }
-    return copy;
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    return root;
 fail:
-    json_free(value_copy);
+    // The copy mustn't free original values it still points to.
+    while (size) {
+        *stack[--size] = NULL;
+    }
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    json_value_free(root);
     return NULL;
 }
 
-extern struct jsonValue *json_copy(struct jsonValue *value) {
+extern struct jsonValue *json_copy_shared(struct jsonValue *value) {
     if (!value) {
-        return value;
-    }
-    switch (value->kind) {
-    case JVK_STR:
-        return json_create_string(value->v.string.data);
-    case JVK_NUM:
-        return json_create_number(value->v.number);
-    case JVK_OBJ:
-        return duplicate_object(&value->v.object);
-    case JVK_ARR:
-        return duplicate_array(&value->v.array);
-    case JVK_BOOL:
-        return json_create_boolean(value->v.boolean);
-    case JVK_NULL:
-        return json_create_null();
-    default:
-        assert(false);
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return NULL;
     }
+    return share_copy(value);
+}
+
+extern bool json_is_shared(struct jsonValue *value) {
+    return value && !value_is_snapshot(value) && value_is_sealed(value);
 }
 
 static thread_local struct jsonValue **left_diff;
 static thread_local struct jsonValue **right_diff;
+// Whether the caller wants the differing nodes, so comparison goes down to them.
+static thread_local bool locate_diff;
 
 static bool are_equal(struct jsonValue *left, struct jsonValue *right);
 
+/* How many values of the key equal the value. */
+static size_t count_equal(struct jsonObject *object, const char *key, struct jsonValue *value) {
+    size_t n = 0;
+    for (struct jsonValue *other = object_next(object, key, NULL); other; other = object_next(object, key, other)) {
+        n += are_equal(value, other);
+    }
+    return n;
+}
+
+/* Values of a repeated key must be the same on both sides, in any order. */
 static bool objects_are_equal(struct jsonObject *left, struct jsonObject *right) {
     assert(left->size == right->size);
     assert(left->unique_size == right->unique_size);
@@ -508,11 +922,18 @@ static bool objects_are_equal(struct jsonObject *left, struct jsonObject *right)
         if (!key) {
             continue;
         }
-        struct jsonValue *right_value = NULL;
-        do {
-            right_value = object_next(right, key->data, NULL);
-        } while (right_value && !are_equal(value, right_value));
-        if (!right_value) {
+        struct jsonValue *right_value = object_next(right, key->data, NULL);
+        if (left->size == left->unique_size) {
+            // Keys are unique on both sides, so members pair up.
+            if (!right_value) {
+                *left_diff = value;
+                *right_diff = NULL;
+                return false;
+            }
+            if (!are_equal(value, right_value)) {
+                return false;
+            }
+        } else if (count_equal(left, key->data, value) != count_equal(right, key->data, value)) {
             *left_diff = value;
             *right_diff = NULL;
             return false;
@@ -541,16 +962,28 @@ static bool are_equal(struct jsonValue *left, struct jsonValue *right) {
         result = false;
         goto end;
     }
+    if (left == right) {
+        return true;
+    }
     if (left->kind != right->kind) {
         result = false;
         goto end;
     }
+    // Only shared containers keep their hashes, the others would have to be hashed whole.
+    atomic_ullong *left_kept = value_kept_hash(left);
+    atomic_ullong *right_kept = value_kept_hash(right);
+    unsigned long long left_hash = left_kept ? atomic_load_explicit(left_kept, memory_order_relaxed) : 0;
+    unsigned long long right_hash = right_kept ? atomic_load_explicit(right_kept, memory_order_relaxed) : 0;
+    if (!locate_diff && left_hash && right_hash && left_hash != right_hash) {
+        result = false;
+        goto end;
+    }
     switch (left->kind) {
     case JVK_STR:
         result = !strcmp(left->v.string.data, right->v.string.data);
         break;
     case JVK_NUM:
-        result = left->v.boolean == right->v.boolean;
+        result = left->v.number == right->v.number;
         break;
     case JVK_OBJ:
         if (left->v.object.size != right->v.object.size
@@ -586,9 +1019,389 @@ end:
 extern bool json_are_equal(struct jsonValue *left, struct jsonValue *right,
         struct jsonValue **left_out, struct jsonValue **right_out) {
     struct jsonValue *stub;
+    if ((left && value_is_snapshot(left)) || (right && value_is_snapshot(right))) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return false;
+    }
     left_diff = left_out ? left_out : &stub;
     right_diff = right_out ? right_out : &stub;
+    locate_diff = left_out || right_out;
+    bool result = are_equal(left, right);
+    left_diff = right_diff = NULL;
+    return result;
+}
+
+extern bool values_are_equal(struct jsonValue *left, struct jsonValue *right) {
+    struct jsonValue *stub;
+    left_diff = right_diff = &stub;
+    locate_diff = false;
     bool result = are_equal(left, right);
     left_diff = right_diff = NULL;
     return result;
 }
+
+extern unsigned long long json_hash(struct jsonValue *value) {
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return 0;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return 0;
+    }
+    clear_error();
+    return value_hash(value);
+}
+
+extern size_t json_snapshot_encode(void *out, size_t size, struct jsonValue *value) {
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return 0;
+    }
+    clear_error();
+    return snapshot_encode(out, size, value);
+}
+
+extern bool json_snapshot_save(const char *path, struct jsonValue *value) {
+    if (!path) {
+        set_error(JSON_ERROR_ARGUMENT, "path == NULL");
+        return false;
+    }
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return false;
+    }
+    clear_error();
+    return snapshot_save(path, value);
+}
+
+extern struct jsonSnapshot *json_snapshot_open(const char *path) {
+    if (!path) {
+        set_error(JSON_ERROR_ARGUMENT, "path == NULL");
+        return NULL;
+    }
+    clear_error();
+    return snapshot_open(path);
+}
+
+extern struct jsonSnapshot *json_snapshot_open_mem(const void *buffer, size_t size) {
+    if (!buffer) {
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
+        return NULL;
+    }
+    clear_error();
+    return snapshot_open_mem(buffer, size);
+}
+
+extern struct jsonValue *json_snapshot_root(struct jsonSnapshot *snapshot) {
+    if (!snapshot) {
+        set_error(JSON_ERROR_ARGUMENT, "snapshot == NULL");
+        return NULL;
+    }
+    return snapshot_root(snapshot);
+}
+
+extern void json_snapshot_close(struct jsonSnapshot *snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    snapshot_close(snapshot);
+}
+
+extern struct jsonPointer *json_pointer_compile(const char *text) {
+    if (!text) {
+        set_error(JSON_ERROR_ARGUMENT, "text == NULL");
+        return NULL;
+    }
+    clear_error();
+    return pointer_compile(text);
+}
+
+extern struct jsonValue *json_pointer_get(const struct jsonPointer *pointer, struct jsonValue *value) {
+    if (!pointer) {
+        set_error(JSON_ERROR_ARGUMENT, "pointer == NULL");
+        return NULL;
+    }
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return NULL;
+    }
+    return pointer_get(pointer, value);
+}
+
+extern void json_pointer_free(struct jsonPointer *pointer) {
+    json_free(pointer);
+}
+
+extern bool json_patch_apply(struct jsonValue *target, struct jsonValue *patch) {
+    if (!target) {
+        set_error(JSON_ERROR_ARGUMENT, "target == NULL");
+        return false;
+    }
+    if (!patch) {
+        set_error(JSON_ERROR_ARGUMENT, "patch == NULL");
+        return false;
+    }
+    clear_error();
+    return patch_apply(target, patch);
+}
+
+extern bool json_merge_patch_apply(struct jsonValue *target, struct jsonValue *patch) {
+    if (!target) {
+        set_error(JSON_ERROR_ARGUMENT, "target == NULL");
+        return false;
+    }
+    if (!patch) {
+        set_error(JSON_ERROR_ARGUMENT, "patch == NULL");
+        return false;
+    }
+    clear_error();
+    return merge_patch_apply(target, patch);
+}
+
+extern struct jsonValue *json_diff(struct jsonValue *left, struct jsonValue *right) {
+    if (!left) {
+        set_error(JSON_ERROR_ARGUMENT, "left == NULL");
+        return NULL;
+    }
+    if (!right) {
+        set_error(JSON_ERROR_ARGUMENT, "right == NULL");
+        return NULL;
+    }
+    if (value_is_snapshot(left) || value_is_snapshot(right)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return NULL;
+    }
+    clear_error();
+    return diff_values(left, right);
+}
+
+extern struct jsonQuery *json_query_compile(const char *text) {
+    if (!text) {
+        set_error(JSON_ERROR_ARGUMENT, "text == NULL");
+        return NULL;
+    }
+    clear_error();
+    return query_compile(text);
+}
+
+extern size_t json_query_select(const struct jsonQuery *query, struct jsonValue *value, struct jsonValue **out,
+        size_t size) {
+    if (!query) {
+        set_error(JSON_ERROR_ARGUMENT, "query == NULL");
+        return 0;
+    }
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return 0;
+    }
+    if (!out && size) {
+        set_error(JSON_ERROR_ARGUMENT, "out == NULL");
+        return 0;
+    }
+    clear_error();
+    return query_select(query, value, out, size);
+}
+
+extern struct jsonValue *json_query_parse(const struct jsonQuery *query, const char *buffer, size_t size,
+        const struct jsonParseOptions *options) {
+    if (!query) {
+        set_error(JSON_ERROR_ARGUMENT, "query == NULL");
+        return NULL;
+    }
+    if (!buffer) {
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
+        return NULL;
+    }
+    static const struct jsonParseOptions defaults = { 0 };
+    if (!options) {
+        options = &defaults;
+    }
+    parser_begin(buffer, size, options);
+    struct jsonValue *value = query_parse(query, !options->allow_trailing_bytes,
+            options->max_depth ? options->max_depth : JSON_DEFAULT_MAX_DEPTH);
+    parser_end();
+    assert(!value == !!error_last()->code);
+    return value;
+}
+
+extern void json_query_free(struct jsonQuery *query) {
+    query_free(query);
+}
+
+extern struct jsonBinder *json_binder_compile(const struct jsonSchema *schema) {
+    if (!schema) {
+        set_error(JSON_ERROR_ARGUMENT, "schema == NULL");
+        return NULL;
+    }
+    clear_error();
+    return binder_compile(schema);
+}
+
+extern bool json_bind(const struct jsonBinder *binder, const char *buffer, size_t size, void *out,
+        const struct jsonParseOptions *options) {
+    if (!binder) {
+        set_error(JSON_ERROR_ARGUMENT, "binder == NULL");
+        return false;
+    }
+    if (!buffer) {
+        set_error(JSON_ERROR_ARGUMENT, "buffer == NULL");
+        return false;
+    }
+    if (!out) {
+        set_error(JSON_ERROR_ARGUMENT, "out == NULL");
+        return false;
+    }
+    static const struct jsonParseOptions defaults = { 0 };
+    if (!options) {
+        options = &defaults;
+    }
+    parser_begin(buffer, size, options);
+    bool result = bind_parse(binder, out, !options->allow_trailing_bytes,
+            options->max_depth ? options->max_depth : JSON_DEFAULT_MAX_DEPTH);
+    parser_end();
+    assert(result == !error_last()->code);
+    return result;
+}
+
+extern void json_bind_free(const struct jsonBinder *binder, void *out) {
+    if (binder && out) {
+        bind_free(binder, out);
+    }
+}
+
+extern void json_binder_free(struct jsonBinder *binder) {
+    binder_free(binder);
+}
+
+extern struct jsonWriter *json_writer_create(char *out, size_t size, const struct jsonPrintOptions *options,
+        bool validate) {
+    clear_error();
+    return writer_create_mem(out, size, options, validate);
+}
+
+extern struct jsonWriter *json_writer_create_sink(bool (*sink)(void *context, const char *data, size_t size),
+        void *context, const struct jsonPrintOptions *options, bool validate) {
+    if (!sink) {
+        set_error(JSON_ERROR_ARGUMENT, "sink == NULL");
+        return NULL;
+    }
+    clear_error();
+    return writer_create_sink(sink, context, options, validate);
+}
+
+extern bool json_writer_begin_object(struct jsonWriter *writer) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    return writer_begin_object(writer);
+}
+
+extern bool json_writer_end_object(struct jsonWriter *writer) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    return writer_end_object(writer);
+}
+
+extern bool json_writer_begin_array(struct jsonWriter *writer) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    return writer_begin_array(writer);
+}
+
+extern bool json_writer_end_array(struct jsonWriter *writer) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    return writer_end_array(writer);
+}
+
+extern bool json_writer_key(struct jsonWriter *writer, const char *key) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    if (!key) {
+        set_error(JSON_ERROR_ARGUMENT, "key == NULL");
+        return false;
+    }
+    return writer_key(writer, key, strlen(key));
+}
+
+extern bool json_writer_string(struct jsonWriter *writer, const char *string) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    if (!string) {
+        set_error(JSON_ERROR_ARGUMENT, "string == NULL");
+        return false;
+    }
+    return writer_string(writer, string, strlen(string));
+}
+
+extern bool json_writer_string_mem(struct jsonWriter *writer, const char *string, size_t size) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    if (!string && size) {
+        set_error(JSON_ERROR_ARGUMENT, "string == NULL");
+        return false;
+    }
+    return writer_string(writer, string ? string : "", size);
+}
+
+extern bool json_writer_number(struct jsonWriter *writer, double number) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    return writer_number(writer, number);
+}
+
+extern bool json_writer_boolean(struct jsonWriter *writer, bool boolean) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    return writer_boolean(writer, boolean);
+}
+
+extern bool json_writer_null(struct jsonWriter *writer) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    return writer_null(writer);
+}
+
+extern bool json_writer_value(struct jsonWriter *writer, struct jsonValue *value) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return false;
+    }
+    if (!value) {
+        set_error(JSON_ERROR_ARGUMENT, "value == NULL");
+        return false;
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values must be copied with json_copy() first");
+        return false;
+    }
+    return writer_value(writer, value);
+}
+
+extern size_t json_writer_finish(struct jsonWriter *writer) {
+    if (!writer) {
+        set_error(JSON_ERROR_ARGUMENT, "writer == NULL");
+        return 0;
+    }
+    return writer_finish(writer);
+}
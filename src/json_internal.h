@@ -3,35 +3,30 @@
 
 #include <json.h>
 
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <threads.h>
 #include <uchar.h>
 
-#ifndef RELEASE
-
-void *dbg_malloc(size_t size, const char *file, int line);
-void *dbg_calloc(size_t size, const char *file, int line);
-void *dbg_realloc(void *ptr, size_t size, const char *file, int line);
-void dbg_free(void *ptr, const char *file, int line);
-void dbg_mem_detach(void *ptr, const char *file, int line);
+// Every allocation passes its call site to the tracker, which only looks at
+// it when tracking is on. Debug builds always track.
+void *track_malloc(size_t size, const char *file, int line);
+void *track_calloc(size_t size, const char *file, int line);
+void *track_realloc(void *ptr, size_t size, const char *file, int line);
+void track_free(void *ptr);
+void track_detach(void *ptr);
+bool track_set(unsigned period);
+size_t track_sites(struct jsonAllocationSite *out, size_t size);
+void track_dump(FILE *out);
 bool dbg_is_memory_clear(void);
 void dbg_print_blocks(void);
 
-#define json_malloc(size)        dbg_malloc(size, __FILE__, __LINE__)
-#define json_calloc(size)        dbg_calloc(size, __FILE__, __LINE__)
-#define json_realloc(ptr, size)  dbg_realloc(ptr, size, __FILE__, __LINE__)
-#define json_free(ptr)           dbg_free(ptr, __FILE__, __LINE__)
-#define json_mem_detach(ptr)     dbg_mem_detach(ptr, __FILE__, __LINE__)
-
-#else
-
-#define json_malloc(size)        json_malloc_(size)
-#define json_calloc(size)        json_calloc_(size)
-#define json_realloc(ptr, size)  json_realloc_(ptr, size)
-#define json_free(ptr)           json_free_(ptr)
-#define json_mem_detach(ptr)
-
-#endif
+#define json_malloc(size)        track_malloc(size, __FILE__, __LINE__)
+#define json_calloc(size)        track_calloc(size, __FILE__, __LINE__)
+#define json_realloc(ptr, size)  track_realloc(ptr, size, __FILE__, __LINE__)
+#define json_free(ptr)           track_free(ptr)
+#define json_mem_detach(ptr)     track_detach(ptr)
 
 // Assertion that's computationally hard to evaluate.  This might be used to
 // check complex invariants.
@@ -48,19 +43,26 @@ struct jsonString {
     unsigned hash;
 };
 
+// Containers keep their structural hash once they're sealed and it's been
+// computed, 0 before, see hash.c. It fits in the union beside the other
+// members, so scalars don't pay for it.
+
 struct jsonArray {
     size_t capacity;
     size_t size;
     struct jsonValue **values;
+    atomic_ullong hash;
 };
 
 struct jsonObjectEntry;
 
 struct jsonObject {
-    size_t capacity;
-    size_t size;
-    size_t unique_size;
+    uint32_t capacity;
+    uint32_t size;
+    uint32_t unique_size;
+    uint32_t deleted; // Entries marked with key_deleted.
     struct jsonObjectEntry *entries;
+    atomic_ullong hash;
 };
 
 struct jsonObjectEntry {
@@ -71,6 +73,8 @@ struct jsonObjectEntry {
 
 struct jsonValue {
     enum jsonValueKind kind;
+    // Number of owners besides the first one and SHARE_SEALED, see share.c.
+    atomic_uint shares;
     union {
         double number;
         struct jsonString string;
@@ -84,43 +88,276 @@ void *json_malloc_(size_t size);
 void *json_calloc_(size_t size);
 void *json_realloc_(void *ptr, size_t size);
 void json_free_(void *ptr);
+void allocator_set(const struct jsonAllocator *allocator);
+
+// Fixed-size structures come from per-thread pools instead of json_malloc().
+enum poolKind {
+    POOL_VALUE, // struct jsonValue
+    POOL_STRING, // struct jsonString
+    POOL_KINDS
+};
+
+void *pool_alloc(enum poolKind kind);
+void *pool_alloc_run(enum poolKind kind, size_t n);
+void pool_free(enum poolKind kind, void *ptr);
+void pool_exit(void);
+// Objects handed out and not freed yet. Only counted in debug builds.
+size_t pool_live_objects(void);
+
+bool memory_usage(struct jsonValue *value, struct jsonMemoryUsage *usage);
+bool compact(struct jsonValue *value);
 
 struct jsonString *string_create(void);
 struct jsonString *string_create_str(const char *str);
+bool string_clone(struct jsonString *copy, const struct jsonString *string);
+struct jsonString *string_duplicate(const struct jsonString *string);
 void string_init(struct jsonString *string);
 bool string_init_str(struct jsonString *string, const char *str);
 bool string_init_mem(struct jsonString *string, const char *mem, size_t n);
 void string_free_internal(struct jsonString *string);
+void string_free(struct jsonString *string);
+void string_clear(struct jsonString *string);
 bool string_append(struct jsonString *string, char c);
+bool string_append_mem(struct jsonString *string, const char *mem, size_t n);
 bool string_shrink(struct jsonString *string);
 unsigned string_hash(const char *str);
 
 void array_init(struct jsonArray *array);
 void array_free_internal(struct jsonArray *array);
+bool array_clone(struct jsonArray *copy, const struct jsonArray *array);
 bool array_reserve(struct jsonArray *array, size_t new_capacity);
 bool array_double(struct jsonArray *array, size_t min_capacity);
 bool array_append(struct jsonArray *array, struct jsonValue *value);
 size_t array_size(struct jsonArray *array);
+bool array_insert(struct jsonArray *array, size_t index, struct jsonValue *value);
+struct jsonValue *array_remove(struct jsonArray *array, size_t index);
 
 extern const struct jsonString key_deleted;
 
 void object_init(struct jsonObject *object);
 void object_free_internal(struct jsonObject *object);
 bool object_reserve(struct jsonObject *object, size_t size);
+bool object_shrink(struct jsonObject *object);
+bool object_clone(struct jsonObject *copy, const struct jsonObject *object);
 bool object_add(struct jsonObject *object, struct jsonString *key, struct jsonValue *value);
 void object_get_entry(struct jsonObject *object, size_t i, struct jsonString **out_key, struct jsonValue **out_value);
 struct jsonValue *object_next(struct jsonObject *object, const char *key, struct jsonValue *prev);
 struct jsonValue *object_at(struct jsonObject *object, const char *key);
+struct jsonValue **object_slot(struct jsonObject *object, const char *key);
+struct jsonValue **object_slot_hashed(struct jsonObject *object, const char *key, unsigned hash);
+size_t object_index_of(struct jsonObject *object, struct jsonValue **slot);
+size_t object_find_id(struct jsonObject *object, unsigned hash, unsigned long long id);
+struct jsonObjectEntry object_remove(struct jsonObject *object, size_t i);
+void object_restore(struct jsonObject *object, size_t i, const struct jsonObjectEntry *entry);
 
+struct jsonValue *value_alloc(void);
 void value_free_internal(struct jsonValue *value);
 
-void parser_begin(const char *buffer, size_t n);
+// Nesting depth walked without allocating.
+#define WALK_INLINE_DEPTH 32
+
+// Container being walked and the position in it.
+struct walkFrame {
+    struct jsonValue *container;
+    size_t next; // Index of the next array value or object entry.
+    size_t count; // Members returned so far.
+    size_t mark; // Left to the code that walks.
+};
+
+// Depth-first walk that keeps open containers on a stack instead of recursing.
+struct walk {
+    struct walkFrame *frames;
+    size_t capacity;
+    size_t depth;
+    struct walkFrame inline_frames[WALK_INLINE_DEPTH];
+};
+
+void walk_init(struct walk *walk);
+void walk_free(struct walk *walk);
+bool walk_push(struct walk *walk, struct jsonValue *container);
+// Next member of the innermost container, NULL once there are none left.
+struct jsonValue *walk_next(struct walk *walk, struct jsonString **key);
+
+// Set in shares of values that may have several owners. Such values and
+// everything below them never change.
+#define SHARE_SEALED 0x80000000u
+
+#define value_is_sealed(value) \
+    (!!(atomic_load_explicit(&(value)->shares, memory_order_acquire) & SHARE_SEALED))
+
+// Where a container keeps its hash, NULL for scalars.
+#define value_kept_hash(value) \
+    ((value)->kind == JVK_ARR ? &(value)->v.array.hash : (value)->kind == JVK_OBJ ? &(value)->v.object.hash : NULL)
+
+bool share_seal(struct jsonValue *value);
+struct jsonValue *share_acquire(struct jsonValue *value);
+bool share_release(struct jsonValue *value);
+struct jsonValue *share_copy(struct jsonValue *value);
+struct jsonValue *share_unshare(struct jsonValue **slot);
+
+// Kind bit of values that live in a read-only snapshot. Such values aren't
+// struct jsonValue inside, see snapshot.c.
+#define JVK_SNAPSHOT 0x100
+
+#define value_is_snapshot(value) (!!((value)->kind & JVK_SNAPSHOT))
+
+size_t snapshot_encode(void *out, size_t size, struct jsonValue *value);
+bool snapshot_save(const char *path, struct jsonValue *value);
+struct jsonSnapshot *snapshot_open(const char *path);
+struct jsonSnapshot *snapshot_open_mem(const void *buffer, size_t size);
+struct jsonValue *snapshot_root(struct jsonSnapshot *snapshot);
+void snapshot_close(struct jsonSnapshot *snapshot);
+double snapshot_number(struct jsonValue *value);
+const char *snapshot_string(struct jsonValue *value);
+bool snapshot_boolean(struct jsonValue *value);
+size_t snapshot_size(struct jsonValue *value);
+size_t snapshot_unique_size(struct jsonValue *value);
+struct jsonValue *snapshot_array_at(struct jsonValue *value, size_t index);
+void snapshot_object_get_entry(struct jsonValue *value, size_t i, const char **key, struct jsonValue **out);
+struct jsonValue *snapshot_object_next(struct jsonValue *value, const char *key, unsigned hash,
+        struct jsonValue *prev);
+struct jsonValue *snapshot_copy(struct jsonValue *value);
+
+void parser_begin(const char *buffer, size_t n, const struct jsonParseOptions *options);
+void parser_intern(void);
 void parser_end(void);
-struct jsonValue *parse_json_text(bool all);
+struct jsonValue *parse_json_text(bool all, size_t max_depth);
+bool validate_json_text(bool all, size_t max_depth, size_t *deepest, size_t *end);
+// Pieces of the parser for code that reads text its own way.
+int parser_peek(void);
+void skip_spaces(void);
+bool parser_consume(const char *str, const char *message);
+bool parser_consume_optionally(const char *str);
+bool parser_key(struct jsonString *key);
+bool parser_string(struct jsonString *string);
+const char *parser_number(void);
+void parser_error(enum jsonErrorCode code, const char *message);
+
+// Reference token of a json pointer, unescaped and hashed.
+struct pointerSegment {
+    const char *key;
+    unsigned hash;
+    size_t index; // array index the key stands for, SIZE_MAX if none
+};
+
+struct jsonPointer {
+    size_t size;
+    struct pointerSegment segments[];
+};
+
+struct jsonPointer *pointer_compile(const char *text);
+struct jsonValue *pointer_get(const struct jsonPointer *pointer, struct jsonValue *value);
+
+bool intern_children(struct jsonValue *container);
+void intern_end(void);
+
+// json_are_equal() without reporting the difference.
+bool values_are_equal(struct jsonValue *left, struct jsonValue *right);
+uint64_t value_hash(struct jsonValue *value);
 
-void pretty_print_begin(char *out, size_t size);
-size_t pretty_print_end(void);
-void print_json_value(struct jsonValue *value);
+bool patch_apply(struct jsonValue *target, struct jsonValue *patch);
+bool merge_patch_apply(struct jsonValue *target, struct jsonValue *patch);
+struct jsonValue *diff_values(struct jsonValue *left, struct jsonValue *right);
+
+struct jsonQuery *query_compile(const char *text);
+void query_free(struct jsonQuery *query);
+size_t query_select(const struct jsonQuery *query, struct jsonValue *value, struct jsonValue **out, size_t size);
+struct jsonValue *query_parse(const struct jsonQuery *query, bool all, size_t max_depth);
+
+struct filter;
+struct filter *filter_compile(const char *const *paths, size_t n);
+void filter_free(struct filter *filter);
+struct jsonValue *filter_parse(const struct filter *filter, bool all, size_t max_depth);
+
+struct jsonBinder *binder_compile(const struct jsonSchema *schema);
+void binder_free(struct jsonBinder *binder);
+bool bind_parse(const struct jsonBinder *binder, void *out, bool all, size_t max_depth);
+void bind_free(const struct jsonBinder *binder, void *out);
+
+// Newline followed by this many indent characters is kept ready in a printer,
+// so most lines get their indentation with a single copy.
+#define PRINTER_INDENT_TABLE_SIZE 256
+
+// Text goes to out. With a sink, out is a buffer that's handed to the sink
+// whenever it fills up, position counts all the bytes and used only the ones
+// still in out. Without a sink both are the same.
+struct printer {
+    char *out;
+    size_t size;
+    size_t position;
+    size_t used;
+    bool (*sink)(void *context, const char *data, size_t size);
+    void *context;
+    bool failed;
+    unsigned depth;
+    struct jsonPrintOptions options;
+    size_t newline_size;
+    char indent[PRINTER_INDENT_TABLE_SIZE];
+};
+
+void printer_init(struct printer *printer, char *out, size_t size, const struct jsonPrintOptions *options);
+void printer_set_sink(struct printer *printer, bool (*sink)(void *, const char *, size_t), void *context);
+size_t printer_finish(struct printer *printer);
+void print_mem(struct printer *printer, const char *mem, size_t n);
+void print_char(struct printer *printer, char c);
+void print_newline(struct printer *printer);
+void print_string(struct printer *printer, const char *data, size_t n);
+void print_number(struct printer *printer, double number);
+bool print_json_value(struct printer *printer, struct jsonValue *value);
+size_t print_json_value_size(struct printer *printer, struct jsonValue *value);
+
+struct jsonWriter *writer_create_mem(char *out, size_t size, const struct jsonPrintOptions *options, bool validate);
+struct jsonWriter *writer_create_sink(bool (*sink)(void *, const char *, size_t), void *context,
+        const struct jsonPrintOptions *options, bool validate);
+bool writer_begin_object(struct jsonWriter *writer);
+bool writer_end_object(struct jsonWriter *writer);
+bool writer_begin_array(struct jsonWriter *writer);
+bool writer_end_array(struct jsonWriter *writer);
+bool writer_key(struct jsonWriter *writer, const char *key, size_t n);
+bool writer_string(struct jsonWriter *writer, const char *data, size_t n);
+bool writer_number(struct jsonWriter *writer, double number);
+bool writer_boolean(struct jsonWriter *writer, bool boolean);
+bool writer_null(struct jsonWriter *writer);
+bool writer_value(struct jsonWriter *writer, struct jsonValue *value);
+size_t writer_finish(struct jsonWriter *writer);
+
+// Depth limit for decoders of binary formats.
+#define DECODER_MAX_DEPTH 128
+
+struct encoder {
+    unsigned char *out;
+    size_t size;
+    size_t position;
+};
+
+struct decoder {
+    const unsigned char *in;
+    size_t size;
+    size_t offset;
+    unsigned depth;
+};
+
+void encoder_init(struct encoder *encoder, void *out, size_t size);
+void encode_byte(struct encoder *encoder, unsigned char byte);
+void encode_bytes(struct encoder *encoder, const void *bytes, size_t n);
+void encode_uint(struct encoder *encoder, uint64_t value, int n);
+void encode_double(struct encoder *encoder, double number);
+void encode_float(struct encoder *encoder, float number);
+bool number_is_int64(double number, int64_t *out);
+bool number_is_float(double number);
+void decoder_init(struct decoder *decoder, const void *in, size_t size);
+const unsigned char *decode_bytes(struct decoder *decoder, size_t n);
+bool decode_uint(struct decoder *decoder, int n, uint64_t *out);
+bool decode_double(struct decoder *decoder, double *out);
+bool decode_float(struct decoder *decoder, double *out);
+size_t decoder_capacity_hint(struct decoder *decoder, uint64_t length, size_t element_size);
+struct jsonValue *decoded_string(const unsigned char *bytes, size_t n);
+struct jsonString *decoded_key(const unsigned char *bytes, size_t n);
+
+size_t cbor_encode(void *out, size_t size, struct jsonValue *value);
+struct jsonValue *cbor_decode(const void *buffer, size_t size, bool all);
+size_t msgpack_encode(void *out, size_t size, struct jsonValue *value);
+struct jsonValue *msgpack_decode(const void *buffer, size_t size, bool all);
 
 enum c16Type {
     UTF16_NOT_SURROGATE,
@@ -134,18 +371,18 @@ char32_t c16pairtoc32(char16_t high, char16_t low);
 int c8len(char c);
 bool c32toc8(char32_t c32, int *n, char *c8);
 char32_t c8toc32(const char *c8);
+size_t c8check(const char *c8, size_t n);
+bool c8valid(const char *c8, size_t n);
 void c32toc16be(char32_t c32, char16_t out[2]);
 
-extern tss_t error_key;
-
-bool error_init(void);
-void error_exit(void);
-void set_error(const char *e);
-
-extern const char *error_out_of_memory;
-extern thread_local unsigned long line;
-extern thread_local unsigned long column;
-
-void errorf(const char *fmt, ...);
+void clear_error(void);
+void set_error(enum jsonErrorCode code, const char *message);
+// Error found at a byte of the input.
+void input_error(enum jsonErrorCode code, const char *message, size_t offset);
+// Error found in text, which also has lines and columns.
+void text_error(enum jsonErrorCode code, const char *message, size_t offset, unsigned long line,
+        unsigned long column);
+const struct jsonError *error_last(void);
+const char *error_text(void);
 
 #endif
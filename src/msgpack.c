@@ -0,0 +1,355 @@
+#include <assert.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+#define NIL         0xC0
+#define FALSE       0xC2
+#define TRUE        0xC3
+#define FLOAT32     0xCA
+#define FLOAT64     0xCB
+#define UINT8       0xCC
+#define UINT16      0xCD
+#define UINT32      0xCE
+#define UINT64      0xCF
+#define INT8        0xD0
+#define INT16       0xD1
+#define INT32       0xD2
+#define INT64       0xD3
+#define STR8        0xD9
+#define STR16       0xDA
+#define STR32       0xDB
+#define ARRAY16     0xDC
+#define ARRAY32     0xDD
+#define MAP16       0xDE
+#define MAP32       0xDF
+
+#define FIXMAP      0x80
+#define FIXARRAY    0x90
+#define FIXSTR      0xA0
+
+/* Header of str, array or map: fix form if n fits into its 4 (5 for str) bits
+ * or one of the forms with 8, 16 or 32 bit length. Longer ones can't be
+ * encoded. */
+static bool encode_header(struct encoder *encoder, unsigned char fix, size_t fix_limit, unsigned char type8,
+        unsigned char type16, size_t n) {
+    if (n > 0xFFFFFFFF) {
+        set_error(JSON_ERROR_LIMIT, "MessagePack length is limited to 32 bits");
+        return false;
+    }
+    if (n < fix_limit) {
+        encode_byte(encoder, fix | n);
+    } else if (type8 && n <= 0xFF) {
+        encode_byte(encoder, type8);
+        encode_uint(encoder, n, 1);
+    } else if (n <= 0xFFFF) {
+        encode_byte(encoder, type16);
+        encode_uint(encoder, n, 2);
+    } else {
+        encode_byte(encoder, type16 + 1);
+        encode_uint(encoder, n, 4);
+    }
+    return true;
+}
+
+static bool encode_str(struct encoder *encoder, struct jsonString *string) {
+    size_t n = string->size ? string->size - 1 : 0;
+    if (!encode_header(encoder, FIXSTR, 32, STR8, STR16, n)) {
+        return false;
+    }
+    encode_bytes(encoder, string->data, n);
+    return true;
+}
+
+static void encode_integer(struct encoder *encoder, int64_t integer) {
+    if (integer >= 0) {
+        if (integer < 0x80) {
+            encode_byte(encoder, integer);
+        } else if (integer <= 0xFF) {
+            encode_byte(encoder, UINT8);
+            encode_uint(encoder, integer, 1);
+        } else if (integer <= 0xFFFF) {
+            encode_byte(encoder, UINT16);
+            encode_uint(encoder, integer, 2);
+        } else if (integer <= 0xFFFFFFFF) {
+            encode_byte(encoder, UINT32);
+            encode_uint(encoder, integer, 4);
+        } else {
+            encode_byte(encoder, UINT64);
+            encode_uint(encoder, integer, 8);
+        }
+    } else {
+        if (integer >= -32) {
+            encode_byte(encoder, (unsigned char) integer);
+        } else if (integer >= INT8_MIN) {
+            encode_byte(encoder, INT8);
+            encode_uint(encoder, (uint64_t) integer, 1);
+        } else if (integer >= INT16_MIN) {
+            encode_byte(encoder, INT16);
+            encode_uint(encoder, (uint64_t) integer, 2);
+        } else if (integer >= INT32_MIN) {
+            encode_byte(encoder, INT32);
+            encode_uint(encoder, (uint64_t) integer, 4);
+        } else {
+            encode_byte(encoder, INT64);
+            encode_uint(encoder, (uint64_t) integer, 8);
+        }
+    }
+}
+
+static void encode_number(struct encoder *encoder, double number) {
+    int64_t integer;
+    if (number_is_int64(number, &integer)) {
+        encode_integer(encoder, integer);
+    } else if (number_is_float(number)) {
+        encode_byte(encoder, FLOAT32);
+        encode_float(encoder, (float) number);
+    } else {
+        encode_byte(encoder, FLOAT64);
+        encode_double(encoder, number);
+    }
+}
+
+static bool encode_value(struct encoder *encoder, struct jsonValue *value) {
+    switch (value->kind) {
+    case JVK_STR:
+        return encode_str(encoder, &value->v.string);
+    case JVK_NUM:
+        encode_number(encoder, value->v.number);
+        return true;
+    case JVK_OBJ: {
+        struct jsonObject *object = &value->v.object;
+        if (!encode_header(encoder, FIXMAP, 16, 0, MAP16, object->size)) {
+            return false;
+        }
+        for (size_t i = 0; i < object->capacity; ++i) {
+            struct jsonObjectEntry *entry = &object->entries[i];
+            if (!entry->key || entry->key == &key_deleted) {
+                continue;
+            }
+            if (!encode_str(encoder, entry->key) || !encode_value(encoder, entry->value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case JVK_ARR: {
+        struct jsonArray *array = &value->v.array;
+        if (!encode_header(encoder, FIXARRAY, 16, 0, ARRAY16, array->size)) {
+            return false;
+        }
+        for (size_t i = 0; i < array->size; ++i) {
+            if (!encode_value(encoder, array->values[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case JVK_BOOL:
+        encode_byte(encoder, value->v.boolean ? TRUE : FALSE);
+        return true;
+    case JVK_NULL:
+    default:
+        encode_byte(encoder, NIL);
+        return true;
+    }
+}
+
+extern size_t msgpack_encode(void *out, size_t size, struct jsonValue *value) {
+    struct encoder encoder;
+    encoder_init(&encoder, out, size);
+    return encode_value(&encoder, value) ? encoder.position : 0;
+}
+
+/* Length of str, array or map given its type byte. */
+static bool decode_length(struct decoder *decoder, unsigned char type, uint64_t *length) {
+    if ((type & 0xE0) == FIXSTR) {
+        *length = type & 0x1F;
+        return true;
+    }
+    if ((type & 0xF0) == FIXMAP || (type & 0xF0) == FIXARRAY) {
+        *length = type & 0x0F;
+        return true;
+    }
+    switch (type) {
+    case STR8:
+        return decode_uint(decoder, 1, length);
+    case STR16:
+    case ARRAY16:
+    case MAP16:
+        return decode_uint(decoder, 2, length);
+    case STR32:
+    case ARRAY32:
+    case MAP32:
+        return decode_uint(decoder, 4, length);
+    default:
+        input_error(JSON_ERROR_SYNTAX, "MessagePack str was expected", decoder->offset - 1);
+        return false;
+    }
+}
+
+static bool is_str(unsigned char type) {
+    return (type & 0xE0) == FIXSTR || type == STR8 || type == STR16 || type == STR32;
+}
+
+static struct jsonValue *decode_value(struct decoder *decoder);
+
+static struct jsonValue *decode_array(struct decoder *decoder, uint64_t length) {
+    struct jsonValue *array = json_create_array(decoder_capacity_hint(decoder, length, 1));
+    if (!array) {
+        return NULL;
+    }
+    for (uint64_t i = 0; i < length; ++i) {
+        struct jsonValue *element = decode_value(decoder);
+        if (!element) {
+            goto fail;
+        }
+        if (!array_append(&array->v.array, element)) {
+            json_value_free(element);
+            goto fail;
+        }
+    }
+    return array;
+fail:
+    json_value_free(array);
+    return NULL;
+}
+
+static struct jsonValue *decode_map(struct decoder *decoder, uint64_t length) {
+    struct jsonValue *object = json_create_object(decoder_capacity_hint(decoder, length, 2));
+    if (!object) {
+        return NULL;
+    }
+    for (uint64_t i = 0; i < length; ++i) {
+        const unsigned char *type = decode_bytes(decoder, 1);
+        if (!type) {
+            goto fail;
+        }
+        uint64_t n;
+        if (!is_str(*type)) {
+            input_error(JSON_ERROR_UNSUPPORTED, "MessagePack map key is not a str", decoder->offset - 1);
+            goto fail;
+        }
+        if (!decode_length(decoder, *type, &n)) {
+            goto fail;
+        }
+        const unsigned char *bytes = decode_bytes(decoder, n);
+        if (!bytes) {
+            goto fail;
+        }
+        struct jsonString *key = decoded_key(bytes, n);
+        if (!key) {
+            goto fail;
+        }
+        struct jsonValue *value = decode_value(decoder);
+        if (!value || !object_add(&object->v.object, key, value)) {
+            string_free(key);
+            json_value_free(value);
+            goto fail;
+        }
+    }
+    return object;
+fail:
+    json_value_free(object);
+    return NULL;
+}
+
+static struct jsonValue *decode_signed(struct decoder *decoder, int n) {
+    uint64_t bits;
+    if (!decode_uint(decoder, n, &bits)) {
+        return NULL;
+    }
+    // sign extend
+    int shift = 64 - 8 * n;
+    int64_t integer = (int64_t) (bits << shift) >> shift;
+    return json_create_number((double) integer);
+}
+
+static struct jsonValue *decode_unsigned(struct decoder *decoder, int n) {
+    uint64_t integer;
+    if (!decode_uint(decoder, n, &integer)) {
+        return NULL;
+    }
+    return json_create_number((double) integer);
+}
+
+static struct jsonValue *decode_item(struct decoder *decoder) {
+    const unsigned char *type = decode_bytes(decoder, 1);
+    if (!type) {
+        return NULL;
+    }
+    uint64_t length;
+    double number;
+    if (*type < 0x80) {
+        return json_create_number(*type);
+    }
+    if (*type >= 0xE0) {
+        return json_create_number((signed char) *type);
+    }
+    if (is_str(*type)) {
+        if (!decode_length(decoder, *type, &length)) {
+            return NULL;
+        }
+        const unsigned char *bytes = decode_bytes(decoder, length);
+        return bytes ? decoded_string(bytes, length) : NULL;
+    }
+    if ((*type & 0xF0) == FIXARRAY || *type == ARRAY16 || *type == ARRAY32) {
+        return decode_length(decoder, *type, &length) ? decode_array(decoder, length) : NULL;
+    }
+    if ((*type & 0xF0) == FIXMAP || *type == MAP16 || *type == MAP32) {
+        return decode_length(decoder, *type, &length) ? decode_map(decoder, length) : NULL;
+    }
+    switch (*type) {
+    case NIL:
+        return json_create_null();
+    case FALSE:
+        return json_create_boolean(false);
+    case TRUE:
+        return json_create_boolean(true);
+    case FLOAT32:
+        return decode_float(decoder, &number) ? json_create_number(number) : NULL;
+    case FLOAT64:
+        return decode_double(decoder, &number) ? json_create_number(number) : NULL;
+    case UINT8:
+        return decode_unsigned(decoder, 1);
+    case UINT16:
+        return decode_unsigned(decoder, 2);
+    case UINT32:
+        return decode_unsigned(decoder, 4);
+    case UINT64:
+        return decode_unsigned(decoder, 8);
+    case INT8:
+        return decode_signed(decoder, 1);
+    case INT16:
+        return decode_signed(decoder, 2);
+    case INT32:
+        return decode_signed(decoder, 4);
+    case INT64:
+        return decode_signed(decoder, 8);
+    default:
+        input_error(JSON_ERROR_UNSUPPORTED, "unsupported MessagePack type", decoder->offset - 1);
+        return NULL;
+    }
+}
+
+static struct jsonValue *decode_value(struct decoder *decoder) {
+    if (++decoder->depth > DECODER_MAX_DEPTH) {
+        input_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded", decoder->offset);
+        return NULL;
+    }
+    struct jsonValue *value = decode_item(decoder);
+    --decoder->depth;
+    return value;
+}
+
+extern struct jsonValue *msgpack_decode(const void *buffer, size_t size, bool all) {
+    struct decoder decoder;
+    decoder_init(&decoder, buffer, size);
+    struct jsonValue *value = decode_value(&decoder);
+    if (all && value && decoder.offset != decoder.size) {
+        input_error(JSON_ERROR_SYNTAX, "trailing bytes", decoder.offset);
+        json_value_free(value);
+        value = NULL;
+    }
+    return value;
+}
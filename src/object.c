@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <limits.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "json_internal.h"
@@ -15,24 +16,20 @@ static const size_t prime_capacities[] = {
     8009ull, 16087ull, 30367ull, 60257ull, 122387ull, 246473ull, 445931ull,
     984461ull, 2071873ull, 3329129ull, 6645757ull, 14753681ull, 27844433ull,
     62198197ull, 130849643ull, 232540541ull, 420468661ull, 874249081ull,
-    1825850717ull, 4177971107ull, 7997985953ull, 15006665651ull,
-    32109786613ull, 52234947971ull, 103684385887ull, 233215828553ull,
-    482890090867ull, 1017518287769ull, 1808739102661ull, 3820730969873ull,
-    7143951075221ull, 15911846005817ull, 34549382138311ull, 60873837348941ull,
-    114125472132457ull, 225020097064313ull, 483814914675413ull,
-    995330423937163ull, 2052422557552501ull, 3827369225572561ull,
-    8029744166750309ull, 15947206541890957ull, 28292002491075067ull,
-    65400623661884507ull, 116875762939333753ull, 233389247835623543ull,
-    538660358633970413ull, 1017699188710033703ull, 1825687239835937623ull,
-    4124828355664746773ull, 9080577297740147699ull, 13948657424817642929ull,
+    1825850717ull, 4177971107ull,
 };
 
+// Capacity and counts of entries are kept in 32 bits, so tables end below 2^32 entries.
+#define MAX_CAPACITY (prime_capacities[sizeof(prime_capacities) / sizeof(*prime_capacities) - 1])
+
 extern void object_init(struct jsonObject *object) {
     assert(object);
     object->capacity = 0;
     object->size = 0;
     object->unique_size = 0;
+    object->deleted = 0;
     object->entries = NULL;
+    atomic_init(&object->hash, 0);
 }
 
 extern void object_free_internal(struct jsonObject *object) {
@@ -47,53 +44,112 @@ extern void object_free_internal(struct jsonObject *object) {
             assert(!entry->value);
             continue;
         }
-        assert(entry->value);
-        string_free_internal(entry->key);
-        json_free(entry->key);
-        assert(entry->value);
+        // Value is NULL only in a copy that failed halfway, see json_copy().
+        string_free(entry->key);
         json_value_free(entry->value);
     }
     json_free(object->entries);
     object->capacity = 0;
     object->size = 0;
+    object->deleted = 0;
     object->entries = NULL;
 }
 
-/* Make object internal buffer big enough to hold `size` elements and keep good
- * performance of operations. */
-extern bool object_reserve(struct jsonObject *object, size_t size) {
-    assert(object);
+/* Smallest capacity that keeps good performance for `size` elements. */
+static size_t capacity_for(size_t size) {
     size_t min_capacity = size * INVERSE_MAX_OCCUPANCY;
-    if (min_capacity <= object->capacity) {
-        return true;
-    }
-    size_t new_capacity = 0;
+    size_t capacity = 0;
     for (size_t i = 0; i < sizeof(prime_capacities) / sizeof(*prime_capacities); ++i) {
-        new_capacity = prime_capacities[i];
-        if (min_capacity <= new_capacity) {
+        capacity = prime_capacities[i];
+        if (min_capacity <= capacity) {
             break;
         }
     }
+    return capacity;
+}
+
+/* Moves entries into a new table. Entries keep their ids, so duplicates of a
+ * key stay in the order they were added. */
+static bool object_rehash(struct jsonObject *object, size_t new_capacity) {
     struct jsonObjectEntry *new_entries = json_calloc(new_capacity * sizeof(struct jsonObjectEntry));
     if (!new_entries) {
         return false;
     }
-    struct jsonObjectEntry *old_entries = object->entries;
-    size_t old_capacity = object->capacity;
-    object_init(object);
-    object->capacity = new_capacity;
+    for (size_t i = 0; i < object->capacity; ++i) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        if (!entry->key || entry->key == &key_deleted) {
+            continue;
+        }
+        size_t j = entry->key->hash % new_capacity;
+        while (new_entries[j].key) {
+            j = j + 1 == new_capacity ? 0 : j + 1;
+        }
+        new_entries[j] = *entry;
+    }
+    json_free(object->entries);
     object->entries = new_entries;
-    object->size = 0;
-    for (size_t i = 0; i < old_capacity; ++i) {
-        struct jsonObjectEntry *entry = &old_entries[i];
+    object->capacity = new_capacity;
+    object->deleted = 0;
+    return true;
+}
+
+/* Make object internal buffer big enough to hold `size` elements and keep good
+ * performance of operations. */
+extern bool object_reserve(struct jsonObject *object, size_t size) {
+    assert(object);
+    if (size > MAX_CAPACITY / INVERSE_MAX_OCCUPANCY) {
+        set_error(JSON_ERROR_LIMIT, "object has too many members");
+        return false;
+    }
+    if (size * INVERSE_MAX_OCCUPANCY <= object->capacity) {
+        return true;
+    }
+    return object_rehash(object, capacity_for(size));
+}
+
+/* Moves entries into a freshly allocated table of the smallest capacity for
+ * their number, which also drops deleted entries. */
+extern bool object_shrink(struct jsonObject *object) {
+    assert(object);
+    if (!object->size) {
+        json_free(object->entries);
+        object->entries = NULL;
+        object->capacity = 0;
+        object->deleted = 0;
+        return true;
+    }
+    return object_rehash(object, capacity_for(object->size));
+}
+
+/* Copies the table slot for slot with keys and their hashes, so nothing is
+ * probed or hashed again. Values are the same as in the original. */
+extern bool object_clone(struct jsonObject *copy, const struct jsonObject *object) {
+    *copy = *object;
+    atomic_init(&copy->hash, 0);
+    if (!object->capacity) {
+        return true;
+    }
+    copy->entries = json_malloc(object->capacity * sizeof(struct jsonObjectEntry));
+    if (!copy->entries) {
+        return false;
+    }
+    memcpy(copy->entries, object->entries, object->capacity * sizeof(struct jsonObjectEntry));
+    for (size_t i = 0; i < object->capacity; ++i) {
+        struct jsonObjectEntry *entry = &copy->entries[i];
         if (!entry->key || entry->key == &key_deleted) {
             continue;
         }
-        assert(object_add(object, entry->key, entry->value));
-        entry->key = NULL;
-        entry->value = NULL;
+        entry->key = string_duplicate(entry->key);
+        if (!entry->key) {
+            while (i--) {
+                if (copy->entries[i].key && copy->entries[i].key != &key_deleted) {
+                    string_free(copy->entries[i].key);
+                }
+            }
+            json_free(copy->entries);
+            return false;
+        }
     }
-    json_free(old_entries);
     return true;
 }
 
@@ -104,12 +160,22 @@ extern bool object_add(struct jsonObject *object, struct jsonString *key, struct
     if (!object_reserve(object, object->size + 1)) {
         return false;
     }
+    // Deleted entries end probing no better than live ones, too many of them
+    // are dropped. The table keeps its capacity, so members removed by a
+    // patch that's being applied still fit back in if it's undone.
+    if (((size_t) object->size + object->deleted + 1) * INVERSE_MAX_OCCUPANCY > object->capacity
+            && !object_rehash(object, object->capacity)) {
+        return false;
+    }
     unsigned hash = key->hash;
     bool is_duplicate = false;
     for (size_t i = hash % object->capacity; ; i = (i + 1 == object->capacity ? 0 : i + 1)) {
         struct jsonObjectEntry *entry = &object->entries[i];
         // empty or deleted
         if (!entry->key || entry->key == &key_deleted) {
+            if (entry->key) {
+                --object->deleted;
+            }
             entry->key = key;
             entry->value = value;
             entry->id = uniq++;
@@ -204,6 +270,126 @@ extern struct jsonValue *object_next(struct jsonObject *object, const char *key,
     return value;
 }
 
+/* Where the value added last for the key is stored, or NULL. */
+extern struct jsonValue **object_slot(struct jsonObject *object, const char *key) {
+    assert(key);
+    return object_slot_hashed(object, key, string_hash(key));
+}
+
+/* Same as object_slot() for a key hashed beforehand. */
+extern struct jsonValue **object_slot_hashed(struct jsonObject *object, const char *key, unsigned hash) {
+    assert(object);
+    assert(key);
+    assert_slow(hash == string_hash(key));
+    if (!object->capacity) {
+        return NULL;
+    }
+    struct jsonObjectEntry *last = NULL;
+    for (size_t i = hash % object->capacity; ; i = (i + 1 == object->capacity ? 0 : i + 1)) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        if (!entry->key) {
+            break;
+        }
+        if (entry->key == &key_deleted) {
+            continue;
+        }
+        if (entry->key->hash == hash && !strcmp(entry->key->data, key) && (!last || entry->id > last->id)) {
+            last = entry;
+        }
+    }
+    return last ? &last->value : NULL;
+}
+
 extern struct jsonValue *object_at(struct jsonObject *object, const char *key) {
     return object_next(object, key, NULL);
 }
+
+/* Whether an entry other than the i-th one has the key. */
+static bool has_other(struct jsonObject *object, size_t i, const struct jsonString *key) {
+    for (size_t j = key->hash % object->capacity; ; j = (j + 1 == object->capacity ? 0 : j + 1)) {
+        struct jsonObjectEntry *entry = &object->entries[j];
+        if (!entry->key) {
+            return false;
+        }
+        if (j != i && entry->key != &key_deleted && entry->key->hash == key->hash
+                && !strcmp(entry->key->data, key->data)) {
+            return true;
+        }
+    }
+}
+
+/* Index of the entry the slot returned by object_slot() belongs to. */
+extern size_t object_index_of(struct jsonObject *object, struct jsonValue **slot) {
+    assert(object);
+    char *address = (char *) slot - offsetof(struct jsonObjectEntry, value);
+    struct jsonObjectEntry *entry = (struct jsonObjectEntry *) address;
+    assert(entry >= object->entries && entry < object->entries + object->capacity);
+    return (size_t) (entry - object->entries);
+}
+
+/* Index of the entry with the id, which must be in the object. */
+extern size_t object_find_id(struct jsonObject *object, unsigned hash, unsigned long long id) {
+    assert(object);
+    assert(object->capacity);
+    for (size_t i = hash % object->capacity; ; i = (i + 1 == object->capacity ? 0 : i + 1)) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        assert(entry->key);
+        if (entry->key != &key_deleted && entry->id == id) {
+            return i;
+        }
+    }
+}
+
+/* Marks the i-th entry deleted and hands it over, key and value included.
+ * The table keeps its capacity, so object_restore() never allocates. */
+extern struct jsonObjectEntry object_remove(struct jsonObject *object, size_t i) {
+    assert(object);
+    assert(i < object->capacity);
+    struct jsonObjectEntry removed = object->entries[i];
+    assert(removed.key && removed.key != &key_deleted);
+    if (!has_other(object, i, removed.key)) {
+        --object->unique_size;
+    }
+    object->entries[i].key = (struct jsonString *) &key_deleted;
+    object->entries[i].value = NULL;
+    --object->size;
+    ++object->deleted;
+    return removed;
+}
+
+/* Puts back an entry removed from the i-th slot by object_remove(), with its
+ * id, so it keeps its place among values of its key. The index means that
+ * slot only while the table isn't rehashed: then the slot is still free and
+ * the entry goes there, otherwise it goes wherever probing finds room. */
+extern void object_restore(struct jsonObject *object, size_t i, const struct jsonObjectEntry *entry) {
+    assert(object);
+    assert(object->size < object->capacity);
+    size_t place = object->capacity;
+    bool is_duplicate = false;
+    for (size_t j = entry->key->hash % object->capacity; ; j = (j + 1 == object->capacity ? 0 : j + 1)) {
+        struct jsonObjectEntry *slot = &object->entries[j];
+        if (!slot->key) {
+            if (place == object->capacity) {
+                place = j;
+            }
+            break;
+        }
+        if (slot->key == &key_deleted) {
+            if (place == object->capacity || j == i) {
+                place = j;
+            }
+            continue;
+        }
+        if (slot->key->hash == entry->key->hash && !strcmp(slot->key->data, entry->key->data)) {
+            is_duplicate = true;
+        }
+    }
+    if (object->entries[place].key) {
+        --object->deleted;
+    }
+    object->entries[place] = *entry;
+    ++object->size;
+    if (!is_duplicate) {
+        ++object->unique_size;
+    }
+}
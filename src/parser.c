@@ -1,89 +1,223 @@
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "json_internal.h"
 
-static thread_local size_t depth;
-static thread_local size_t max_depth = 128;
-
-thread_local unsigned long line;
-thread_local unsigned long column;
-thread_local const char *input_buffer;
-thread_local size_t input_buffer_size;
-thread_local size_t offset;
+// Nesting depth the parser handles without allocating.
+#define PARSER_INLINE_DEPTH 32
+
+// Nesting depth the validator handles without allocating, one bit per level.
+#define VALIDATOR_INLINE_DEPTH 4096
+
+static thread_local unsigned long line;
+static thread_local unsigned long column;
+static thread_local const char *input_buffer;
+static thread_local size_t input_buffer_size;
+static thread_local size_t offset;
+static thread_local bool trusted_utf8;
+static thread_local enum jsonEncoding encoding;
+// Equal values are made to share one node as their containers are closed.
+static thread_local bool interning;
+// Bytes per code unit of the input.
+static thread_local size_t unit;
+
+/* Byte order mark, if the input starts with one. UTF-32LE must be looked for
+ * before UTF-16LE, its mark starts the same. */
+static enum jsonEncoding encoding_from_bom(const unsigned char *p, size_t n, size_t *bom) {
+    static const struct {
+        enum jsonEncoding encoding;
+        size_t size;
+        const char *bytes;
+    } marks[] = {
+        { JSON_ENCODING_UTF8, 3, "\xEF\xBB\xBF" },
+        { JSON_ENCODING_UTF32LE, 4, "\xFF\xFE\x00\x00" },
+        { JSON_ENCODING_UTF32BE, 4, "\x00\x00\xFE\xFF" },
+        { JSON_ENCODING_UTF16LE, 2, "\xFF\xFE" },
+        { JSON_ENCODING_UTF16BE, 2, "\xFE\xFF" },
+    };
+    for (size_t i = 0; i < sizeof(marks) / sizeof(*marks); ++i) {
+        if (n >= marks[i].size && !memcmp(p, marks[i].bytes, marks[i].size)) {
+            *bom = marks[i].size;
+            return marks[i].encoding;
+        }
+    }
+    *bom = 0;
+    return JSON_ENCODING_AUTO;
+}
 
-static struct jsonValue *parse_value(void);
+/* Without a mark, text that starts with an ASCII character tells its encoding
+ * by the zero bytes around it, as RFC 4627 suggests. */
+static enum jsonEncoding encoding_from_zeros(const unsigned char *p, size_t n) {
+    if (n >= 4 && !p[0] && !p[1] && !p[2] && p[3]) {
+        return JSON_ENCODING_UTF32BE;
+    }
+    if (n >= 4 && p[0] && !p[1] && !p[2] && !p[3]) {
+        return JSON_ENCODING_UTF32LE;
+    }
+    if (n >= 2 && !p[0] && p[1]) {
+        return JSON_ENCODING_UTF16BE;
+    }
+    if (n >= 2 && p[0] && !p[1]) {
+        return JSON_ENCODING_UTF16LE;
+    }
+    return JSON_ENCODING_UTF8;
+}
 
-extern void parser_begin(const char *buffer, size_t n) {
+extern void parser_begin(const char *buffer, size_t n, const struct jsonParseOptions *options) {
     assert(buffer);
-    set_error(NULL);
-    depth = 0;
+    assert(options);
+    clear_error();
     line = 1;
     column = 1;
     input_buffer = buffer;
     input_buffer_size = n;
-    offset = 0;
+    trusted_utf8 = options->trusted_utf8;
+    size_t bom = 0;
+    encoding = encoding_from_bom((const unsigned char *) buffer, n, &bom);
+    if (options->encoding != JSON_ENCODING_AUTO && options->encoding != encoding) {
+        // A mark of some other encoding is just text.
+        encoding = options->encoding;
+        bom = 0;
+    } else if (encoding == JSON_ENCODING_AUTO) {
+        encoding = encoding_from_zeros((const unsigned char *) buffer, n);
+    }
+    unit = encoding == JSON_ENCODING_UTF8 ? 1 : encoding <= JSON_ENCODING_UTF16BE ? 2 : 4;
+    offset = bom;
+    interning = false;
+}
+
+/* Turns on interning for the text parsed next. Only callers that keep every
+ * value they parse may, values freed halfway would stay in the table. */
+extern void parser_intern(void) {
+    interning = true;
 }
 
 extern void parser_end(void) {
     input_buffer = NULL;
+    if (interning) {
+        intern_end();
+        interning = false;
+    }
+}
+
+/* Code unit at the given byte offset of wide input. */
+static char32_t unit_at(size_t at) {
+    const unsigned char *p = (const unsigned char *) input_buffer + at;
+    switch (encoding) {
+    case JSON_ENCODING_UTF16LE:
+        return p[0] | p[1] << 8;
+    case JSON_ENCODING_UTF16BE:
+        return p[0] << 8 | p[1];
+    case JSON_ENCODING_UTF32LE:
+        return p[0] | p[1] << 8 | p[2] << 16 | (char32_t) p[3] << 24;
+    default:
+        return (char32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+    }
 }
 
+/* Only ASCII matters outside of strings, so any other character of wide input
+ * is 0x80. A code unit cut by the end is no character either. */
 static int peek(void) {
-    if (input_buffer_size <= offset) {
-        return EOF;
+    size_t left = input_buffer_size - offset;
+    if (left < unit) {
+        return left ? 0x80 : EOF;
     }
-    return input_buffer[offset];
+    if (unit == 1) {
+        return (unsigned char) input_buffer[offset];
+    }
+    char32_t c = unit_at(offset);
+    return c < 0x80 ? (int) c : 0x80;
 }
 
 static int next_char(void) {
     int c = peek();
+    if (c == EOF) {
+        return c;
+    }
     if (c == '\n') {
         ++line;
         column = 0;
     }
     ++column;
-    ++offset;
+    size_t left = input_buffer_size - offset;
+    offset += left < unit ? left : unit;
     return c;
 }
 
 extern void skip_spaces(void) {
     int c;
-    while (EOF != (c = next_char()) && c && strchr("\x20\x09\x0A\x0D", c)) {
+    while (EOF != (c = peek()) && c && strchr("\x20\x09\x0A\x0D", c)) {
+        next_char();
     }
-    --offset;
 }
 
 static bool consume_optionally(const char *str) {
     size_t n = strlen(str);
     size_t left = input_buffer_size - offset;
-    if (left < n || strncmp(&input_buffer[offset], str, n)) {
+    if (unit > 1) {
+        if (left < n * unit) {
+            return false;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (unit_at(offset + i * unit) != (unsigned char) str[i]) {
+                return false;
+            }
+        }
+    } else if (left < n || strncmp(&input_buffer[offset], str, n)) {
         return false;
     }
-    offset += n;
+    // Expected text never spans lines.
+    offset += n * unit;
+    column += n;
     return true;
 }
 
-static bool consume(const char *str) {
+static void parse_error(enum jsonErrorCode code, const char *message) {
+    text_error(code, message, offset, line, column);
+}
+
+extern void parser_error(enum jsonErrorCode code, const char *message) {
+    parse_error(code, message);
+}
+
+extern int parser_peek(void) {
+    return peek();
+}
+
+extern bool parser_consume_optionally(const char *str) {
+    return consume_optionally(str);
+}
+
+static bool consume(const char *str, const char *message) {
     bool result = consume_optionally(str);
     if (!result) {
-        errorf("'%s' was expected", str);
+        parse_error(JSON_ERROR_SYNTAX, message);
     }
     return result;
 }
 
+extern bool parser_consume(const char *str, const char *message) {
+    return consume(str, message);
+}
+
+/* Without a string, text is only checked. */
+static bool string_put(struct jsonString *string, char c) {
+    return !string || string_append(string, c);
+}
+
 /*! Appends UTF-32 char to UTF-8 code unit sequence in jsonString. */
 static bool append_unicode_code_point(struct jsonString *string, char32_t c32) {
     char c8[4];
     int n = 0;
     if (!c32toc8(c32, &n, c8)) {
-        errorf("illegal UTF-8 sequence");
+        parse_error(JSON_ERROR_SYNTAX, "illegal UTF-8 sequence");
         return false;
     }
     for (int i = 0; i < n; ++i) {
-        if (!string_append(string, (char) c8[i])) {
+        if (!string_put(string, (char) c8[i])) {
             return false;
         }
     }
@@ -91,75 +225,165 @@ static bool append_unicode_code_point(struct jsonString *string, char32_t c32) {
 }
 
 static bool parse_hex4(char32_t *out) {
-    char buf[5];
+    *out = 0;
     for (int i = 0; i < 4; ++i) {
-        if (EOF == (buf[i] = next_char())) {
-            errorf("bad Unicode escape sequence");
+        int c = next_char();
+        int lower = c | 0x20;
+        int digit = '0' <= c && c <= '9' ? c - '0' : 'a' <= lower && lower <= 'f' ? lower - 'a' + 10 : -1;
+        if (digit < 0) {
+            parse_error(JSON_ERROR_SYNTAX, "bad Unicode escape sequence");
             return false;
         }
-    }
-    buf[4] = '\0';
-    char *end;
-    *out = strtoul(buf, &end, 16);
-    if (end != &buf[4]) {
-        errorf("bad Unicode escape sequence");
-        return false;
+        *out = *out << 4 | digit;
     }
     return true;
 }
 
-static bool parse_string(struct jsonString *string) {
-    if (!consume("\"")) {
+#define ONES (~(uint64_t) 0 / 0xFF)
+#define HIGHS (ONES * 0x80)
+
+// Sets the high bit of every byte of x that is zero.
+#define ZERO_BYTES(x) (((x) - ONES) & ~(x) & HIGHS)
+
+/* Length of the run of ASCII bytes that stand for themselves in a string.
+ * Eight bytes are looked at a time. */
+static size_t ascii_run(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        // Controls are below 0x20, so subtracting 0x20 borrows from them.
+        uint64_t stop = (word | ((word - ONES * 0x20) & ~word)) & HIGHS;
+        stop |= ZERO_BYTES(word ^ ONES * '"') | ZERO_BYTES(word ^ ONES * '\\');
+        if (stop) {
+            break;
+        }
+    }
+    for (; i < n; ++i) {
+        unsigned char c = p[i];
+        if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\') {
+            break;
+        }
+    }
+    return i;
+}
+
+/* Transcodes characters of wide input up to the next quote, escape or control
+ * character. UTF-8 is put together in a batch, which goes to the string in one
+ * go. Surrogates of UTF-16 must come in pairs unless the input is trusted. */
+static bool scan_plain_wide(struct jsonString *string) {
+    char batch[256];
+    size_t n = 0;
+    while (input_buffer_size - offset >= unit) {
+        char32_t c = unit_at(offset);
+        size_t width = unit;
+        if (c < 0x80) {
+            if (c < 0x20 || c == '"' || c == '\\') {
+                break;
+            }
+        } else if (unit == 2 && c16type(c) == UTF16_SURROGATE_HIGH && input_buffer_size - offset >= 4
+                && c16type(unit_at(offset + 2)) == UTF16_SURROGATE_LOW) {
+            c = c16pairtoc32(c, unit_at(offset + 2));
+            width = 4;
+        } else if (c > 0x10FFFF || ((c & 0xFFFFF800) == 0xD800 && !trusted_utf8)) {
+            parse_error(JSON_ERROR_SYNTAX, unit == 2 ? "invalid UTF-16 sequence" : "invalid UTF-32 sequence");
+            return false;
+        }
+        if (n > sizeof(batch) - 4) {
+            if (string && !string_append_mem(string, batch, n)) {
+                return false;
+            }
+            n = 0;
+        }
+        int len = 0;
+        c32toc8(c, &len, batch + n);
+        n += len;
+        offset += width;
+        ++column;
+    }
+    return !string || !n || string_append_mem(string, batch, n);
+}
+
+/* Takes bytes up to the next quote, escape or control character as they are.
+ * Unless the input is trusted, multibyte sequences are checked on the way, so
+ * strings are always well-formed UTF-8. */
+static bool scan_plain(struct jsonString *string) {
+    if (unit > 1) {
+        return scan_plain_wide(string);
+    }
+    const char *start = input_buffer + offset;
+    size_t left = input_buffer_size - offset;
+    size_t n = 0;
+    while (true) {
+        n += ascii_run(start + n, left - n);
+        if (n == left || (unsigned char) start[n] < 0x80) {
+            break;
+        }
+        size_t len = trusted_utf8 ? 1 : c8check(start + n, left - n);
+        if (!len) {
+            offset += n;
+            column += n;
+            parse_error(JSON_ERROR_SYNTAX, "invalid UTF-8 sequence");
+            return false;
+        }
+        n += len;
+    }
+    offset += n;
+    column += n;
+    return !string || !n || string_append_mem(string, start, n);
+}
+
+/* Reads a string up to its closing quote. Without a string, text is only
+ * checked. */
+static bool scan_string(struct jsonString *string) {
+    if (!consume("\"", "'\"' was expected")) {
         return false;
     }
     while (1) {
+        if (!scan_plain(string)) {
+            return false;
+        }
         int c;
         switch (c = next_char()) {
         case EOF:
-            errorf("unexpected end of input");
+            parse_error(JSON_ERROR_SYNTAX, "unexpected end of input");
             return false;
         case '"':
-            if (!string_append(string, '\0')) {
-                return false;
-            }
-            if (!string_shrink(string)) {
-                return false;
-            }
             return true;
         case '\x00':
-            errorf("unescaped null character");
+            parse_error(JSON_ERROR_SYNTAX, "unescaped null character");
             return false;
         case '\\':
             switch (c = next_char()) {
             case '\\':
             case '"':
             case '/':
-                if (!string_append(string, c)) {
+                if (!string_put(string, c)) {
                     return false;
                 }
                 break;
             case 'b':
-                if (!string_append(string, '\b')) {
+                if (!string_put(string, '\b')) {
                     return false;
                 }
                 break;
             case 'f':
-                if (!string_append(string, '\f')) {
+                if (!string_put(string, '\f')) {
                     return false;
                 }
                 break;
             case 'n':
-                if (!string_append(string, '\n')) {
+                if (!string_put(string, '\n')) {
                     return false;
                 }
                 break;
             case 'r':
-                if (!string_append(string, '\r')) {
+                if (!string_put(string, '\r')) {
                     return false;
                 }
                 break;
             case 't':
-                if (!string_append(string, '\t')) {
+                if (!string_put(string, '\t')) {
                     return false;
                 }
                 break;
@@ -170,6 +394,7 @@ static bool parse_string(struct jsonString *string) {
                 }
                 enum c16Type type = c16type((char16_t) p);
                 size_t prev_offset = offset;
+                unsigned long prev_column = column;
                 if (type == UTF16_SURROGATE_HIGH && consume_optionally("\\u")) {
                     char32_t next = 0;
                     if (!parse_hex4(&next)) {
@@ -177,127 +402,45 @@ static bool parse_string(struct jsonString *string) {
                     }
                     if (c16type(next) != UTF16_SURROGATE_LOW) {
                         offset = prev_offset;
+                        column = prev_column;
                     } else {
                         p = c16pairtoc32(p, next);
+                        type = UTF16_NOT_SURROGATE;
                     }
                 }
+                // Half a pair can't be written as UTF-8.
+                if (type != UTF16_NOT_SURROGATE && !trusted_utf8) {
+                    parse_error(JSON_ERROR_SYNTAX, "unpaired surrogate");
+                    return false;
+                }
                 if (!append_unicode_code_point(string, p)) {
                     return false;
                 }
                 break;
             }
             default:
-                errorf("unknown escape sequence");
+                parse_error(JSON_ERROR_SYNTAX, "unknown escape sequence");
                 return false;
             }
             break;
         default:
-            if ((unsigned char) c <= 0x1F) {
-                errorf("unescaped control character");
-                return false;
-            }
-            string_append(string, c);
-            break;
-        }
-    }
-}
-
-static bool parse_object(struct jsonObject *object) {
-    struct jsonString *key = NULL;
-    struct jsonValue *value = NULL;
-    if (!consume("{")) {
-        return false;
-    }
-    skip_spaces();
-    if (consume_optionally("}")) {
-        return true;
-    }
-    while (1) {
-        key = string_create();
-        if (!key) {
-            goto fail;
-        }
-        skip_spaces();
-        if (!parse_string(key)) {
-            goto fail;
-        }
-        skip_spaces();
-        if (!consume(":")) {
-            goto fail;
-        }
-        value = parse_value();
-        if (!value) {
-            goto fail;
-        }
-        if (!object_add(object, key, value)) {
-            goto fail;
-        }
-        key = NULL;
-        value = NULL;
-        skip_spaces();
-        if (consume_optionally("}")) {
-            return true;
-        }
-        if (!consume(",")) {
-            goto fail;
-        }
-    }
-    assert(false);
-fail:
-    string_free_internal(key);
-    json_free(key);
-    json_value_free(value);
-    object_free_internal(object);
-    return false;
-}
-
-static bool parse_array(struct jsonArray *array) {
-    struct jsonValue *value = NULL;
-    if (!consume("[")) {
-        return false;
-    }
-    skip_spaces();
-    if (consume_optionally("]")) {
-        return true;
-    }
-    while (true) {
-        value = parse_value();
-        if (!value) {
-            goto fail;
-        }
-        if (!array_append(array, value)) {
-            goto fail;
-        }
-        value = NULL;
-        skip_spaces();
-        if (consume_optionally("]")) {
-            return true;
-        }
-        if (!consume(",")) {
-            goto fail;
+            // Anything else is taken by scan_plain().
+            parse_error(JSON_ERROR_SYNTAX, "unescaped control character");
+            return false;
         }
     }
-    assert(false);
-fail:
-    json_value_free(value);
-    array_free_internal(array);
-    return false;
 }
 
-static bool parse_value_object(struct jsonValue *value) {
-    value->kind = JVK_OBJ;
-    object_init(&value->v.object);
-    return parse_object(&value->v.object);
+static bool parse_string(struct jsonString *string) {
+    return scan_string(string) && (!string || (string_append(string, '\0') && string_shrink(string)));
 }
 
-static bool parse_value_array(struct jsonValue *value) {
-    value->kind = JVK_ARR;
-    array_init(&value->v.array);
-    return parse_array(&value->v.array);
+extern bool parser_string(struct jsonString *string) {
+    return parse_string(string);
 }
 
 static bool parse_value_true(struct jsonValue *value) {
-    if (!consume("true")) {
+    if (!consume("true", "'true' was expected")) {
         return false;
     }
     value->kind = JVK_BOOL;
@@ -306,7 +449,7 @@ static bool parse_value_true(struct jsonValue *value) {
 }
 
 static bool parse_value_false(struct jsonValue *value) {
-    if (!consume("false")) {
+    if (!consume("false", "'false' was expected")) {
         return false;
     }
     value->kind = JVK_BOOL;
@@ -315,7 +458,7 @@ static bool parse_value_false(struct jsonValue *value) {
 }
 
 static bool parse_value_null(struct jsonValue *value) {
-    if (!consume("null")) {
+    if (!consume("null", "'null' was expected")) {
         return false;
     }
     value->kind = JVK_NULL;
@@ -335,32 +478,36 @@ static bool parse_value_string(struct jsonValue *value) {
 static thread_local char number_buffer[4096];
 static thread_local size_t number_size;
 
-static bool number_append(char c) {
+/* Without a buffer, digits are only counted. */
+static bool number_append(char *buffer, char c) {
     if (number_size >= sizeof(number_buffer) - 1) {
-        errorf("number is too long");
+        parse_error(JSON_ERROR_LIMIT, "number is too long");
         return false;
     }
-    number_buffer[number_size++] = c;
+    if (buffer) {
+        buffer[number_size] = c;
+    }
+    ++number_size;
     return true;
 }
 
-static bool digit(void) {
+static bool digit(char *buffer) {
     int c = peek();
     if ('0' <= c && c <= '9') {
-        if (!number_append(c)) {
+        if (!number_append(buffer, c)) {
             return false;
         }
         next_char();
         return true;
     }
-    errorf("a digit was expected");
+    parse_error(JSON_ERROR_SYNTAX, "a digit was expected");
     return false;
 }
 
-static bool digits(void) {
+static bool digits(char *buffer) {
     int c = peek();
     while ('0' <= c && c <= '9') {
-        if (!number_append(c)) {
+        if (!number_append(buffer, c)) {
             return false;
         }
         next_char();
@@ -369,40 +516,40 @@ static bool digits(void) {
     return true;
 }
 
-static bool integer(void) {
+static bool integer(char *buffer) {
     if ('-' == peek()) {
-        if (!number_append('-')) {
+        if (!number_append(buffer, '-')) {
             return false;
         }
         next_char();
     }
     int c = peek();
     if ('0' == c) {
-        if (!number_append('0')) {
+        if (!number_append(buffer, '0')) {
             return false;
         }
         next_char();
         return true;
     }
-    return digit() && digits();
+    return digit(buffer) && digits(buffer);
 }
 
-static bool fraction(void) {
+static bool fraction(char *buffer) {
     int c = peek();
     if ('.' == c) {
-        if (!number_append('.')) {
+        if (!number_append(buffer, '.')) {
             return false;
         }
         next_char();
-        return digit() && digits();
+        return digit(buffer) && digits(buffer);
     }
     return true;
 }
 
-static bool sign(void) {
+static bool sign(char *buffer) {
     int c = peek();
     if ('+' == c || '-' == c) {
-        if (!number_append(c)) {
+        if (!number_append(buffer, c)) {
             return false;
         }
         next_char();
@@ -410,68 +557,223 @@ static bool sign(void) {
     return true;
 }
 
-static bool exponent(void) {
+static bool exponent(char *buffer) {
     int c = peek();
     if ('e' == c || 'E' == c) {
-        if (!number_append(c)) {
+        if (!number_append(buffer, c)) {
             return false;
         }
         next_char();
-        return sign() && digit() && digits();
+        return sign(buffer) && digit(buffer) && digits(buffer);
     }
     return true;
 }
 
-static bool parse_value_number(struct jsonValue *value) {
-    value->kind = JVK_NUM;
+static bool scan_number(char *buffer) {
     number_size = 0;
-    if (!integer() || !fraction() || !exponent()) {
-        return false;
+    return integer(buffer) && fraction(buffer) && exponent(buffer);
+}
+
+/* Reads a number and returns its null terminated text, which is valid until
+ * the next number is read. */
+extern const char *parser_number(void) {
+    if (!scan_number(number_buffer) || !number_append(number_buffer, '\0')) {
+        return NULL;
     }
-    if (!number_append('\0')) {
+    return number_buffer;
+}
+
+static bool parse_value_number(struct jsonValue *value) {
+    value->kind = JVK_NUM;
+    if (!parser_number()) {
         return false;
     }
     int match = 0;
     int n = sscanf(number_buffer, "%lf%n", &value->v.number, &match);
     if (1 != n) {
-        errorf("failed to parse number");
+        parse_error(JSON_ERROR_SYNTAX, "failed to parse number");
         return false;
     }
     return true;
 }
 
-static struct jsonValue *parse_value(void) {
-    ++depth;
-    if (depth > max_depth) {
-        errorf("recursion depth exceeded");
-        return NULL;
+static bool parse_scalar(struct jsonValue *value, int c) {
+    switch (c) {
+    case 't':
+        return parse_value_true(value);
+    case 'f':
+        return parse_value_false(value);
+    case 'n':
+        return parse_value_null(value);
+    case '"':
+        return parse_value_string(value);
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        return parse_value_number(value);
+    default:
+        parse_error(JSON_ERROR_SYNTAX, "json value was expected");
+        return false;
     }
-    struct jsonValue *value = json_malloc(sizeof(struct jsonValue));
-    if (!value) {
-        return NULL;
+}
+
+static bool parse_key(struct jsonString **key) {
+    skip_spaces();
+    *key = string_create();
+    if (!*key) {
+        return false;
+    }
+    if (!parse_string(*key)) {
+        return false;
     }
     skip_spaces();
-    bool result;
-    int c = peek();
+    return consume(":", "':' was expected");
+}
+
+/* Reads the key of a member and the ':' after it. The string is reused for
+ * every key, so it's neither shrunk nor pooled. */
+extern bool parser_key(struct jsonString *key) {
+    string_clear(key);
+    skip_spaces();
+    if (!scan_string(key) || !string_append(key, '\0')) {
+        return false;
+    }
+    skip_spaces();
+    return consume(":", "':' was expected");
+}
+
+/* Open objects and arrays are kept on a stack instead of recursing. A value is
+ * added to its parent as soon as it's created, so on failure freeing the root
+ * frees everything parsed so far. */
+extern struct jsonValue *parse_json_text(bool all, size_t max_depth) {
+    struct jsonValue *inline_stack[PARSER_INLINE_DEPTH];
+    struct jsonValue **stack = inline_stack;
+    size_t capacity = PARSER_INLINE_DEPTH;
+    size_t depth = 0;
+    struct jsonValue *root = NULL;
+    struct jsonValue *value = NULL;
+    // Key of the value being parsed, if its parent is an object.
+    struct jsonString *key = NULL;
+    while (true) {
+        skip_spaces();
+        int c = peek();
+        bool container = c == '{' || c == '[';
+        // Invalid input is common, so the checks that need no node come first.
+        if (!container && (c <= 0 || !strchr("tfn\"-0123456789", c))) {
+            parse_error(JSON_ERROR_SYNTAX, "json value was expected");
+            goto fail;
+        }
+        if (container && depth == max_depth) {
+            parse_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded");
+            goto fail;
+        }
+        value = value_alloc();
+        if (!value) {
+            goto fail;
+        }
+        value->kind = JVK_NULL;
+        if (container) {
+            next_char();
+            if (c == '{') {
+                value->kind = JVK_OBJ;
+                object_init(&value->v.object);
+            } else {
+                value->kind = JVK_ARR;
+                array_init(&value->v.array);
+            }
+        } else if (!parse_scalar(value, c)) {
+            goto fail;
+        }
+        if (!depth) {
+            root = value;
+        } else if (stack[depth - 1]->kind == JVK_OBJ) {
+            if (!object_add(&stack[depth - 1]->v.object, key, value)) {
+                goto fail;
+            }
+            key = NULL;
+        } else if (!array_append(&stack[depth - 1]->v.array, value)) {
+            goto fail;
+        }
+        if (container) {
+            if (depth == capacity) {
+                size_t new_capacity = capacity * 2;
+                struct jsonValue **new_stack = json_realloc(stack == inline_stack ? NULL : stack,
+                        new_capacity * sizeof(*stack));
+                if (!new_stack) {
+                    value = NULL;
+                    goto fail;
+                }
+                if (stack == inline_stack) {
+                    memcpy(new_stack, inline_stack, sizeof(inline_stack));
+                }
+                stack = new_stack;
+                capacity = new_capacity;
+            }
+            stack[depth++] = value;
+        }
+        value = NULL;
+        // Close finished containers until another value is expected.
+        while (depth) {
+            struct jsonValue *top = stack[depth - 1];
+            bool object = top->kind == JVK_OBJ;
+            skip_spaces();
+            if (consume_optionally(object ? "}" : "]")) {
+                if (interning && !intern_children(top)) {
+                    goto fail;
+                }
+                --depth;
+                continue;
+            }
+            if ((object ? top->v.object.size : top->v.array.size) && !consume(",", "',' was expected")) {
+                goto fail;
+            }
+            if (object && !parse_key(&key)) {
+                goto fail;
+            }
+            break;
+        }
+        if (!depth) {
+            break;
+        }
+    }
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    skip_spaces();
+    if (all && EOF != next_char()) {
+        parse_error(JSON_ERROR_SYNTAX, "trailing bytes");
+        json_value_free(root);
+        return NULL;
+    }
+    return root;
+fail:
+    string_free(key);
+    json_value_free(value);
+    json_value_free(root);
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    return NULL;
+}
+
+static bool scan_scalar(int c) {
     switch (c) {
-    case '{':
-        result = parse_value_object(value);
-        break;
-    case '[':
-        result = parse_value_array(value);
-        break;
     case 't':
-        result = parse_value_true(value);
-        break;
+        return consume("true", "'true' was expected");
     case 'f':
-        result = parse_value_false(value);
-        break;
+        return consume("false", "'false' was expected");
     case 'n':
-        result = parse_value_null(value);
-        break;
+        return consume("null", "'null' was expected");
     case '"':
-        result = parse_value_string(value);
-        break;
+        return parse_string(NULL);
     case '-':
     case '0':
     case '1':
@@ -483,28 +785,102 @@ static struct jsonValue *parse_value(void) {
     case '7':
     case '8':
     case '9':
-        result = parse_value_number(value);
-        break;
+        return scan_number(NULL);
     default:
-        errorf("json value was expected");
-        result = false;
-        break;
+        parse_error(JSON_ERROR_SYNTAX, "json value was expected");
+        return false;
     }
-    --depth;
-    if (!result) {
-        json_free(value);
-        value = NULL;
+}
+
+static bool scan_key(void) {
+    skip_spaces();
+    if (!parse_string(NULL)) {
+        return false;
     }
-    return value;
+    skip_spaces();
+    return consume(":", "':' was expected");
 }
 
-extern struct jsonValue *parse_json_text(bool all) {
-    struct jsonValue *value = parse_value();
+/* Accepts exactly what parse_json_text() does, but builds nothing. All that's
+ * kept of open containers is one bit per level telling objects from arrays. */
+extern bool validate_json_text(bool all, size_t max_depth, size_t *deepest, size_t *end) {
+    uint64_t inline_stack[VALIDATOR_INLINE_DEPTH / 64];
+    uint64_t *stack = inline_stack;
+    size_t capacity = VALIDATOR_INLINE_DEPTH;
+    size_t depth = 0;
+    *deepest = 0;
+    while (true) {
+        skip_spaces();
+        int c = peek();
+        if (c != '{' && c != '[') {
+            if (!scan_scalar(c)) {
+                goto fail;
+            }
+        } else {
+            if (depth == max_depth) {
+                parse_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded");
+                goto fail;
+            }
+            if (depth == capacity) {
+                size_t new_capacity = capacity * 2;
+                uint64_t *new_stack = json_realloc(stack == inline_stack ? NULL : stack, new_capacity / 8);
+                if (!new_stack) {
+                    goto fail;
+                }
+                if (stack == inline_stack) {
+                    memcpy(new_stack, inline_stack, sizeof(inline_stack));
+                }
+                stack = new_stack;
+                capacity = new_capacity;
+            }
+            next_char();
+            uint64_t bit = (uint64_t) 1 << depth % 64;
+            stack[depth / 64] = c == '{' ? stack[depth / 64] | bit : stack[depth / 64] & ~bit;
+            if (++depth > *deepest) {
+                *deepest = depth;
+            }
+            skip_spaces();
+            if (consume_optionally(c == '{' ? "}" : "]")) {
+                --depth;
+            } else if (c == '{' && !scan_key()) {
+                goto fail;
+            } else {
+                continue;
+            }
+        }
+        // Close finished containers until another value is expected.
+        while (depth) {
+            bool object = stack[(depth - 1) / 64] >> (depth - 1) % 64 & 1;
+            skip_spaces();
+            if (consume_optionally(object ? "}" : "]")) {
+                --depth;
+                continue;
+            }
+            if (!consume(",", "',' was expected")) {
+                goto fail;
+            }
+            if (object && !scan_key()) {
+                goto fail;
+            }
+            break;
+        }
+        if (!depth) {
+            break;
+        }
+    }
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    *end = offset;
     skip_spaces();
-    if (all && value && EOF != next_char()) {
-        errorf("trailing bytes");
-        json_value_free(value);
-        value = NULL;
+    if (all && EOF != next_char()) {
+        parse_error(JSON_ERROR_SYNTAX, "trailing bytes");
+        return false;
     }
-    return value;
+    return true;
+fail:
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    return false;
 }
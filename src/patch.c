@@ -0,0 +1,590 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+#define LOG_INITIAL_CAPACITY 16
+
+enum undoKind {
+    UNDO_MEMBER_ADD,
+    UNDO_MEMBER_REMOVE,
+    UNDO_MEMBER_REPLACE,
+    UNDO_ELEMENT_INSERT,
+    UNDO_ELEMENT_REMOVE,
+    UNDO_ELEMENT_REPLACE,
+    UNDO_ROOT_REPLACE
+};
+
+/* A change made to the target. What it took out of the tree is freed once
+ * the whole patch is applied, what it put in is freed if it's undone. Values
+ * moved within the tree are neither. */
+struct undo {
+    enum undoKind kind;
+    struct jsonValue *container;
+    size_t index; // Of the element, or of the slot of the removed member until its table is rehashed.
+    struct jsonObjectEntry entry; // Removed member, id and key of an added or replaced one.
+    unsigned hash; // Of the key of a replaced member.
+    struct jsonValue *removed;
+    struct jsonValue *added;
+    bool keep_removed;
+    bool keep_added;
+};
+
+/* Changes are logged as they're made, so a patch that fails halfway can be
+ * undone. Undoing never allocates: neither objects nor arrays shrink while a
+ * patch is applied, so removed values always fit back in. A member goes back
+ * to the slot it left, unless an add rehashed the table in between. */
+struct patcher {
+    struct jsonValue *root;
+    struct undo *log;
+    size_t size;
+    size_t capacity;
+};
+
+static struct undo *log_next(struct patcher *patcher) {
+    if (patcher->size == patcher->capacity) {
+        size_t capacity = patcher->capacity ? patcher->capacity * 2 : LOG_INITIAL_CAPACITY;
+        struct undo *log = json_realloc(patcher->log, capacity * sizeof(struct undo));
+        if (!log) {
+            return NULL;
+        }
+        patcher->log = log;
+        patcher->capacity = capacity;
+    }
+    struct undo *undo = &patcher->log[patcher->size];
+    memset(undo, 0, sizeof(*undo));
+    return undo;
+}
+
+static void swap_bodies(struct jsonValue *left, struct jsonValue *right) {
+    struct jsonValue body = *left;
+    *left = *right;
+    *right = body;
+}
+
+static void undo(struct undo *undo) {
+    struct jsonObject *object = &undo->container->v.object;
+    struct jsonArray *array = &undo->container->v.array;
+    switch (undo->kind) {
+    case UNDO_MEMBER_ADD: {
+        struct jsonObjectEntry entry = object_remove(object, object_find_id(object, undo->entry.key->hash,
+                undo->entry.id));
+        string_free(entry.key);
+        break;
+    }
+    case UNDO_MEMBER_REMOVE:
+        object_restore(object, undo->index, &undo->entry);
+        break;
+    case UNDO_MEMBER_REPLACE:
+        object->entries[object_find_id(object, undo->hash, undo->entry.id)].value = undo->removed;
+        break;
+    case UNDO_ELEMENT_INSERT:
+        array_remove(array, undo->index);
+        break;
+    case UNDO_ELEMENT_REMOVE: {
+        // The array had room for the element before.
+        bool inserted = array_insert(array, undo->index, undo->removed);
+        assert(inserted);
+        (void) inserted;
+        break;
+    }
+    case UNDO_ELEMENT_REPLACE:
+        array->values[undo->index] = undo->removed;
+        break;
+    case UNDO_ROOT_REPLACE:
+        // The added node holds the old body, swapping back puts the new one
+        // there to be freed.
+        swap_bodies(undo->container, undo->added);
+        break;
+    }
+    if (undo->added && !undo->keep_added) {
+        json_value_free(undo->added);
+    }
+}
+
+static void commit(struct undo *undo) {
+    if (undo->kind == UNDO_MEMBER_REMOVE) {
+        string_free(undo->entry.key);
+    }
+    if (undo->kind == UNDO_ROOT_REPLACE) {
+        json_value_free(undo->added);
+    } else if (undo->removed && !undo->keep_removed) {
+        json_value_free(undo->removed);
+    }
+}
+
+static bool finish(struct patcher *patcher, bool ok) {
+    if (ok) {
+        for (size_t i = 0; i < patcher->size; ++i) {
+            commit(&patcher->log[i]);
+        }
+    } else {
+        for (size_t i = patcher->size; i--;) {
+            undo(&patcher->log[i]);
+        }
+    }
+    json_free(patcher->log);
+    return ok;
+}
+
+static bool missing(const char *message) {
+    set_error(JSON_ERROR_PATCH, message);
+    return false;
+}
+
+/* Where the value a reference token refers to is stored in a container. */
+static struct jsonValue **child_slot(struct jsonValue *container, const struct pointerSegment *segment) {
+    if (container->kind == JVK_OBJ) {
+        return object_slot_hashed(&container->v.object, segment->key, segment->hash);
+    }
+    if (container->kind == JVK_ARR && segment->index < container->v.array.size) {
+        return &container->v.array.values[segment->index];
+    }
+    return NULL;
+}
+
+/* Container the last reference token of a pointer refers into. Shared values
+ * on the way are replaced by copies the way json_object_lookup_mut() does,
+ * which is not undone: the copies are equal to them. */
+static struct jsonValue *walk_to_parent(struct patcher *patcher, const struct jsonPointer *pointer) {
+    assert(pointer->size);
+    struct jsonValue *value = patcher->root;
+    for (size_t i = 0; i + 1 < pointer->size; ++i) {
+        if (value_is_snapshot(value)) {
+            set_error(JSON_ERROR_READ_ONLY, "snapshot values can't be changed");
+            return NULL;
+        }
+        struct jsonValue **slot = child_slot(value, &pointer->segments[i]);
+        if (!slot) {
+            missing("path doesn't exist");
+            return NULL;
+        }
+        if (!(value = share_unshare(slot))) {
+            return NULL;
+        }
+    }
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values can't be changed");
+        return NULL;
+    }
+    if (value->kind != JVK_OBJ && value->kind != JVK_ARR) {
+        missing("path doesn't exist");
+        return NULL;
+    }
+    return value;
+}
+
+static const struct pointerSegment *last_segment(const struct jsonPointer *pointer) {
+    return &pointer->segments[pointer->size - 1];
+}
+
+/* The root is changed in place, so pointers to it stay valid: it swaps
+ * bodies with the new value, which is a fresh copy. */
+static bool replace_root(struct patcher *patcher, struct jsonValue *value) {
+    struct undo *undo = log_next(patcher);
+    if (!undo) {
+        return false;
+    }
+    assert(!value_is_snapshot(value) && !value_is_sealed(value));
+    swap_bodies(patcher->root, value);
+    undo->kind = UNDO_ROOT_REPLACE;
+    undo->container = patcher->root;
+    undo->added = value;
+    ++patcher->size;
+    return true;
+}
+
+static bool replace_in(struct patcher *patcher, struct jsonValue *parent, struct jsonValue **slot,
+        struct jsonValue *value, bool moved) {
+    struct undo *undo = log_next(patcher);
+    if (!undo) {
+        return false;
+    }
+    undo->container = parent;
+    undo->removed = *slot;
+    undo->added = value;
+    undo->keep_added = moved;
+    if (parent->kind == JVK_OBJ) {
+        struct jsonObjectEntry *entry = &parent->v.object.entries[object_index_of(&parent->v.object, slot)];
+        undo->kind = UNDO_MEMBER_REPLACE;
+        undo->entry.id = entry->id;
+        undo->hash = entry->key->hash;
+    } else {
+        undo->kind = UNDO_ELEMENT_REPLACE;
+        undo->index = (size_t) (slot - parent->v.array.values);
+    }
+    *slot = value;
+    ++patcher->size;
+    return true;
+}
+
+/* Adds a member, replacing the value of an existing one, or inserts an
+ * element. The value is taken over only on success. */
+static bool add_value(struct patcher *patcher, struct jsonValue *parent, const struct pointerSegment *segment,
+        struct jsonValue *value, bool moved) {
+    if (!parent) {
+        return replace_root(patcher, value);
+    }
+    struct undo *undo = log_next(patcher);
+    if (!undo) {
+        return false;
+    }
+    if (parent->kind == JVK_OBJ) {
+        struct jsonValue **slot = object_slot_hashed(&parent->v.object, segment->key, segment->hash);
+        if (slot) {
+            return replace_in(patcher, parent, slot, value, moved);
+        }
+        struct jsonString *key = string_create_str(segment->key);
+        if (!key) {
+            return false;
+        }
+        if (!object_add(&parent->v.object, key, value)) {
+            string_free(key);
+            return false;
+        }
+        slot = object_slot_hashed(&parent->v.object, key->data, key->hash);
+        undo->kind = UNDO_MEMBER_ADD;
+        undo->entry = parent->v.object.entries[object_index_of(&parent->v.object, slot)];
+    } else {
+        size_t index = strcmp(segment->key, "-") ? segment->index : parent->v.array.size;
+        if (index > parent->v.array.size) {
+            return missing("index is out of range");
+        }
+        if (!array_insert(&parent->v.array, index, value)) {
+            return false;
+        }
+        undo->kind = UNDO_ELEMENT_INSERT;
+        undo->index = index;
+    }
+    undo->container = parent;
+    undo->added = value;
+    undo->keep_added = moved;
+    ++patcher->size;
+    return true;
+}
+
+/* Takes a value out of the tree. Unless it's moved, it's freed with the
+ * other removed values once the patch is applied. */
+static struct jsonValue *remove_value(struct patcher *patcher, struct jsonValue *parent,
+        const struct pointerSegment *segment, bool moved) {
+    struct jsonValue **slot = child_slot(parent, segment);
+    if (!slot) {
+        missing("path doesn't exist");
+        return NULL;
+    }
+    struct undo *undo = log_next(patcher);
+    if (!undo) {
+        return NULL;
+    }
+    if (parent->kind == JVK_OBJ) {
+        undo->kind = UNDO_MEMBER_REMOVE;
+        undo->index = object_index_of(&parent->v.object, slot);
+        undo->entry = object_remove(&parent->v.object, undo->index);
+        undo->removed = undo->entry.value;
+    } else {
+        undo->kind = UNDO_ELEMENT_REMOVE;
+        undo->index = segment->index;
+        undo->removed = array_remove(&parent->v.array, segment->index);
+    }
+    undo->container = parent;
+    undo->keep_removed = moved;
+    ++patcher->size;
+    return undo->removed;
+}
+
+static bool add_copy(struct patcher *patcher, struct jsonValue *parent, const struct pointerSegment *segment,
+        struct jsonValue *value) {
+    struct jsonValue *copy = json_copy(value);
+    if (!copy) {
+        return false;
+    }
+    if (!add_value(patcher, parent, segment, copy, false)) {
+        json_value_free(copy);
+        return false;
+    }
+    return true;
+}
+
+static bool is_proper_prefix(const struct jsonPointer *prefix, const struct jsonPointer *pointer) {
+    if (prefix->size >= pointer->size) {
+        return false;
+    }
+    for (size_t i = 0; i < prefix->size; ++i) {
+        if (strcmp(prefix->segments[i].key, pointer->segments[i].key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same_pointers(const struct jsonPointer *left, const struct jsonPointer *right) {
+    if (left->size != right->size) {
+        return false;
+    }
+    for (size_t i = 0; i < left->size; ++i) {
+        if (strcmp(left->segments[i].key, right->segments[i].key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Member of an operation that must be a string. */
+static const char *member_string(struct jsonValue *operation, const char *key, const char *message) {
+    struct jsonValue *value = json_object_lookup(operation, key);
+    const char *string = NULL;
+    if (!value || !json_get_string(value, &string)) {
+        set_error(JSON_ERROR_ARGUMENT, message);
+        return NULL;
+    }
+    return string;
+}
+
+static struct jsonPointer *member_pointer(struct jsonValue *operation, const char *key, const char *message) {
+    const char *text = member_string(operation, key, message);
+    return text ? pointer_compile(text) : NULL;
+}
+
+static bool test(struct patcher *patcher, const struct jsonPointer *path, struct jsonValue *expected) {
+    struct jsonValue *actual = pointer_get(path, patcher->root);
+    if (!actual) {
+        return missing("path doesn't exist");
+    }
+    struct jsonValue *actual_copy = NULL;
+    struct jsonValue *expected_copy = NULL;
+    if (value_is_snapshot(actual) && !(actual = actual_copy = json_copy(actual))) {
+        return false;
+    }
+    if (value_is_snapshot(expected) && !(expected = expected_copy = json_copy(expected))) {
+        json_value_free(actual_copy);
+        return false;
+    }
+    bool ok = json_are_equal(actual, expected, NULL, NULL) || missing("test failed");
+    json_value_free(actual_copy);
+    json_value_free(expected_copy);
+    return ok;
+}
+
+static bool add(struct patcher *patcher, const struct jsonPointer *path, struct jsonValue *value) {
+    if (!path->size) {
+        return add_copy(patcher, NULL, NULL, value);
+    }
+    struct jsonValue *parent = walk_to_parent(patcher, path);
+    return parent && add_copy(patcher, parent, last_segment(path), value);
+}
+
+static bool remove_at(struct patcher *patcher, const struct jsonPointer *path) {
+    if (!path->size) {
+        return missing("the whole document can't be removed");
+    }
+    struct jsonValue *parent = walk_to_parent(patcher, path);
+    return parent && remove_value(patcher, parent, last_segment(path), false);
+}
+
+static bool replace(struct patcher *patcher, const struct jsonPointer *path, struct jsonValue *value) {
+    if (!path->size) {
+        return add_copy(patcher, NULL, NULL, value);
+    }
+    struct jsonValue *parent = walk_to_parent(patcher, path);
+    if (!parent) {
+        return false;
+    }
+    struct jsonValue **slot = child_slot(parent, last_segment(path));
+    if (!slot) {
+        return missing("path doesn't exist");
+    }
+    struct jsonValue *copy = json_copy(value);
+    if (!copy) {
+        return false;
+    }
+    if (!replace_in(patcher, parent, slot, copy, false)) {
+        json_value_free(copy);
+        return false;
+    }
+    return true;
+}
+
+/* RFC 6902 says move is remove and then add, so the path is walked after the
+ * value is taken out. Moving into the root copies the value, since the root
+ * keeps its node. */
+static bool move(struct patcher *patcher, const struct jsonPointer *from, const struct jsonPointer *path) {
+    if (same_pointers(from, path)) {
+        return pointer_get(from, patcher->root) || missing("path doesn't exist");
+    }
+    if (is_proper_prefix(from, path)) {
+        return missing("value can't be moved into itself");
+    }
+    struct jsonValue *parent = walk_to_parent(patcher, from);
+    if (!parent) {
+        return false;
+    }
+    if (!path->size) {
+        struct jsonValue **slot = child_slot(parent, last_segment(from));
+        if (!slot) {
+            return missing("path doesn't exist");
+        }
+        struct jsonValue *copy = json_copy(*slot);
+        if (!copy || !remove_value(patcher, parent, last_segment(from), false) || !replace_root(patcher, copy)) {
+            json_value_free(copy);
+            return false;
+        }
+        return true;
+    }
+    struct jsonValue *value = remove_value(patcher, parent, last_segment(from), true);
+    if (!value) {
+        return false;
+    }
+    parent = walk_to_parent(patcher, path);
+    return parent && add_value(patcher, parent, last_segment(path), value, true);
+}
+
+static bool copy(struct patcher *patcher, const struct jsonPointer *from, const struct jsonPointer *path) {
+    struct jsonValue *parent = path->size ? walk_to_parent(patcher, path) : NULL;
+    if (path->size && !parent) {
+        return false;
+    }
+    struct jsonValue *source = pointer_get(from, patcher->root);
+    if (!source) {
+        return missing("path doesn't exist");
+    }
+    return add_copy(patcher, parent, path->size ? last_segment(path) : NULL, source);
+}
+
+static bool apply_operation(struct patcher *patcher, struct jsonValue *operation) {
+    if ((operation->kind & ~JVK_SNAPSHOT) != JVK_OBJ) {
+        set_error(JSON_ERROR_ARGUMENT, "patch operation is not an object");
+        return false;
+    }
+    const char *op = member_string(operation, "op", "patch operation has no 'op' string");
+    struct jsonPointer *path = op ? member_pointer(operation, "path", "patch operation has no 'path' string") : NULL;
+    if (!path) {
+        return false;
+    }
+    bool ok = false;
+    if (!strcmp(op, "add") || !strcmp(op, "replace") || !strcmp(op, "test")) {
+        struct jsonValue *value = json_object_lookup(operation, "value");
+        if (!value) {
+            set_error(JSON_ERROR_ARGUMENT, "patch operation has no 'value'");
+        } else if (!strcmp(op, "add")) {
+            ok = add(patcher, path, value);
+        } else if (!strcmp(op, "replace")) {
+            ok = replace(patcher, path, value);
+        } else {
+            ok = test(patcher, path, value);
+        }
+    } else if (!strcmp(op, "remove")) {
+        ok = remove_at(patcher, path);
+    } else if (!strcmp(op, "move") || !strcmp(op, "copy")) {
+        struct jsonPointer *from = member_pointer(operation, "from", "patch operation has no 'from' string");
+        ok = from && (!strcmp(op, "move") ? move(patcher, from, path) : copy(patcher, from, path));
+        json_free(from);
+    } else {
+        set_error(JSON_ERROR_ARGUMENT, "unknown patch operation");
+    }
+    json_free(path);
+    return ok;
+}
+
+static bool check_target(struct jsonValue *target) {
+    if (value_is_snapshot(target) || value_is_sealed(target)) {
+        set_error(JSON_ERROR_READ_ONLY, "target is shared or belongs to a snapshot");
+        return false;
+    }
+    return true;
+}
+
+extern bool patch_apply(struct jsonValue *target, struct jsonValue *patch) {
+    assert(target);
+    assert(patch);
+    if (!check_target(target)) {
+        return false;
+    }
+    if ((patch->kind & ~JVK_SNAPSHOT) != JVK_ARR) {
+        set_error(JSON_ERROR_ARGUMENT, "patch is not an array");
+        return false;
+    }
+    struct patcher patcher = { target, NULL, 0, 0 };
+    size_t size = json_array_size(patch);
+    bool ok = true;
+    for (size_t i = 0; ok && i < size; ++i) {
+        ok = apply_operation(&patcher, json_array_at(patch, i));
+    }
+    return finish(&patcher, ok);
+}
+
+/* Members of the patch are applied one by one, nulls remove all values of
+ * their key. An object merged into a member that isn't an object replaces it
+ * with an empty one first, so it's merged the same way. */
+static bool merge(struct patcher *patcher, struct jsonValue *target, struct jsonValue *patch) {
+    assert(target->kind == JVK_OBJ);
+    size_t capacity = json_object_capacity(patch);
+    for (size_t i = 0; i < capacity; ++i) {
+        const char *key = NULL;
+        struct jsonValue *value = NULL;
+        json_object_get_entry(patch, i, &key, &value);
+        // Of repeated keys the last one counts.
+        if (!key || json_object_lookup(patch, key) != value) {
+            continue;
+        }
+        struct pointerSegment segment = { key, string_hash(key), SIZE_MAX };
+        struct jsonValue **slot = object_slot_hashed(&target->v.object, key, segment.hash);
+        switch (value->kind & ~JVK_SNAPSHOT) {
+        case JVK_NULL:
+            for (; slot; slot = object_slot_hashed(&target->v.object, key, segment.hash)) {
+                if (!remove_value(patcher, target, &segment, false)) {
+                    return false;
+                }
+            }
+            break;
+        case JVK_OBJ: {
+            struct jsonValue *child = slot ? share_unshare(slot) : NULL;
+            if (slot && !child) {
+                return false;
+            }
+            if (!child || child->kind != JVK_OBJ) {
+                // Objects of snapshots are merged into copies, other values are replaced.
+                child = child && child->kind == (JVK_SNAPSHOT | JVK_OBJ) ? json_copy(child) : json_create_object(0);
+                if (!child) {
+                    return false;
+                }
+                if (!add_value(patcher, target, &segment, child, false)) {
+                    json_value_free(child);
+                    return false;
+                }
+            }
+            if (!merge(patcher, child, value)) {
+                return false;
+            }
+            break;
+        }
+        default:
+            if (!add_copy(patcher, target, &segment, value)) {
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+extern bool merge_patch_apply(struct jsonValue *target, struct jsonValue *patch) {
+    assert(target);
+    assert(patch);
+    if (!check_target(target)) {
+        return false;
+    }
+    struct patcher patcher = { target, NULL, 0, 0 };
+    bool ok;
+    if ((patch->kind & ~JVK_SNAPSHOT) != JVK_OBJ) {
+        ok = add_copy(&patcher, NULL, NULL, patch);
+    } else {
+        struct jsonValue *object = NULL;
+        ok = target->kind == JVK_OBJ || ((object = json_create_object(0)) && replace_root(&patcher, object));
+        if (!ok) {
+            json_value_free(object);
+        }
+        ok = ok && merge(&patcher, target, patch);
+    }
+    return finish(&patcher, ok);
+}
@@ -0,0 +1,95 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+/* Array index a segment stands for. Segments that are no index, like "-",
+ * "01" or "x", get SIZE_MAX, which is past the end of any array. */
+static size_t index_of(const char *key) {
+    if (!*key || (key[0] == '0' && key[1])) {
+        return SIZE_MAX;
+    }
+    size_t index = 0;
+    for (const char *p = key; *p; ++p) {
+        if (*p < '0' || *p > '9' || index > (SIZE_MAX - 1 - (*p - '0')) / 10) {
+            return SIZE_MAX;
+        }
+        index = index * 10 + (*p - '0');
+    }
+    return index;
+}
+
+/* Segments and their unescaped text share one block. Unescaping never makes
+ * text longer, and each '/' makes room for the terminating '\0' of the
+ * segment it starts. */
+extern struct jsonPointer *pointer_compile(const char *text) {
+    assert(text);
+    if (*text && *text != '/') {
+        input_error(JSON_ERROR_SYNTAX, "json pointer must start with '/'", 0);
+        return NULL;
+    }
+    size_t size = 0;
+    size_t length = 0;
+    for (const char *p = text; *p; ++p, ++length) {
+        if (*p == '/') {
+            ++size;
+        } else if (*p == '~' && p[1] != '0' && p[1] != '1') {
+            input_error(JSON_ERROR_SYNTAX, "'~' must be followed by '0' or '1'", (size_t) (p - text));
+            return NULL;
+        }
+    }
+    struct jsonPointer *pointer = json_malloc(sizeof(struct jsonPointer) + size * sizeof(struct pointerSegment)
+            + length + 1);
+    if (!pointer) {
+        return NULL;
+    }
+    pointer->size = size;
+    char *out = (char *) &pointer->segments[size];
+    const char *p = text;
+    for (size_t i = 0; i < size; ++i) {
+        struct pointerSegment *segment = &pointer->segments[i];
+        segment->key = out;
+        for (++p; *p && *p != '/'; ++p) {
+            if (*p == '~') {
+                *out++ = *++p == '0' ? '~' : '/';
+            } else {
+                *out++ = *p;
+            }
+        }
+        *out++ = '\0';
+        segment->hash = string_hash(segment->key);
+        segment->index = index_of(segment->key);
+    }
+    return pointer;
+}
+
+/* A missing member, an index out of range or a scalar on the way give NULL.
+ * Keys were hashed when the pointer was compiled. */
+extern struct jsonValue *pointer_get(const struct jsonPointer *pointer, struct jsonValue *value) {
+    assert(pointer);
+    for (size_t i = 0; value && i < pointer->size; ++i) {
+        const struct pointerSegment *segment = &pointer->segments[i];
+        switch (value->kind & ~JVK_SNAPSHOT) {
+        case JVK_OBJ:
+            if (value_is_snapshot(value)) {
+                value = snapshot_object_next(value, segment->key, segment->hash, NULL);
+            } else {
+                struct jsonValue **slot = object_slot_hashed(&value->v.object, segment->key, segment->hash);
+                value = slot ? *slot : NULL;
+            }
+            break;
+        case JVK_ARR:
+            if (value_is_snapshot(value)) {
+                value = snapshot_array_at(value, segment->index);
+            } else {
+                value = segment->index < value->v.array.size ? value->v.array.values[segment->index] : NULL;
+            }
+            break;
+        default:
+            value = NULL;
+            break;
+        }
+    }
+    return value;
+}
@@ -0,0 +1,259 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "json_internal.h"
+
+// Bytes of objects in a slab the pool carves fresh objects from.
+#define POOL_SLAB_SIZE  (64 * 1024)
+// Number of objects moved between a thread and the global pool at once. A
+// thread keeps up to twice as many free objects of each kind.
+#define POOL_BATCH      256
+
+/* Layout of a free object. Objects in a thread cache are chained by next.
+ * The global pool keeps a stack of batches, the first object of a batch
+ * links to the next batch and knows the size of its own. */
+struct poolObject {
+    struct poolObject *next;
+    struct poolObject *next_batch;
+    size_t batch_size;
+};
+
+struct poolSlab {
+    struct poolSlab *next;
+    size_t size;
+    char objects[];
+};
+
+struct poolCache {
+    unsigned generation;
+    struct poolObject *free[POOL_KINDS];
+    size_t count[POOL_KINDS];
+};
+
+static const size_t object_size[POOL_KINDS] = {
+    [POOL_VALUE] = sizeof(struct jsonValue),
+    [POOL_STRING] = sizeof(struct jsonString),
+};
+
+static_assert(sizeof(struct jsonValue) >= sizeof(struct poolObject), "node can't hold free list links");
+static_assert(sizeof(struct jsonString) >= sizeof(struct poolObject), "string can't hold free list links");
+
+static thread_local struct poolCache cache;
+
+static once_flag once = ONCE_FLAG_INIT;
+static bool initialized;
+static mtx_t lock;
+static tss_t cache_key;
+
+// Guarded by lock.
+static struct poolObject *batches[POOL_KINDS];
+static struct poolSlab *slabs;
+// Bumped when slabs are released, so threads drop objects they still cache.
+// Released by pool_exit() after the slabs are gone, acquired by threads.
+static atomic_uint generation = 1;
+
+#ifndef RELEASE
+static atomic_size_t live;
+#endif
+
+static void pool_push_batch(enum poolKind kind, struct poolObject *first, size_t size) {
+    first->batch_size = size;
+    mtx_lock(&lock);
+    first->next_batch = batches[kind];
+    batches[kind] = first;
+    mtx_unlock(&lock);
+}
+
+/* Hands objects the exiting thread still caches to the global pool. */
+static void cache_flush(void *data) {
+    struct poolCache *exiting = data;
+    if (exiting->generation != atomic_load_explicit(&generation, memory_order_acquire)) {
+        return;
+    }
+    for (int kind = 0; kind < POOL_KINDS; ++kind) {
+        if (exiting->free[kind]) {
+            pool_push_batch(kind, exiting->free[kind], exiting->count[kind]);
+            exiting->free[kind] = NULL;
+            exiting->count[kind] = 0;
+        }
+    }
+}
+
+static void pool_init(void) {
+    if (mtx_init(&lock, mtx_plain) != thrd_success) {
+        return;
+    }
+    if (tss_create(&cache_key, cache_flush) != thrd_success) {
+        mtx_destroy(&lock);
+        return;
+    }
+    initialized = true;
+}
+
+/* Readies the cache on the first use by a thread, whether it allocates or only
+ * frees, and after the slabs were released. */
+static void cache_sync(void) {
+    unsigned current = atomic_load_explicit(&generation, memory_order_acquire);
+    if (cache.generation != current) {
+        call_once(&once, pool_init);
+        if (initialized) {
+            tss_set(cache_key, &cache);
+        }
+        for (int kind = 0; kind < POOL_KINDS; ++kind) {
+            cache.free[kind] = NULL;
+            cache.count[kind] = 0;
+        }
+        cache.generation = current;
+    }
+}
+
+/* Chains n objects of the slab together. */
+static struct poolObject *slab_chain(struct poolSlab *slab, size_t size, size_t n) {
+    for (size_t i = 0; i + 1 < n; ++i) {
+        struct poolObject *object = (struct poolObject *) (slab->objects + i * size);
+        object->next = (struct poolObject *) (slab->objects + (i + 1) * size);
+    }
+    ((struct poolObject *) (slab->objects + (n - 1) * size))->next = NULL;
+    return (struct poolObject *) slab->objects;
+}
+
+static bool pool_refill(enum poolKind kind) {
+    call_once(&once, pool_init);
+    if (!initialized) {
+        set_error(JSON_ERROR_OUT_OF_MEMORY, "out of memory");
+        return false;
+    }
+    mtx_lock(&lock);
+    struct poolObject *batch = batches[kind];
+    if (batch) {
+        batches[kind] = batch->next_batch;
+    }
+    mtx_unlock(&lock);
+    if (batch) {
+        cache.free[kind] = batch;
+        cache.count[kind] = batch->batch_size;
+        return true;
+    }
+    size_t size = object_size[kind];
+    size_t n = POOL_SLAB_SIZE / size;
+    struct poolSlab *slab = json_malloc(sizeof(struct poolSlab) + n * size);
+    if (!slab) {
+        return false;
+    }
+    // Slabs outlive the values in them, so they aren't leaks for the debug
+    // allocator. Objects handed out are counted instead.
+    json_mem_detach(slab);
+    slab->size = n * size;
+    mtx_lock(&lock);
+    slab->next = slabs;
+    slabs = slab;
+    mtx_unlock(&lock);
+    cache.free[kind] = slab_chain(slab, size, n);
+    cache.count[kind] = n;
+    return true;
+}
+
+extern void *pool_alloc(enum poolKind kind) {
+    cache_sync();
+    if (!cache.free[kind] && !pool_refill(kind)) {
+        return NULL;
+    }
+    struct poolObject *object = cache.free[kind];
+    cache.free[kind] = object->next;
+    --cache.count[kind];
+#ifndef RELEASE
+    ++live;
+#endif
+    return object;
+}
+
+/* Carves n objects that lie next to each other out of a slab of their own.
+ * They're freed one by one like any other object. */
+extern void *pool_alloc_run(enum poolKind kind, size_t n) {
+    assert(n);
+    call_once(&once, pool_init);
+    if (!initialized) {
+        set_error(JSON_ERROR_OUT_OF_MEMORY, "out of memory");
+        return NULL;
+    }
+    size_t size = object_size[kind];
+    if (n > (SIZE_MAX - sizeof(struct poolSlab)) / size) {
+        set_error(JSON_ERROR_OUT_OF_MEMORY, "out of memory");
+        return NULL;
+    }
+    struct poolSlab *slab = json_malloc(sizeof(struct poolSlab) + n * size);
+    if (!slab) {
+        return NULL;
+    }
+    json_mem_detach(slab);
+    slab->size = n * size;
+    mtx_lock(&lock);
+    slab->next = slabs;
+    slabs = slab;
+    mtx_unlock(&lock);
+#ifndef RELEASE
+    live += n;
+#endif
+    return slab->objects;
+}
+
+/* Gives POOL_BATCH most recently freed objects to the global pool. */
+static void pool_spill(enum poolKind kind) {
+    struct poolObject *first = cache.free[kind];
+    struct poolObject *last = first;
+    for (size_t i = 1; i < POOL_BATCH; ++i) {
+        last = last->next;
+    }
+    cache.free[kind] = last->next;
+    cache.count[kind] -= POOL_BATCH;
+    last->next = NULL;
+    pool_push_batch(kind, first, POOL_BATCH);
+}
+
+extern void pool_free(enum poolKind kind, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    cache_sync();
+    struct poolObject *object = ptr;
+    object->next = cache.free[kind];
+    cache.free[kind] = object;
+    if (++cache.count[kind] >= 2 * POOL_BATCH) {
+        pool_spill(kind);
+    }
+#ifndef RELEASE
+    --live;
+#endif
+}
+
+/* Releases all slabs. Objects from the pool must be freed by then, the ones
+ * still handed out would be left dangling. Debug builds check it. */
+extern void pool_exit(void) {
+    if (!initialized) {
+        return;
+    }
+#ifndef RELEASE
+    assert(!live);
+#endif
+    mtx_lock(&lock);
+    while (slabs) {
+        struct poolSlab *slab = slabs;
+        slabs = slab->next;
+        json_free(slab);
+    }
+    for (int kind = 0; kind < POOL_KINDS; ++kind) {
+        batches[kind] = NULL;
+    }
+    atomic_fetch_add_explicit(&generation, 1, memory_order_release);
+    mtx_unlock(&lock);
+}
+
+extern size_t pool_live_objects(void) {
+#ifndef RELEASE
+    return live;
+#else
+    return 0;
+#endif
+}
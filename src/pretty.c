@@ -1,193 +1,566 @@
 #include <assert.h>
 #include <math.h>
-#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <float.h>
 
 #include "json_internal.h"
 
-static thread_local char *out_begin;
-static thread_local size_t out_size;
-static thread_local size_t position;
-static thread_local unsigned indent;
+#define SORT_ON_STACK 32
 
-static thread_local const char *tab = "\t";
-static thread_local bool ascii_only = false;
+const struct jsonPrintOptions json_pretty_options = {
+    .pretty = true,
+    .indent_char = '\t',
+    .indent_width = 1,
+    .newline = JSON_NEWLINE_LF,
+    .ascii_only = false,
+    .sort_keys = false,
+};
 
-extern void pretty_print_begin(char *out, size_t size) {
-    out_begin = out;
-    out_size = size;
-    position = 0;
-    indent = 0;
-}
+/* Number of bytes a byte of a string takes when printed between quotes:
+ * 1 - printed as is, 2 - short escape sequence like \n, 6 - \u00XX. Bytes of
+ * multibyte UTF-8 sequences are printed as is unless ascii_only is set. */
+static const unsigned char escaped_size[256] = {
+    6, 6, 6, 6, 6, 6, 6, 6, 2, 2, 2, 6, 2, 2, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+static const char hex_digits[] = "0123456789abcdef";
 
-extern size_t pretty_print_end(void) {
-    if (position < out_size) {
-        out_begin[position] = '\0';
+extern void printer_init(struct printer *printer, char *out, size_t size, const struct jsonPrintOptions *options) {
+    assert(printer);
+    printer->out = out;
+    printer->size = out ? size : 0;
+    printer->position = 0;
+    printer->used = 0;
+    printer->sink = NULL;
+    printer->context = NULL;
+    printer->failed = false;
+    printer->depth = 0;
+    printer->options = options ? *options : json_pretty_options;
+    if (!printer->options.pretty) {
+        printer->newline_size = 0;
+        return;
+    }
+    if (printer->options.newline == JSON_NEWLINE_CRLF) {
+        memcpy(printer->indent, "\r\n", 2);
+        printer->newline_size = 2;
     } else {
-        ++position;
+        printer->indent[0] = '\n';
+        printer->newline_size = 1;
     }
-    out_begin = NULL;
-    return position;
+    memset(printer->indent + printer->newline_size, printer->options.indent_char,
+            sizeof(printer->indent) - printer->newline_size);
 }
 
-static void jprintf(const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    size_t size = position < out_size ? out_size - position : 0;
-    int n = vsnprintf(out_begin + position, size, fmt, args);
-    va_end(args);
-    position += n;
+/* Turns the out buffer into a staging area for the sink. */
+extern void printer_set_sink(struct printer *printer, bool (*sink)(void *, const char *, size_t), void *context) {
+    assert(printer && sink && printer->size);
+    printer->sink = sink;
+    printer->context = context;
 }
 
-static void print_indent(void) {
-    for (unsigned i = 0; i < indent; ++i) {
-        jprintf("%s", tab);
+/* Hands mem to the sink along with everything buffered so far. After the sink
+ * fails nothing is written anymore but bytes are still counted. */
+static void printer_flush(struct printer *printer, const char *mem, size_t n) {
+    if (printer->used && !printer->sink(printer->context, printer->out, printer->used)) {
+        printer->failed = true;
+    } else if (n >= printer->size && !printer->sink(printer->context, mem, n)) {
+        printer->failed = true;
+    } else if (n < printer->size) {
+        if (n) {
+            memcpy(printer->out, mem, n);
+        }
+        printer->used = n;
+        printer->position += n;
+        return;
+    }
+    printer->used = 0;
+    printer->position += n;
+    if (printer->failed) {
+        printer->sink = NULL;
+        printer->size = 0;
     }
 }
 
-static void print_json_string(struct jsonString *string) {
-    assert(string);
-    jprintf("\"");
-    const char * must_be_escaped =
-        "\"\\\x01\x02\x03\x04\x05\x06\x07"
-        "\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F"
-        "\x10\x11\x12\x13\x14\x15\x16\x17"
-        "\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F";
-    if (!ascii_only && !strpbrk(string->data, must_be_escaped)) {
-        jprintf("%s", string->data);
-    } else {
-        for (char c, *p = string->data; (c = *p); ++p) {
-            int n;
-            if (ascii_only && (n = c8len(c)) > 1) {
-                char16_t c16[2];
-                c32toc16be(c8toc32(p), c16);
-                jprintf("\\u%04x", c16[0]);
-                if (c16[1]) {
-                    jprintf("\\u%04x", c16[1]);
-                }
-                p += n - 1;
-                continue;
-            }
-            switch (c) {
-            case '\"':
-            case '\\':
-            case '/':
-                jprintf("\\%c", c);
-                break;
-            case '\b':
-                jprintf("\\b");
-                break;
-            case '\f':
-                jprintf("\\f");
-                break;
-            case '\n':
-                jprintf("\\n");
-                break;
-            case '\r':
-                jprintf("\\r");
-                break;
-            case '\t':
-                jprintf("\\t");
-                break;
-            default:
-                if ((unsigned char) c <= 0x1F) {
-                    jprintf("%c", c);
-                }
-                jprintf("%c", c);
-                break;
-            }
+extern size_t printer_finish(struct printer *printer) {
+    assert(printer);
+    if (printer->sink) {
+        if (printer->used) {
+            printer_flush(printer, NULL, 0);
         }
+    } else if (printer->size) {
+        size_t end = printer->used < printer->size ? printer->used : printer->size - 1;
+        printer->out[end] = '\0';
     }
-    jprintf("\"");
+    printer->out = NULL;
+    return printer->position;
 }
 
-static void print_json_number(double number) {
-    if (isnan(number)) {
-        jprintf("null");
+extern void print_mem(struct printer *printer, const char *mem, size_t n) {
+    if (printer->used + n > printer->size && printer->sink) {
+        printer_flush(printer, mem, n);
         return;
     }
-    if (isinf(number) == 1) {
-        number = DBL_MAX;
-    } else if (isinf(number) == -1) {
-        number = DBL_MIN;
+    if (printer->used < printer->size) {
+        size_t room = printer->size - printer->used;
+        memcpy(printer->out + printer->used, mem, n < room ? n : room);
     }
-    if ((long) number == number) {
-        jprintf("%ld", (long) number);
+    printer->used += n;
+    printer->position += n;
+}
+
+extern void print_char(struct printer *printer, char c) {
+    if (printer->used < printer->size) {
+        printer->out[printer->used++] = c;
+        ++printer->position;
     } else {
-        jprintf("%f", number);
+        print_mem(printer, &c, 1);
     }
 }
 
-static void print_json_object(struct jsonObject *object) {
-    if (!object->size) {
-        jprintf("{ }");
+/* Line break followed by indentation of the current depth. */
+extern void print_newline(struct printer *printer) {
+    if (!printer->options.pretty) {
         return;
     }
-    jprintf("{\n");
-    ++indent;
-    bool latch = false;
-    for (size_t i = 0; i < object->capacity; ++i) {
-        struct jsonObjectEntry *entry = &object->entries[i];
-        if (!entry->key || entry->key == &key_deleted) {
+    size_t table = sizeof(printer->indent) - printer->newline_size;
+    size_t n = (size_t) printer->depth * printer->options.indent_width;
+    size_t chunk = n < table ? n : table;
+    print_mem(printer, printer->indent, printer->newline_size + chunk);
+    for (n -= chunk; n; n -= chunk) {
+        chunk = n < table ? n : table;
+        print_mem(printer, printer->indent + printer->newline_size, chunk);
+    }
+}
+
+static void print_escaped_c16(struct printer *printer, char16_t c16) {
+    char buffer[6] = {
+        '\\', 'u',
+        hex_digits[(c16 >> 12) & 0xF],
+        hex_digits[(c16 >> 8) & 0xF],
+        hex_digits[(c16 >> 4) & 0xF],
+        hex_digits[c16 & 0xF],
+    };
+    print_mem(printer, buffer, sizeof(buffer));
+}
+
+static void print_escaped_char(struct printer *printer, unsigned char c) {
+    switch (c) {
+    case '\"':
+    case '\\':
+        print_char(printer, '\\');
+        print_char(printer, c);
+        break;
+    case '\b':
+        print_mem(printer, "\\b", 2);
+        break;
+    case '\f':
+        print_mem(printer, "\\f", 2);
+        break;
+    case '\n':
+        print_mem(printer, "\\n", 2);
+        break;
+    case '\r':
+        print_mem(printer, "\\r", 2);
+        break;
+    case '\t':
+        print_mem(printer, "\\t", 2);
+        break;
+    default:
+        print_escaped_c16(printer, c);
+        break;
+    }
+}
+
+/* Escape UTF-8 sequence starting at p as \uXXXX (or a surrogate pair).
+ * Returns the number of consumed bytes. A sequence cut by the end of the
+ * string is printed byte by byte. */
+static size_t print_escaped_sequence(struct printer *printer, const char *p, const char *end) {
+    int n = c8len(*p);
+    if (n < 2 || n > 4 || end - p < n) {
+        print_escaped_c16(printer, (unsigned char) *p);
+        return 1;
+    }
+    char16_t c16[2];
+    c32toc16be(c8toc32(p), c16);
+    print_escaped_c16(printer, c16[0]);
+    if (c16[1]) {
+        print_escaped_c16(printer, c16[1]);
+    }
+    return n;
+}
+
+extern void print_string(struct printer *printer, const char *data, size_t n) {
+    print_char(printer, '"');
+    const char *p = data;
+    const char *end = p + n;
+    const char *run = p;
+    bool ascii_only = printer->options.ascii_only;
+    while (p < end) {
+        unsigned char c = *p;
+        if (escaped_size[c] == 1 && !(ascii_only && c >= 0x80)) {
+            ++p;
             continue;
         }
-        if (latch) {
-            jprintf(",\n");
+        print_mem(printer, run, p - run);
+        if (c >= 0x80) {
+            p += print_escaped_sequence(printer, p, end);
+        } else {
+            print_escaped_char(printer, c);
+            ++p;
         }
-        latch = true;
-        print_indent();
-        print_json_string(entry->key);
-        jprintf(": ");
-        print_json_value(entry->value);
+        run = p;
+    }
+    print_mem(printer, run, p - run);
+    print_char(printer, '"');
+}
+
+static void print_json_string(struct printer *printer, struct jsonString *string) {
+    assert(string);
+    print_string(printer, string->data, string->size ? string->size - 1 : 0);
+}
+
+static double clamp_infinity(double number) {
+    if (isinf(number)) {
+        return number > 0 ? DBL_MAX : -DBL_MAX;
     }
-    --indent;
-    jprintf("\n");
-    print_indent();
-    jprintf("}");
+    return number;
+}
+
+static bool is_integral(double number) {
+    return -0x1p63 <= number && number < 0x1p63 && (long long) number == number;
 }
 
-static void print_json_array(struct jsonArray *array) {
-    if (!array->size) {
-        jprintf("[ ]");
+extern void print_number(struct printer *printer, double number) {
+    char buffer[DBL_MAX_10_EXP + 32];
+    int n;
+    if (isnan(number)) {
+        print_mem(printer, "null", 4);
         return;
     }
-    ++indent;
-    jprintf("[\n");
-    for (size_t i = 0; i < array->size; ++i) {
-        if (i) {
-            jprintf(",\n");
+    number = clamp_infinity(number);
+    if (is_integral(number)) {
+        n = snprintf(buffer, sizeof(buffer), "%lld", (long long) number);
+    } else {
+        n = snprintf(buffer, sizeof(buffer), "%f", number);
+    }
+    print_mem(printer, buffer, n);
+}
+
+static int compare_entries(const void *left, const void *right) {
+    const struct jsonObjectEntry *l = *(const struct jsonObjectEntry * const *) left;
+    const struct jsonObjectEntry *r = *(const struct jsonObjectEntry * const *) right;
+    size_t l_size = l->key->size, r_size = r->key->size;
+    int result = memcmp(l->key->data, r->key->data, l_size < r_size ? l_size : r_size);
+    if (result) {
+        return result;
+    }
+    if (l_size != r_size) {
+        return l_size < r_size ? -1 : 1;
+    }
+    return (l->id > r->id) - (l->id < r->id);
+}
+
+/* Sorted entries of the objects being printed, one run per open object. */
+struct sortedEntries {
+    struct jsonObjectEntry **entries;
+    size_t capacity;
+    size_t size;
+    struct jsonObjectEntry *inline_entries[SORT_ON_STACK];
+};
+
+static bool sort_entries(struct sortedEntries *sorted, struct jsonObject *object) {
+    if (sorted->capacity - sorted->size < object->size) {
+        size_t new_capacity = sorted->capacity;
+        while (new_capacity - sorted->size < object->size) {
+            new_capacity *= 2;
+        }
+        struct jsonObjectEntry **old_entries = sorted->entries == sorted->inline_entries ? NULL : sorted->entries;
+        struct jsonObjectEntry **new_entries = json_realloc(old_entries, new_capacity * sizeof(*new_entries));
+        if (!new_entries) {
+            return false;
         }
-        print_indent();
-        print_json_value(array->values[i]);
+        if (sorted->entries == sorted->inline_entries) {
+            memcpy(new_entries, sorted->inline_entries, sorted->size * sizeof(*new_entries));
+        }
+        sorted->entries = new_entries;
+        sorted->capacity = new_capacity;
     }
-    --indent;
-    jprintf("\n");
-    print_indent();
-    jprintf("]");
+    struct jsonObjectEntry **entries = sorted->entries + sorted->size;
+    size_t n = 0;
+    for (size_t i = 0; i < object->capacity; ++i) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        if (entry->key && entry->key != &key_deleted) {
+            entries[n++] = entry;
+        }
+    }
+    assert(n == object->size);
+    qsort(entries, n, sizeof(*entries), compare_entries);
+    sorted->size += n;
+    return true;
+}
+
+static size_t member_count(struct jsonValue *value) {
+    return value->kind == JVK_OBJ ? value->v.object.size : value->kind == JVK_ARR ? value->v.array.size : 0;
 }
 
-extern void print_json_value(struct jsonValue *value) {
+/* Prints anything but containers with members. */
+static void print_leaf(struct printer *printer, struct jsonValue *value) {
     switch (value->kind) {
     case JVK_STR:
-        print_json_string(&value->v.string);
+        print_json_string(printer, &value->v.string);
         break;
     case JVK_NUM:
-        print_json_number(value->v.number);
+        print_number(printer, value->v.number);
         break;
     case JVK_OBJ:
-        print_json_object(&value->v.object);
+        print_mem(printer, printer->options.pretty ? "{ }" : "{}", printer->options.pretty ? 3 : 2);
         break;
     case JVK_ARR:
-        print_json_array(&value->v.array);
+        print_mem(printer, printer->options.pretty ? "[ ]" : "[]", printer->options.pretty ? 3 : 2);
         break;
     case JVK_BOOL:
-        jprintf(value->v.boolean ? "true" : "false");
+        if (value->v.boolean) {
+            print_mem(printer, "true", 4);
+        } else {
+            print_mem(printer, "false", 5);
+        }
         break;
     case JVK_NULL:
     default:
-        jprintf("null");
+        print_mem(printer, "null", 4);
         break;
     }
 }
+
+static bool print_open(struct printer *printer, struct walk *walk, struct sortedEntries *sorted,
+        struct jsonValue *container) {
+    bool object = container->kind == JVK_OBJ;
+    if (!walk_push(walk, container)) {
+        return false;
+    }
+    walk->frames[walk->depth - 1].mark = sorted->size;
+    if (object && printer->options.sort_keys && !sort_entries(sorted, &container->v.object)) {
+        return false;
+    }
+    print_char(printer, object ? '{' : '[');
+    ++printer->depth;
+    return true;
+}
+
+static void print_close(struct printer *printer, struct walk *walk, struct sortedEntries *sorted) {
+    struct walkFrame *frame = &walk->frames[--walk->depth];
+    sorted->size = frame->mark;
+    --printer->depth;
+    print_newline(printer);
+    print_char(printer, frame->container->kind == JVK_OBJ ? '}' : ']');
+}
+
+/* Prints what goes before the next member of the innermost container and
+ * returns the member, NULL if there are none left. */
+static struct jsonValue *print_next(struct printer *printer, struct walk *walk, struct sortedEntries *sorted) {
+    struct walkFrame *frame = &walk->frames[walk->depth - 1];
+    struct jsonString *key;
+    struct jsonValue *value;
+    if (frame->container->kind == JVK_OBJ && printer->options.sort_keys) {
+        if (frame->count == frame->container->v.object.size) {
+            return NULL;
+        }
+        struct jsonObjectEntry *entry = sorted->entries[frame->mark + frame->count++];
+        key = entry->key;
+        value = entry->value;
+    } else if (!(value = walk_next(walk, &key))) {
+        return NULL;
+    }
+    if (frame->count > 1) {
+        print_char(printer, ',');
+    }
+    print_newline(printer);
+    if (key) {
+        print_json_string(printer, key);
+        if (printer->options.pretty) {
+            print_mem(printer, ": ", 2);
+        } else {
+            print_char(printer, ':');
+        }
+    }
+    return value;
+}
+
+/* Open containers are kept on a stack instead of recursing, so the depth of
+ * the tree is only limited by memory. */
+extern bool print_json_value(struct printer *printer, struct jsonValue *value) {
+    struct walk walk;
+    struct sortedEntries sorted;
+    walk_init(&walk);
+    sorted.entries = sorted.inline_entries;
+    sorted.capacity = SORT_ON_STACK;
+    sorted.size = 0;
+    bool result = true;
+    while (result && value) {
+        if (member_count(value)) {
+            result = print_open(printer, &walk, &sorted, value);
+        } else {
+            print_leaf(printer, value);
+        }
+        value = NULL;
+        while (result && walk.depth && !(value = print_next(printer, &walk, &sorted))) {
+            print_close(printer, &walk, &sorted);
+        }
+    }
+    walk_free(&walk);
+    if (sorted.entries != sorted.inline_entries) {
+        json_free(sorted.entries);
+    }
+    return result;
+}
+
+static size_t escaped_sequence_size(const char *p, const char *end, size_t *consumed) {
+    int n = c8len(*p);
+    if (n < 2 || n > 4 || end - p < n) {
+        *consumed = 1;
+        return 6;
+    }
+    *consumed = n;
+    return c8toc32(p) < 0x10000ull ? 6 : 12;
+}
+
+static size_t string_printed_size(struct printer *printer, struct jsonString *string) {
+    const char *p = string->data;
+    const char *end = p + (string->size ? string->size - 1 : 0);
+    size_t size = 2;
+    if (!printer->options.ascii_only) {
+        for (; p < end; ++p) {
+            size += escaped_size[(unsigned char) *p];
+        }
+        return size;
+    }
+    while (p < end) {
+        unsigned char c = *p;
+        if (c < 0x80) {
+            size += escaped_size[c];
+            ++p;
+        } else {
+            size_t consumed;
+            size += escaped_sequence_size(p, end, &consumed);
+            p += consumed;
+        }
+    }
+    return size;
+}
+
+static size_t digits_size(unsigned long long n) {
+    size_t size = 1;
+    while (n >= 10) {
+        n /= 10;
+        ++size;
+    }
+    return size;
+}
+
+/* Mirrors print_number(). Integers are "%lld", the rest is "%f" i.e. six
+ * decimals. Integral part of "%f" can only change by rounding the fraction up.
+ * Numbers too big for long long and fractions exactly on the rounding boundary
+ * are rare enough to be left to snprintf. */
+static size_t number_printed_size(double number) {
+    if (isnan(number)) {
+        return 4;
+    }
+    number = clamp_infinity(number);
+    if (is_integral(number)) {
+        long long integer = (long long) number;
+        if (integer < 0) {
+            return 1 + digits_size(-(unsigned long long) integer);
+        }
+        return digits_size(integer);
+    }
+    double magnitude = fabs(number);
+    if (magnitude >= 0x1p63) {
+        return snprintf(NULL, 0, "%f", number);
+    }
+    unsigned long long integer = (unsigned long long) magnitude;
+    double fraction = magnitude - (double) integer;
+    if (fraction == 0.9999995) {
+        return snprintf(NULL, 0, "%f", number);
+    }
+    if (fraction > 0.9999995) {
+        ++integer;
+    }
+    return (number < 0) + digits_size(integer) + 7;
+}
+
+static size_t newline_size(struct printer *printer) {
+    if (!printer->options.pretty) {
+        return 0;
+    }
+    return printer->newline_size + (size_t) printer->depth * printer->options.indent_width;
+}
+
+/* Size of anything but containers with members. */
+static size_t leaf_printed_size(struct printer *printer, struct jsonValue *value) {
+    switch (value->kind) {
+    case JVK_STR:
+        return string_printed_size(printer, &value->v.string);
+    case JVK_NUM:
+        return number_printed_size(value->v.number);
+    case JVK_OBJ:
+    case JVK_ARR:
+        return printer->options.pretty ? 3 : 2;
+    case JVK_BOOL:
+        return value->v.boolean ? 4 : 5;
+    case JVK_NULL:
+    default:
+        return 4;
+    }
+}
+
+/* Walks the tree like print_json_value(). Returns 0 if the stack of open
+ * containers can't grow. */
+extern size_t print_json_value_size(struct printer *printer, struct jsonValue *value) {
+    struct walk walk;
+    walk_init(&walk);
+    size_t size = 0;
+    while (value) {
+        size_t n = member_count(value);
+        if (!n) {
+            size += leaf_printed_size(printer, value);
+        } else if (walk_push(&walk, value)) {
+            // Brackets, commas, a newline before each member and key separators.
+            ++printer->depth;
+            size += 2 + n - 1 + n * newline_size(printer);
+            if (value->kind == JVK_OBJ) {
+                size += n * (printer->options.pretty ? 2 : 1);
+            }
+        } else {
+            size = 0;
+            break;
+        }
+        value = NULL;
+        struct jsonString *key = NULL;
+        while (walk.depth && !(value = walk_next(&walk, &key))) {
+            --walk.depth;
+            --printer->depth;
+            size += newline_size(printer);
+        }
+        if (value && key) {
+            size += string_printed_size(printer, key);
+        }
+    }
+    walk_free(&walk);
+    return size;
+}
@@ -0,0 +1,821 @@
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+// States of a query are bits of a mask: one per step and one for a match.
+#define QUERY_MAX_STEPS 63
+
+// Nesting depth query_parse() handles without allocating.
+#define QUERY_INLINE_DEPTH 32
+
+#define BIT(i) ((uint64_t) 1 << (i))
+
+enum stepKind {
+    STEP_NAME,
+    STEP_WILDCARD,
+    STEP_INDEX,
+    STEP_SLICE,
+    STEP_FILTER
+};
+
+enum filterOperator {
+    FILTER_EXISTS,
+    FILTER_EQ,
+    FILTER_NE,
+    FILTER_LT,
+    FILTER_LE,
+    FILTER_GT,
+    FILTER_GE
+};
+
+struct queryStep {
+    enum stepKind kind;
+    bool descendant; // applies at any depth below, not just to children
+    char *name;
+    unsigned hash;
+    long long start; // also the index of STEP_INDEX
+    long long end;
+    long long by;
+    bool has_start;
+    bool has_end;
+    struct jsonPointer *path; // what a filter looks at, relative to the candidate
+    enum filterOperator op;
+    struct jsonValue *literal;
+};
+
+/* A value is in state i if the path to it matched the steps before step i,
+ * and in state size if it matched them all. */
+struct jsonQuery {
+    size_t size;
+    uint64_t length_mask; // steps that count from the end of arrays
+    struct queryStep steps[];
+};
+
+struct compiler {
+    const char *text;
+    const char *p;
+    size_t size;
+    struct queryStep steps[QUERY_MAX_STEPS];
+};
+
+static bool compile_error(struct compiler *compiler, const char *message) {
+    input_error(JSON_ERROR_SYNTAX, message, (size_t) (compiler->p - compiler->text));
+    return false;
+}
+
+static void skip_blanks(struct compiler *compiler) {
+    while (*compiler->p == ' ') {
+        ++compiler->p;
+    }
+}
+
+static struct queryStep *add_step(struct compiler *compiler, bool descendant) {
+    if (compiler->size == QUERY_MAX_STEPS) {
+        input_error(JSON_ERROR_LIMIT, "query has too many steps", (size_t) (compiler->p - compiler->text));
+        return NULL;
+    }
+    struct queryStep *step = &compiler->steps[compiler->size++];
+    memset(step, 0, sizeof(*step));
+    step->descendant = descendant;
+    return step;
+}
+
+static bool is_name_char(char c) {
+    return (unsigned char) c >= 0x80 || isalnum((unsigned char) c) || c == '_' || c == '-' || c == '$';
+}
+
+static bool read_name(struct compiler *compiler, char **out) {
+    const char *begin = compiler->p;
+    while (is_name_char(*compiler->p)) {
+        ++compiler->p;
+    }
+    size_t n = (size_t) (compiler->p - begin);
+    if (!n) {
+        return compile_error(compiler, "name was expected");
+    }
+    *out = json_malloc(n + 1);
+    if (!*out) {
+        return false;
+    }
+    memcpy(*out, begin, n);
+    (*out)[n] = '\0';
+    return true;
+}
+
+/* Text in single or double quotes. A backslash takes the next character as
+ * it is. */
+static bool read_quoted(struct compiler *compiler, char **out) {
+    char quote = *compiler->p++;
+    char *text = json_malloc(strlen(compiler->p) + 1);
+    if (!text) {
+        return false;
+    }
+    size_t n = 0;
+    while (*compiler->p != quote) {
+        if (*compiler->p == '\\' && compiler->p[1]) {
+            ++compiler->p;
+        }
+        if (!*compiler->p) {
+            json_free(text);
+            return compile_error(compiler, "closing quote was expected");
+        }
+        text[n++] = *compiler->p++;
+    }
+    ++compiler->p;
+    text[n] = '\0';
+    *out = text;
+    return true;
+}
+
+static bool read_integer(struct compiler *compiler, long long *out) {
+    bool negative = *compiler->p == '-';
+    if (negative) {
+        ++compiler->p;
+    }
+    if (!isdigit((unsigned char) *compiler->p)) {
+        return compile_error(compiler, "integer was expected");
+    }
+    long long value = 0;
+    for (; isdigit((unsigned char) *compiler->p); ++compiler->p) {
+        int digit = *compiler->p - '0';
+        if (value > (LLONG_MAX - digit) / 10) {
+            return compile_error(compiler, "integer is too big");
+        }
+        value = value * 10 + digit;
+    }
+    *out = negative ? -value : value;
+    return true;
+}
+
+/* Appends a reference token of a json pointer, escaped. */
+static bool append_token(struct jsonString *pointer, const char *token) {
+    if (!string_append(pointer, '/')) {
+        return false;
+    }
+    for (const char *p = token; *p; ++p) {
+        bool ok = *p == '~' ? string_append_mem(pointer, "~0", 2)
+            : *p == '/' ? string_append_mem(pointer, "~1", 2) : string_append(pointer, *p);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Relative path of a filter, e.g. ".a['b'][0]", becomes a json pointer. */
+static bool compile_path(struct compiler *compiler, struct jsonString *pointer) {
+    while (*compiler->p == '.' || *compiler->p == '[') {
+        char *name = NULL;
+        char digits[32];
+        if (*compiler->p++ == '.') {
+            if (!read_name(compiler, &name)) {
+                return false;
+            }
+        } else {
+            if (*compiler->p == '\'' || *compiler->p == '"') {
+                if (!read_quoted(compiler, &name)) {
+                    return false;
+                }
+            } else {
+                long long index = 0;
+                if (!read_integer(compiler, &index)) {
+                    return false;
+                }
+                if (index < 0) {
+                    return compile_error(compiler, "index of a filter path must not be negative");
+                }
+                snprintf(digits, sizeof(digits), "%lld", index);
+            }
+            if (*compiler->p != ']') {
+                json_free(name);
+                return compile_error(compiler, "']' was expected");
+            }
+            ++compiler->p;
+        }
+        bool ok = append_token(pointer, name ? name : digits);
+        json_free(name);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Literals are json scalars, strings may be in single quotes too. */
+static bool read_literal(struct compiler *compiler, struct jsonValue **out) {
+    if (*compiler->p == '\'') {
+        char *text = NULL;
+        if (!read_quoted(compiler, &text)) {
+            return false;
+        }
+        *out = json_create_string(text);
+        json_free(text);
+        return *out != NULL;
+    }
+    struct jsonParseOptions options = { .allow_trailing_bytes = true, .encoding = JSON_ENCODING_UTF8 };
+    struct jsonValidation validation;
+    if (!json_validate(compiler->p, strlen(compiler->p), &options, &validation) || validation.depth) {
+        return compile_error(compiler, "number, string, true, false or null was expected");
+    }
+    *out = json_parse_with(compiler->p, validation.end, &options);
+    if (!*out) {
+        return false;
+    }
+    compiler->p += validation.end;
+    return true;
+}
+
+static bool compile_filter(struct compiler *compiler, struct queryStep *step) {
+    step->kind = STEP_FILTER;
+    ++compiler->p;
+    skip_blanks(compiler);
+    if (*compiler->p != '(') {
+        return compile_error(compiler, "'(' was expected");
+    }
+    ++compiler->p;
+    skip_blanks(compiler);
+    if (*compiler->p != '@') {
+        return compile_error(compiler, "'@' was expected");
+    }
+    ++compiler->p;
+    struct jsonString pointer;
+    string_init(&pointer);
+    bool ok = compile_path(compiler, &pointer) && string_append(&pointer, '\0');
+    step->path = ok ? pointer_compile(pointer.data) : NULL;
+    string_free_internal(&pointer);
+    if (!step->path) {
+        return false;
+    }
+    static const struct {
+        const char *text;
+        enum filterOperator op;
+    } operators[] = {
+        { "==", FILTER_EQ },
+        { "!=", FILTER_NE },
+        { "<=", FILTER_LE },
+        { ">=", FILTER_GE },
+        { "<", FILTER_LT },
+        { ">", FILTER_GT },
+    };
+    skip_blanks(compiler);
+    step->op = FILTER_EXISTS;
+    for (size_t i = 0; i < sizeof(operators) / sizeof(*operators); ++i) {
+        size_t n = strlen(operators[i].text);
+        if (!strncmp(compiler->p, operators[i].text, n)) {
+            step->op = operators[i].op;
+            compiler->p += n;
+            skip_blanks(compiler);
+            if (!read_literal(compiler, &step->literal)) {
+                return false;
+            }
+            skip_blanks(compiler);
+            break;
+        }
+    }
+    if (*compiler->p != ')') {
+        return compile_error(compiler, "')' was expected");
+    }
+    ++compiler->p;
+    return true;
+}
+
+/* Index or slice: [n], [start:end] or [start:end:by], any part of a slice may
+ * be left out. */
+static bool compile_range(struct compiler *compiler, struct queryStep *step) {
+    step->kind = STEP_INDEX;
+    if (*compiler->p != ':') {
+        if (!read_integer(compiler, &step->start)) {
+            return false;
+        }
+        step->has_start = true;
+        skip_blanks(compiler);
+        if (*compiler->p != ':') {
+            return true;
+        }
+    }
+    step->kind = STEP_SLICE;
+    step->by = 1;
+    ++compiler->p;
+    skip_blanks(compiler);
+    if (*compiler->p == '-' || isdigit((unsigned char) *compiler->p)) {
+        if (!read_integer(compiler, &step->end)) {
+            return false;
+        }
+        step->has_end = true;
+        skip_blanks(compiler);
+    }
+    if (*compiler->p == ':') {
+        ++compiler->p;
+        skip_blanks(compiler);
+        if (*compiler->p == '-' || isdigit((unsigned char) *compiler->p)) {
+            if (!read_integer(compiler, &step->by)) {
+                return false;
+            }
+            if (!step->by) {
+                return compile_error(compiler, "slice step must not be 0");
+            }
+        }
+    }
+    return true;
+}
+
+static bool compile_bracket(struct compiler *compiler, bool descendant) {
+    ++compiler->p;
+    skip_blanks(compiler);
+    struct queryStep *step = add_step(compiler, descendant);
+    if (!step) {
+        return false;
+    }
+    bool ok;
+    if (*compiler->p == '*') {
+        ++compiler->p;
+        step->kind = STEP_WILDCARD;
+        ok = true;
+    } else if (*compiler->p == '\'' || *compiler->p == '"') {
+        step->kind = STEP_NAME;
+        ok = read_quoted(compiler, &step->name);
+        step->hash = ok ? string_hash(step->name) : 0;
+    } else if (*compiler->p == '?') {
+        ok = compile_filter(compiler, step);
+    } else {
+        ok = compile_range(compiler, step);
+    }
+    if (!ok) {
+        return false;
+    }
+    skip_blanks(compiler);
+    if (*compiler->p != ']') {
+        return compile_error(compiler, "']' was expected");
+    }
+    ++compiler->p;
+    return true;
+}
+
+static bool compile_steps(struct compiler *compiler) {
+    if (*compiler->p != '$') {
+        return compile_error(compiler, "query must start with '$'");
+    }
+    ++compiler->p;
+    while (*compiler->p) {
+        bool descendant = compiler->p[0] == '.' && compiler->p[1] == '.';
+        if (descendant) {
+            compiler->p += 2;
+        } else if (*compiler->p == '.') {
+            ++compiler->p;
+        } else if (*compiler->p != '[') {
+            return compile_error(compiler, "'.' or '[' was expected");
+        }
+        if (*compiler->p == '[') {
+            if (!compile_bracket(compiler, descendant)) {
+                return false;
+            }
+            continue;
+        }
+        struct queryStep *step = add_step(compiler, descendant);
+        if (!step) {
+            return false;
+        }
+        if (*compiler->p == '*') {
+            ++compiler->p;
+            step->kind = STEP_WILDCARD;
+            continue;
+        }
+        step->kind = STEP_NAME;
+        if (!read_name(compiler, &step->name)) {
+            return false;
+        }
+        step->hash = string_hash(step->name);
+    }
+    return true;
+}
+
+static void free_steps(struct queryStep *steps, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        json_free(steps[i].name);
+        json_free(steps[i].path);
+        json_value_free(steps[i].literal);
+    }
+}
+
+static bool counts_from_end(const struct queryStep *step) {
+    switch (step->kind) {
+    case STEP_INDEX:
+        return step->start < 0;
+    case STEP_SLICE:
+        return step->by < 0 || (step->has_start && step->start < 0) || (step->has_end && step->end < 0);
+    default:
+        return false;
+    }
+}
+
+extern struct jsonQuery *query_compile(const char *text) {
+    assert(text);
+    struct compiler compiler;
+    compiler.text = compiler.p = text;
+    compiler.size = 0;
+    if (!compile_steps(&compiler)) {
+        free_steps(compiler.steps, compiler.size);
+        return NULL;
+    }
+    struct jsonQuery *query = json_malloc(sizeof(struct jsonQuery) + compiler.size * sizeof(struct queryStep));
+    if (!query) {
+        free_steps(compiler.steps, compiler.size);
+        return NULL;
+    }
+    query->size = compiler.size;
+    query->length_mask = 0;
+    for (size_t i = 0; i < compiler.size; ++i) {
+        query->steps[i] = compiler.steps[i];
+        if (counts_from_end(&query->steps[i])) {
+            query->length_mask |= BIT(i);
+        }
+    }
+    return query;
+}
+
+extern void query_free(struct jsonQuery *query) {
+    if (!query) {
+        return;
+    }
+    free_steps(query->steps, query->size);
+    json_free(query);
+}
+
+/* Python's rules. Without counting from the end the length isn't needed, so
+ * it may be LLONG_MAX. */
+static bool slice_contains(const struct queryStep *step, long long index, long long length) {
+    if (step->by > 0) {
+        long long start = step->has_start ? step->start : 0;
+        long long end = step->has_end ? step->end : length;
+        if (start < 0) {
+            start = start + length < 0 ? 0 : start + length;
+        }
+        if (end < 0) {
+            end += length;
+        }
+        return index >= start && index < end && (index - start) % step->by == 0;
+    }
+    long long start = step->has_start ? step->start : length - 1;
+    long long end = step->has_end ? step->end : -1 - length;
+    if (start < 0) {
+        start += length;
+    }
+    if (end < 0) {
+        end = end + length < -1 ? -1 : end + length;
+    }
+    return index <= start && index > end && (start - index) % -step->by == 0;
+}
+
+/* Only scalars of the same kind compare. */
+static bool compare_scalars(struct jsonValue *left, struct jsonValue *right, int *order) {
+    int kind = left->kind & ~JVK_SNAPSHOT;
+    if (kind != (int) (right->kind & ~JVK_SNAPSHOT)) {
+        return false;
+    }
+    switch (kind) {
+    case JVK_NUM: {
+        double l = 0, r = 0;
+        json_get_number(left, &l);
+        json_get_number(right, &r);
+        *order = (l > r) - (l < r);
+        return true;
+    }
+    case JVK_STR: {
+        const char *l = "", *r = "";
+        json_get_string(left, &l);
+        json_get_string(right, &r);
+        *order = strcmp(l, r);
+        return true;
+    }
+    case JVK_BOOL: {
+        bool l = false, r = false;
+        json_get_boolean(left, &l);
+        json_get_boolean(right, &r);
+        *order = l - r;
+        return true;
+    }
+    case JVK_NULL:
+        *order = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool filter_matches(const struct queryStep *step, struct jsonValue *value) {
+    struct jsonValue *target = pointer_get(step->path, value);
+    if (!target || step->op == FILTER_EXISTS) {
+        return target;
+    }
+    int order = 0;
+    if (!compare_scalars(target, step->literal, &order)) {
+        return step->op == FILTER_NE;
+    }
+    switch (step->op) {
+    case FILTER_EQ:
+        return !order;
+    case FILTER_NE:
+        return order;
+    case FILTER_LT:
+        return order < 0;
+    case FILTER_LE:
+        return order <= 0;
+    case FILTER_GT:
+        return order > 0;
+    default:
+        return order >= 0;
+    }
+}
+
+/* States of a member, if key isn't NULL, or of an element of a value in the
+ * given states. Filters that the child must pass for the next state are
+ * returned apart. */
+static uint64_t step_into(const struct jsonQuery *query, uint64_t states, const char *key, unsigned hash,
+        long long index, long long length, uint64_t *filters) {
+    uint64_t next = 0;
+    *filters = 0;
+    for (size_t i = 0; i < query->size && states >> i; ++i) {
+        if (!(states & BIT(i))) {
+            continue;
+        }
+        const struct queryStep *step = &query->steps[i];
+        if (step->descendant) {
+            next |= BIT(i);
+        }
+        bool match = false;
+        switch (step->kind) {
+        case STEP_NAME:
+            match = key && hash == step->hash && !strcmp(key, step->name);
+            break;
+        case STEP_WILDCARD:
+            match = true;
+            break;
+        case STEP_INDEX:
+            match = !key && index == (step->start < 0 ? step->start + length : step->start);
+            break;
+        case STEP_SLICE:
+            match = !key && slice_contains(step, index, length);
+            break;
+        case STEP_FILTER:
+            *filters |= BIT(i);
+            break;
+        }
+        if (match) {
+            next |= BIT(i + 1);
+        }
+    }
+    return next;
+}
+
+struct visitor {
+    bool (*visit)(struct visitor *visitor, struct jsonValue *value);
+};
+
+/* Walks the tree depth first, members of objects in the order of their
+ * table. */
+static bool select_value(const struct jsonQuery *query, struct jsonValue *value, uint64_t states, uint64_t filters,
+        struct visitor *visitor) {
+    for (size_t i = 0; filters >> i; ++i) {
+        if (filters & BIT(i) && filter_matches(&query->steps[i], value)) {
+            states |= BIT(i + 1);
+        }
+    }
+    if (states & BIT(query->size) && !visitor->visit(visitor, value)) {
+        return false;
+    }
+    states &= BIT(query->size) - 1;
+    if (!states) {
+        return true;
+    }
+    bool snapshot = value_is_snapshot(value);
+    uint64_t child_filters = 0;
+    switch (value->kind & ~JVK_SNAPSHOT) {
+    case JVK_ARR: {
+        size_t n = snapshot ? snapshot_size(value) : value->v.array.size;
+        for (size_t i = 0; i < n; ++i) {
+            struct jsonValue *element = snapshot ? snapshot_array_at(value, i) : value->v.array.values[i];
+            uint64_t next = step_into(query, states, NULL, 0, (long long) i, (long long) n, &child_filters);
+            if ((next || child_filters) && !select_value(query, element, next, child_filters, visitor)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case JVK_OBJ: {
+        size_t n = snapshot ? snapshot_size(value) : value->v.object.capacity;
+        for (size_t i = 0; i < n; ++i) {
+            const char *key = NULL;
+            unsigned hash = 0;
+            struct jsonValue *member = NULL;
+            if (snapshot) {
+                snapshot_object_get_entry(value, i, &key, &member);
+                hash = string_hash(key);
+            } else {
+                struct jsonObjectEntry *entry = &value->v.object.entries[i];
+                if (!entry->key || entry->key == &key_deleted) {
+                    continue;
+                }
+                key = entry->key->data;
+                hash = entry->key->hash;
+                member = entry->value;
+            }
+            uint64_t next = step_into(query, states, key, hash, 0, 0, &child_filters);
+            if ((next || child_filters) && !select_value(query, member, next, child_filters, visitor)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    default:
+        return true;
+    }
+}
+
+struct selection {
+    struct visitor visitor;
+    struct jsonValue **out;
+    size_t size;
+    size_t count;
+};
+
+static bool select_match(struct visitor *visitor, struct jsonValue *value) {
+    struct selection *selection = (struct selection *) visitor;
+    if (selection->count < selection->size) {
+        selection->out[selection->count] = value;
+    }
+    ++selection->count;
+    return true;
+}
+
+extern size_t query_select(const struct jsonQuery *query, struct jsonValue *value, struct jsonValue **out,
+        size_t size) {
+    struct selection selection = { { select_match }, out, size, 0 };
+    select_value(query, value, BIT(0), 0, &selection.visitor);
+    return selection.count;
+}
+
+/* Takes matches found in a value built while parsing. The value itself is
+ * kept if it matches, matches inside of it are copied. */
+struct collector {
+    struct visitor visitor;
+    struct jsonValue *results;
+    struct jsonValue *root;
+    bool kept;
+};
+
+static bool collect_match(struct visitor *visitor, struct jsonValue *value) {
+    struct collector *collector = (struct collector *) visitor;
+    if (value == collector->root) {
+        collector->kept = array_append(&collector->results->v.array, value);
+        return collector->kept;
+    }
+    struct jsonValue *copy = json_copy(value);
+    if (!copy) {
+        return false;
+    }
+    if (!array_append(&collector->results->v.array, copy)) {
+        json_value_free(copy);
+        return false;
+    }
+    return true;
+}
+
+static bool build(const struct jsonQuery *query, struct collector *collector, size_t max_depth, uint64_t states,
+        uint64_t filters) {
+    struct jsonValue *value = parse_json_text(false, max_depth);
+    if (!value) {
+        return false;
+    }
+    collector->root = value;
+    collector->kept = false;
+    bool ok = select_value(query, value, states, filters, &collector->visitor);
+    if (!collector->kept) {
+        json_value_free(value);
+    }
+    return ok;
+}
+
+struct queryFrame {
+    uint64_t states;
+    bool object;
+    size_t index;
+};
+
+/* Reads the key of the next member, if there's one, and works out the states
+ * of the value that follows. */
+static bool enter_child(const struct jsonQuery *query, const struct queryFrame *frame, struct jsonString *key,
+        uint64_t *states, uint64_t *filters) {
+    if (!frame->object) {
+        *states = step_into(query, frame->states, NULL, 0, (long long) frame->index, LLONG_MAX, filters);
+        return true;
+    }
+    if (!parser_key(key)) {
+        return false;
+    }
+    *states = step_into(query, frame->states, key->data, key->hash, 0, 0, filters);
+    return true;
+}
+
+/* Containers are looked into as long as something inside of them may match.
+ * A value is built only if it matches, if a filter must look at it, or if an
+ * index counts from its end. Everything else is only checked. */
+extern struct jsonValue *query_parse(const struct jsonQuery *query, bool all, size_t max_depth) {
+    struct jsonValue *results = json_create_array(0);
+    if (!results) {
+        return NULL;
+    }
+    struct collector collector = { { collect_match }, results, NULL, false };
+    struct queryFrame inline_stack[QUERY_INLINE_DEPTH];
+    struct queryFrame *stack = inline_stack;
+    size_t capacity = QUERY_INLINE_DEPTH;
+    size_t depth = 0;
+    struct jsonString key;
+    string_init(&key);
+    uint64_t states = BIT(0);
+    uint64_t filters = 0;
+    size_t ignored = 0;
+    while (true) {
+        skip_spaces();
+        int c = parser_peek();
+        if (filters || states & (BIT(query->size) | query->length_mask)) {
+            if (!build(query, &collector, max_depth - depth, states, filters)) {
+                goto fail;
+            }
+        } else if (!states || (c != '{' && c != '[')) {
+            if (!validate_json_text(false, max_depth - depth, &ignored, &ignored)) {
+                goto fail;
+            }
+        } else {
+            if (depth == max_depth) {
+                parser_error(JSON_ERROR_LIMIT, "maximum nesting depth exceeded");
+                goto fail;
+            }
+            if (depth == capacity) {
+                size_t new_capacity = capacity * 2;
+                struct queryFrame *new_stack = json_realloc(stack == inline_stack ? NULL : stack,
+                        new_capacity * sizeof(*stack));
+                if (!new_stack) {
+                    goto fail;
+                }
+                if (stack == inline_stack) {
+                    memcpy(new_stack, inline_stack, sizeof(inline_stack));
+                }
+                stack = new_stack;
+                capacity = new_capacity;
+            }
+            bool object = c == '{';
+            parser_consume_optionally(object ? "{" : "[");
+            stack[depth++] = (struct queryFrame) { states, object, 0 };
+            skip_spaces();
+            if (!parser_consume_optionally(object ? "}" : "]")) {
+                if (!enter_child(query, &stack[depth - 1], &key, &states, &filters)) {
+                    goto fail;
+                }
+                continue;
+            }
+            --depth;
+        }
+        // Close finished containers until another value is expected.
+        while (depth) {
+            struct queryFrame *frame = &stack[depth - 1];
+            skip_spaces();
+            if (parser_consume_optionally(frame->object ? "}" : "]")) {
+                --depth;
+                continue;
+            }
+            if (!parser_consume(",", "',' was expected")) {
+                goto fail;
+            }
+            ++frame->index;
+            if (!enter_child(query, frame, &key, &states, &filters)) {
+                goto fail;
+            }
+            break;
+        }
+        if (!depth) {
+            break;
+        }
+    }
+    skip_spaces();
+    if (all && EOF != parser_peek()) {
+        parser_error(JSON_ERROR_SYNTAX, "trailing bytes");
+        goto fail;
+    }
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    string_free_internal(&key);
+    return results;
+fail:
+    if (stack != inline_stack) {
+        json_free(stack);
+    }
+    string_free_internal(&key);
+    json_value_free(results);
+    return NULL;
+}
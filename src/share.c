@@ -0,0 +1,174 @@
+#include <assert.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+/* Values are shared between trees by counting their owners. A shared value
+ * is sealed together with everything below it, so it never changes and may
+ * be read by any number of threads. Seals are set bottom up: once a value
+ * looks sealed, so does its whole subtree. */
+
+static bool is_container(struct jsonValue *value) {
+    return value->kind == JVK_ARR || value->kind == JVK_OBJ;
+}
+
+static bool needs_seal(struct jsonValue *value) {
+    return !value_is_snapshot(value) && !value_is_sealed(value);
+}
+
+static void seal(struct jsonValue *value) {
+    atomic_fetch_or_explicit(&value->shares, SHARE_SEALED, memory_order_release);
+}
+
+/* Walks the tree on a stack of its own and writes nothing but the seals, so
+ * several threads may seal the same tree while others read it. */
+extern bool share_seal(struct jsonValue *value) {
+    if (!needs_seal(value)) {
+        return true;
+    }
+    if (!is_container(value)) {
+        seal(value);
+        return true;
+    }
+    struct walk walk;
+    walk_init(&walk);
+    walk_push(&walk, value);
+    bool ok = true;
+    while (walk.depth) {
+        struct jsonString *key;
+        struct jsonValue *member = walk_next(&walk, &key);
+        if (!member) {
+            seal(walk.frames[--walk.depth].container);
+        } else if (!needs_seal(member)) {
+            continue;
+        } else if (!is_container(member)) {
+            seal(member);
+        } else if (!walk_push(&walk, member)) {
+            ok = false;
+            break;
+        }
+    }
+    walk_free(&walk);
+    return ok;
+}
+
+/* Adds an owner. Snapshot values belong to their snapshot and aren't counted.
+ * Returns NULL if the value can't be sealed. */
+extern struct jsonValue *share_acquire(struct jsonValue *value) {
+    if (value_is_snapshot(value)) {
+        return value;
+    }
+    if (!share_seal(value)) {
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&value->shares, 1, memory_order_relaxed);
+    return value;
+}
+
+/* Drops an owner. Returns true if it was the last one, which frees the value. */
+extern bool share_release(struct jsonValue *value) {
+    unsigned shares = atomic_load_explicit(&value->shares, memory_order_acquire);
+    if (!(shares & ~SHARE_SEALED)) {
+        return true;
+    }
+    shares = atomic_fetch_sub_explicit(&value->shares, 1, memory_order_acq_rel);
+    return !(shares & ~SHARE_SEALED);
+}
+
+static struct jsonValue *copy_array(struct jsonArray *array) {
+    struct jsonValue *copy = json_create_array(array->size);
+    if (!copy) {
+        return NULL;
+    }
+    for (size_t i = 0; i < array->size; ++i) {
+        struct jsonValue *value = share_acquire(array->values[i]);
+        if (!value) {
+            json_value_free(copy);
+            return NULL;
+        }
+        copy->v.array.values[copy->v.array.size++] = value;
+    }
+    return copy;
+}
+
+/* The table is copied slot for slot, so no key is hashed again. */
+static struct jsonValue *copy_object(struct jsonObject *object) {
+    struct jsonValue *copy = value_alloc();
+    if (!copy) {
+        return NULL;
+    }
+    copy->kind = JVK_OBJ;
+    object_init(&copy->v.object);
+    if (!object->capacity) {
+        return copy;
+    }
+    struct jsonObjectEntry *entries = json_calloc(object->capacity * sizeof(struct jsonObjectEntry));
+    if (!entries) {
+        pool_free(POOL_VALUE, copy);
+        return NULL;
+    }
+    copy->v.object.entries = entries;
+    copy->v.object.capacity = object->capacity;
+    for (size_t i = 0; i < object->capacity; ++i) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        if (!entry->key || entry->key == &key_deleted) {
+            // Tombstones keep probe sequences of the copy intact.
+            entries[i].key = entry->key;
+            continue;
+        }
+        struct jsonString *key = string_duplicate(entry->key);
+        struct jsonValue *value = key ? share_acquire(entry->value) : NULL;
+        if (!value) {
+            string_free(key);
+            json_value_free(copy);
+            return NULL;
+        }
+        entries[i].id = entry->id;
+        entries[i].key = key;
+        entries[i].value = value;
+        ++copy->v.object.size;
+    }
+    copy->v.object.unique_size = object->unique_size;
+    copy->v.object.deleted = object->deleted;
+    return copy;
+}
+
+/* Fresh value that shares everything below it with the original. */
+extern struct jsonValue *share_copy(struct jsonValue *value) {
+    assert(value);
+    if (value_is_snapshot(value)) {
+        return json_copy(value);
+    }
+    switch (value->kind) {
+    case JVK_ARR:
+        return copy_array(&value->v.array);
+    case JVK_OBJ:
+        return copy_object(&value->v.object);
+    default:
+        return json_copy(value);
+    }
+}
+
+/* Makes the value in the slot changeable by the owner of the slot. If it has
+ * no other owners it's just unsealed, otherwise it's replaced by a copy. */
+extern struct jsonValue *share_unshare(struct jsonValue **slot) {
+    struct jsonValue *value = *slot;
+    if (value_is_snapshot(value) || !value_is_sealed(value)) {
+        return value;
+    }
+    if (!(atomic_load_explicit(&value->shares, memory_order_acquire) & ~SHARE_SEALED)) {
+        atomic_ullong *kept = value_kept_hash(value);
+        if (kept) {
+            atomic_store_explicit(kept, 0, memory_order_relaxed);
+        }
+        atomic_fetch_and_explicit(&value->shares, ~SHARE_SEALED, memory_order_relaxed);
+        return value;
+    }
+    struct jsonValue *copy = share_copy(value);
+    if (!copy) {
+        return NULL;
+    }
+    *slot = copy;
+    json_value_free(value);
+    return copy;
+}
@@ -0,0 +1,550 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "json_internal.h"
+
+/* Snapshot layout:
+ *
+ *   [header with the root node][blocks of nodes][string table]
+ *
+ * Elements of an array are a block of nodes. Entries of an object are a block
+ * of entries, each holding its value node inline, followed by a hash index of
+ * entry numbers. Every reference is an offset relative to the address of the
+ * node or entry holding it, so the snapshot can be mapped at any address and
+ * nodes are handed out to users as struct jsonValue pointers. Strings are
+ * stored once in the string table however many times they occur. */
+
+#define SNAPSHOT_MAGIC      "RJSNAP\0"
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+struct snapshotNode {
+    uint32_t kind;
+    uint32_t unique_size;
+    uint64_t size;
+    union {
+        double number;
+        uint64_t boolean;
+        int64_t offset;
+    } v;
+    uint64_t capacity;
+};
+
+struct snapshotEntry {
+    int64_t key;
+    uint32_t hash;
+    uint32_t key_size;
+    struct snapshotNode value;
+};
+
+struct snapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    struct snapshotNode root;
+};
+
+struct jsonSnapshot {
+    const void *memory;
+    size_t size;
+    bool mapped;
+};
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t) 7;
+}
+
+static size_t index_capacity(size_t size) {
+    size_t capacity = 1;
+    while (capacity < size * 2) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static const char *at_offset(const void *from, int64_t offset) {
+    return (const char *) from + offset;
+}
+
+static const struct snapshotNode *node_of(const struct jsonValue *value) {
+    assert(value_is_snapshot(value));
+    return (const struct snapshotNode *) value;
+}
+
+static const struct snapshotEntry *entries_of(const struct snapshotNode *node) {
+    return (const struct snapshotEntry *) at_offset(node, node->v.offset);
+}
+
+static const uint32_t *index_of(const struct snapshotNode *node) {
+    return (const uint32_t *) (entries_of(node) + node->size);
+}
+
+/* Strings seen while writing a snapshot with their place in the string table. */
+struct stringSlot {
+    const char *data;
+    size_t size;
+    unsigned hash;
+    size_t offset;
+};
+
+struct stringTable {
+    struct stringSlot *slots;
+    size_t capacity;
+    size_t count;
+    size_t size;
+};
+
+struct snapshotWriter {
+    char *out;
+    size_t cursor;
+    size_t strings;
+    struct stringTable table;
+};
+
+static struct stringSlot *table_find(struct stringTable *table, struct jsonString *string) {
+    size_t size = string->size ? string->size - 1 : 0;
+    for (size_t i = string->hash & (table->capacity - 1); ; i = (i + 1) & (table->capacity - 1)) {
+        struct stringSlot *slot = &table->slots[i];
+        if (!slot->data || (slot->hash == string->hash && slot->size == size
+                    && (!size || !memcmp(slot->data, string->data, size)))) {
+            return slot;
+        }
+    }
+}
+
+static bool table_grow(struct stringTable *table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : 256;
+    struct stringSlot *slots = json_calloc(capacity * sizeof(struct stringSlot));
+    if (!slots) {
+        return false;
+    }
+    for (size_t i = 0; i < table->capacity; ++i) {
+        struct stringSlot *slot = &table->slots[i];
+        if (!slot->data) {
+            continue;
+        }
+        size_t j = slot->hash & (capacity - 1);
+        while (slots[j].data) {
+            j = (j + 1) & (capacity - 1);
+        }
+        slots[j] = *slot;
+    }
+    json_free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    return true;
+}
+
+static bool table_add(struct stringTable *table, struct jsonString *string) {
+    if ((table->count + 1) * 2 > table->capacity && !table_grow(table)) {
+        return false;
+    }
+    struct stringSlot *slot = table_find(table, string);
+    if (slot->data) {
+        return true;
+    }
+    slot->data = string->data ? string->data : "";
+    slot->size = string->size ? string->size - 1 : 0;
+    slot->hash = string->hash;
+    slot->offset = table->size;
+    table->size += slot->size + 1;
+    ++table->count;
+    return true;
+}
+
+static size_t allocate(struct snapshotWriter *writer, size_t size) {
+    size_t position = writer->cursor;
+    writer->cursor += align8(size);
+    return position;
+}
+
+static int compare_entry_ids(const void *left, const void *right) {
+    const struct jsonObjectEntry *l = *(const struct jsonObjectEntry * const *) left;
+    const struct jsonObjectEntry *r = *(const struct jsonObjectEntry * const *) right;
+    return (l->id > r->id) - (l->id < r->id);
+}
+
+/* Entries of the object in the order they were added. */
+static struct jsonObjectEntry **sorted_entries(struct jsonObject *object) {
+    struct jsonObjectEntry **entries = json_malloc((object->size ? object->size : 1) * sizeof(*entries));
+    if (!entries) {
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < object->capacity; ++i) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        if (entry->key && entry->key != &key_deleted) {
+            entries[n++] = entry;
+        }
+    }
+    qsort(entries, n, sizeof(*entries), compare_entry_ids);
+    return entries;
+}
+
+/* Strings are written to the table only in the second pass, when every one of
+ * them is already known. */
+static int64_t string_offset(struct snapshotWriter *writer, size_t from, struct jsonString *string) {
+    struct stringSlot *slot = table_find(&writer->table, string);
+    assert(slot->data);
+    size_t position = writer->strings + slot->offset;
+    memcpy(writer->out + position, slot->data, slot->size);
+    writer->out[position + slot->size] = '\0';
+    return (int64_t) position - (int64_t) from;
+}
+
+/* Lays out the value as node at position `at`. The first pass (writer->out ==
+ * NULL) only reserves blocks and collects strings, the second one fills them
+ * in. Both passes reserve blocks in the same order. */
+static bool write_node(struct snapshotWriter *writer, size_t at, struct jsonValue *value) {
+    struct snapshotNode node = { JVK_SNAPSHOT | value->kind, 0, 0, { 0 }, 0 };
+    switch (value->kind) {
+    case JVK_STR:
+        node.size = value->v.string.size ? value->v.string.size - 1 : 0;
+        if (!writer->out) {
+            if (!table_add(&writer->table, &value->v.string)) {
+                return false;
+            }
+        } else {
+            node.v.offset = string_offset(writer, at, &value->v.string);
+        }
+        break;
+    case JVK_NUM:
+        node.v.number = value->v.number;
+        break;
+    case JVK_BOOL:
+        node.v.boolean = value->v.boolean;
+        break;
+    case JVK_NULL:
+        break;
+    case JVK_ARR: {
+        struct jsonArray *array = &value->v.array;
+        size_t block = allocate(writer, array->size * sizeof(struct snapshotNode));
+        node.size = array->size;
+        node.v.offset = (int64_t) block - (int64_t) at;
+        for (size_t i = 0; i < array->size; ++i) {
+            if (!write_node(writer, block + i * sizeof(struct snapshotNode), array->values[i])) {
+                return false;
+            }
+        }
+        break;
+    }
+    case JVK_OBJ: {
+        struct jsonObject *object = &value->v.object;
+        size_t capacity = index_capacity(object->size);
+        size_t block = allocate(writer, object->size * sizeof(struct snapshotEntry) + capacity * sizeof(uint32_t));
+        node.size = object->size;
+        node.unique_size = object->unique_size;
+        node.capacity = capacity;
+        node.v.offset = (int64_t) block - (int64_t) at;
+        struct jsonObjectEntry **entries = sorted_entries(object);
+        if (!entries) {
+            return false;
+        }
+        uint32_t *index = writer->out
+            ? (uint32_t *) (writer->out + block + object->size * sizeof(struct snapshotEntry)) : NULL;
+        if (index) {
+            memset(index, 0, capacity * sizeof(uint32_t));
+        }
+        bool result = true;
+        for (size_t i = 0; result && i < object->size; ++i) {
+            struct jsonString *key = entries[i]->key;
+            size_t position = block + i * sizeof(struct snapshotEntry);
+            if (!writer->out) {
+                result = table_add(&writer->table, key)
+                    && write_node(writer, position + offsetof(struct snapshotEntry, value), entries[i]->value);
+                continue;
+            }
+            struct snapshotEntry *entry = (struct snapshotEntry *) (writer->out + position);
+            entry->key = string_offset(writer, position, key);
+            entry->hash = key->hash;
+            entry->key_size = key->size ? key->size - 1 : 0;
+            size_t slot = key->hash & (capacity - 1);
+            while (index[slot]) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            index[slot] = i + 1;
+            result = write_node(writer, position + offsetof(struct snapshotEntry, value), entries[i]->value);
+        }
+        json_free(entries);
+        if (!result) {
+            return false;
+        }
+        break;
+    }
+    default:
+        set_error(JSON_ERROR_READ_ONLY, "snapshot values can't be put into another snapshot");
+        return false;
+    }
+    if (writer->out) {
+        memcpy(writer->out + at, &node, sizeof(node));
+    }
+    return true;
+}
+
+extern size_t snapshot_encode(void *out, size_t size, struct jsonValue *value) {
+    struct snapshotWriter writer = { NULL, sizeof(struct snapshotHeader), 0, { NULL, 0, 0, 0 } };
+    size_t total = 0;
+    if (!write_node(&writer, offsetof(struct snapshotHeader, root), value)) {
+        goto finish;
+    }
+    writer.strings = writer.cursor;
+    total = align8(writer.strings + writer.table.size);
+    if (!out || size < total) {
+        goto finish;
+    }
+    if ((uintptr_t) out % 8) {
+        set_error(JSON_ERROR_ARGUMENT, "snapshot buffer must be 8 byte aligned");
+        total = 0;
+        goto finish;
+    }
+    writer.out = out;
+    writer.cursor = sizeof(struct snapshotHeader);
+    memset(out, 0, total);
+    if (!write_node(&writer, offsetof(struct snapshotHeader, root), value)) {
+        total = 0;
+        goto finish;
+    }
+    struct snapshotHeader *header = out;
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->size = total;
+finish:
+    json_free(writer.table.slots);
+    return total;
+}
+
+extern bool snapshot_save(const char *path, struct jsonValue *value) {
+    size_t size = snapshot_encode(NULL, 0, value);
+    if (!size) {
+        return false;
+    }
+    void *buffer = json_malloc(size);
+    if (!buffer) {
+        return false;
+    }
+    bool result = false;
+    if (snapshot_encode(buffer, size, value) != size) {
+        goto finish;
+    }
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        set_error(JSON_ERROR_IO, "can't open snapshot file for writing");
+        goto finish;
+    }
+    result = fwrite(buffer, 1, size, file) == size;
+    result = !fclose(file) && result;
+    if (!result) {
+        set_error(JSON_ERROR_IO, "can't write snapshot file");
+    }
+finish:
+    json_free(buffer);
+    return result;
+}
+
+static bool snapshot_is_valid(const void *memory, size_t size) {
+    const struct snapshotHeader *header = memory;
+    if ((uintptr_t) memory % 8) {
+        set_error(JSON_ERROR_ARGUMENT, "snapshot must be 8 byte aligned");
+        return false;
+    }
+    if (size < sizeof(*header) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic))) {
+        set_error(JSON_ERROR_SYNTAX, "not a snapshot");
+        return false;
+    }
+    if (header->version != SNAPSHOT_VERSION || header->byte_order != SNAPSHOT_BYTE_ORDER) {
+        set_error(JSON_ERROR_SYNTAX, "snapshot was written by a different version or on a different platform");
+        return false;
+    }
+    if (header->size != size) {
+        set_error(JSON_ERROR_SYNTAX, "snapshot is truncated");
+        return false;
+    }
+    return true;
+}
+
+extern struct jsonSnapshot *snapshot_open_mem(const void *buffer, size_t size) {
+    if (!snapshot_is_valid(buffer, size)) {
+        return NULL;
+    }
+    struct jsonSnapshot *snapshot = json_malloc(sizeof(struct jsonSnapshot));
+    if (!snapshot) {
+        return NULL;
+    }
+    snapshot->memory = buffer;
+    snapshot->size = size;
+    snapshot->mapped = false;
+    return snapshot;
+}
+
+extern struct jsonSnapshot *snapshot_open(const char *path) {
+    struct jsonSnapshot *snapshot = NULL;
+    void *memory = MAP_FAILED;
+    struct stat info;
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        set_error(JSON_ERROR_IO, "can't open snapshot file");
+        return NULL;
+    }
+    if (fstat(file, &info) < 0) {
+        set_error(JSON_ERROR_IO, "can't stat snapshot file");
+        goto finish;
+    }
+    memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    if (memory == MAP_FAILED) {
+        set_error(JSON_ERROR_IO, "can't map snapshot file");
+        goto finish;
+    }
+    snapshot = snapshot_open_mem(memory, info.st_size);
+    if (!snapshot) {
+        munmap(memory, info.st_size);
+        goto finish;
+    }
+    snapshot->mapped = true;
+finish:
+    close(file);
+    return snapshot;
+}
+
+extern struct jsonValue *snapshot_root(struct jsonSnapshot *snapshot) {
+    const struct snapshotHeader *header = snapshot->memory;
+    return (struct jsonValue *) &header->root;
+}
+
+extern void snapshot_close(struct jsonSnapshot *snapshot) {
+    if (snapshot->mapped) {
+        munmap((void *) snapshot->memory, snapshot->size);
+    }
+    json_free(snapshot);
+}
+
+extern double snapshot_number(struct jsonValue *value) {
+    return node_of(value)->v.number;
+}
+
+extern const char *snapshot_string(struct jsonValue *value) {
+    const struct snapshotNode *node = node_of(value);
+    return at_offset(node, node->v.offset);
+}
+
+extern bool snapshot_boolean(struct jsonValue *value) {
+    return node_of(value)->v.boolean;
+}
+
+extern size_t snapshot_size(struct jsonValue *value) {
+    return node_of(value)->size;
+}
+
+extern size_t snapshot_unique_size(struct jsonValue *value) {
+    return node_of(value)->unique_size;
+}
+
+extern struct jsonValue *snapshot_array_at(struct jsonValue *value, size_t index) {
+    const struct snapshotNode *node = node_of(value);
+    if (index >= node->size) {
+        return NULL;
+    }
+    const struct snapshotNode *elements = (const struct snapshotNode *) at_offset(node, node->v.offset);
+    return (struct jsonValue *) &elements[index];
+}
+
+/* Entries are dense and kept in the order they were added. */
+extern void snapshot_object_get_entry(struct jsonValue *value, size_t i, const char **key, struct jsonValue **out) {
+    const struct snapshotNode *node = node_of(value);
+    assert(i < node->size);
+    const struct snapshotEntry *entry = &entries_of(node)[i];
+    *key = at_offset(entry, entry->key);
+    *out = (struct jsonValue *) &entry->value;
+}
+
+extern struct jsonValue *snapshot_object_next(struct jsonValue *value, const char *key, unsigned hash,
+        struct jsonValue *prev) {
+    const struct snapshotNode *node = node_of(value);
+    const struct snapshotEntry *entries = entries_of(node);
+    const uint32_t *index = index_of(node);
+    size_t limit = node->size;
+    if (prev) {
+        const char *from = (const char *) entries + offsetof(struct snapshotEntry, value);
+        size_t distance = (const char *) prev - from;
+        if ((const char *) prev < from || distance % sizeof(struct snapshotEntry)
+                || distance / sizeof(struct snapshotEntry) >= node->size) {
+            return NULL;
+        }
+        limit = distance / sizeof(struct snapshotEntry);
+    }
+    if (!node->capacity) {
+        return NULL;
+    }
+    size_t found = limit;
+    for (size_t i = hash & (node->capacity - 1); index[i]; i = (i + 1) & (node->capacity - 1)) {
+        size_t n = index[i] - 1;
+        const struct snapshotEntry *entry = &entries[n];
+        if (n < limit && (found == limit || n > found) && entry->hash == hash
+                && !strcmp(at_offset(entry, entry->key), key)) {
+            found = n;
+        }
+    }
+    return found == limit ? NULL : (struct jsonValue *) &entries[found].value;
+}
+
+/* Builds ordinary heap tree out of the snapshot value. */
+extern struct jsonValue *snapshot_copy(struct jsonValue *value) {
+    const struct snapshotNode *node = node_of(value);
+    struct jsonValue *copy = NULL;
+    switch (node->kind & ~JVK_SNAPSHOT) {
+    case JVK_STR:
+        return decoded_string((const unsigned char *) snapshot_string(value), node->size);
+    case JVK_NUM:
+        return json_create_number(node->v.number);
+    case JVK_BOOL:
+        return json_create_boolean(node->v.boolean);
+    case JVK_NULL:
+        return json_create_null();
+    case JVK_ARR:
+        copy = json_create_array(node->size);
+        if (!copy) {
+            return NULL;
+        }
+        for (size_t i = 0; i < node->size; ++i) {
+            struct jsonValue *element = snapshot_copy(snapshot_array_at(value, i));
+            if (!element || !array_append(&copy->v.array, element)) {
+                json_value_free(element);
+                goto fail;
+            }
+        }
+        return copy;
+    case JVK_OBJ:
+        copy = json_create_object(node->size);
+        if (!copy) {
+            return NULL;
+        }
+        for (size_t i = 0; i < node->size; ++i) {
+            const struct snapshotEntry *entry = &entries_of(node)[i];
+            struct jsonString *key = decoded_key((const unsigned char *) at_offset(entry, entry->key), entry->key_size);
+            if (!key) {
+                goto fail;
+            }
+            struct jsonValue *element = snapshot_copy((struct jsonValue *) &entry->value);
+            if (!element || !object_add(&copy->v.object, key, element)) {
+                string_free(key);
+                json_value_free(element);
+                goto fail;
+            }
+        }
+        return copy;
+    default:
+        assert(false);
+        return NULL;
+    }
+fail:
+    json_value_free(copy);
+    return NULL;
+}
@@ -10,7 +10,7 @@
 #define FNV_PRIME           16777619u
 
 extern struct jsonString *string_create(void) {
-    struct jsonString *string = json_malloc(sizeof(struct jsonString));
+    struct jsonString *string = pool_alloc(POOL_STRING);
     if (string) {
         string_init(string);
     }
@@ -18,13 +18,38 @@ extern struct jsonString *string_create(void) {
 }
 
 extern struct jsonString *string_create_str(const char *str) {
-    struct jsonString *string = json_malloc(sizeof(struct jsonString));
-    if (string) {
-        string_init_str(string, str);
+    struct jsonString *string = pool_alloc(POOL_STRING);
+    if (string && !string_init_str(string, str)) {
+        pool_free(POOL_STRING, string);
+        return NULL;
     }
     return string;
 }
 
+/* Copy keeps the hash, so it doesn't have to be computed again. */
+extern bool string_clone(struct jsonString *copy, const struct jsonString *string) {
+    *copy = *string;
+    if (!string->data) {
+        return true;
+    }
+    copy->data = json_malloc(string->size);
+    if (!copy->data) {
+        return false;
+    }
+    memcpy(copy->data, string->data, string->size);
+    copy->capacity = string->size;
+    return true;
+}
+
+extern struct jsonString *string_duplicate(const struct jsonString *string) {
+    struct jsonString *copy = pool_alloc(POOL_STRING);
+    if (copy && !string_clone(copy, string)) {
+        pool_free(POOL_STRING, copy);
+        return NULL;
+    }
+    return copy;
+}
+
 extern void string_init(struct jsonString *string) {
     assert(string);
     string->capacity = 0;
@@ -60,6 +85,11 @@ extern bool string_init_mem(struct jsonString *string, const char *mem, size_t n
     return true;
 }
 
+extern void string_free(struct jsonString *string) {
+    string_free_internal(string);
+    pool_free(POOL_STRING, string);
+}
+
 extern void string_free_internal(struct jsonString *string) {
     if (!string) {
         return;
@@ -80,14 +110,22 @@ static bool string_reserve(struct jsonString *string, size_t min_capacity) {
     do {
         new_capacity *= 2;
     } while (new_capacity < min_capacity);
-    string->data = json_realloc(string->data, new_capacity);
-    if (!string->data) {
+    char *data = json_realloc(string->data, new_capacity);
+    if (!data) {
         return false;
     }
+    string->data = data;
     string->capacity = new_capacity;
     return true;
 }
 
+/* Empties the string, but keeps its memory. */
+extern void string_clear(struct jsonString *string) {
+    assert(string);
+    string->size = 0;
+    string->hash = FNV_OFFSET_BASIS;
+}
+
 extern bool string_append(struct jsonString *string, char c) {
     assert(string);
     if (!string_reserve(string, string->size + 1)) {
@@ -98,6 +136,22 @@ extern bool string_append(struct jsonString *string, char c) {
     return true;
 }
 
+extern bool string_append_mem(struct jsonString *string, const char *mem, size_t n) {
+    assert(string);
+    assert(mem);
+    if (!string_reserve(string, string->size + n)) {
+        return false;
+    }
+    unsigned hash = string->hash;
+    for (size_t i = 0; i < n; ++i) {
+        hash = (hash ^ mem[i]) * FNV_PRIME;
+    }
+    memcpy(string->data + string->size, mem, n);
+    string->size += n;
+    string->hash = hash;
+    return true;
+}
+
 extern bool string_shrink(struct jsonString *string) {
     assert(string);
     if (!string->capacity) {
@@ -107,6 +161,7 @@ extern bool string_shrink(struct jsonString *string) {
     void *new_data = json_realloc(string->data, string->size);
     if (new_data) {
         string->data = new_data;
+        string->capacity = string->size;
     }
     return new_data;
 }
@@ -0,0 +1,275 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+
+#include "json_internal.h"
+
+// Number of call sites with their own statistics. Allocations from sites
+// that don't fit are summed up in one more entry.
+#define TRACK_SITES 1024
+
+// Size of a block is stored with this bit set after json_mem_detach().
+#define DETACHED ((size_t) 1 << (sizeof(size_t) * 8 - 1))
+
+/* Put in front of every block while tracking is on. Site is NULL for blocks
+ * that weren't sampled. */
+struct trackHeader {
+    alignas(max_align_t) struct jsonAllocationSite *site;
+    size_t size;
+};
+
+// Set before the first allocation, read by every thread afterwards.
+#ifndef RELEASE
+static atomic_bool track_enabled = true;
+static atomic_uint sample_period = 1;
+#else
+static atomic_bool track_enabled = false;
+static atomic_uint sample_period = 0;
+#endif
+
+// Set by the first allocation. From then on blocks may carry headers, so
+// tracking can't be switched on or off anymore.
+static atomic_bool started;
+
+static atomic_flag sites_lock = ATOMIC_FLAG_INIT;
+static struct jsonAllocationSite sites[TRACK_SITES + 1];
+
+// Sampled blocks that aren't detached, guarded by sites_lock like the sites.
+// Debug builds sample every block.
+static size_t live_blocks;
+
+static thread_local unsigned sample_countdown;
+
+static void lock_sites(void) {
+    while (atomic_flag_test_and_set_explicit(&sites_lock, memory_order_acquire)) {
+        thrd_yield();
+    }
+}
+
+static void unlock_sites(void) {
+    atomic_flag_clear_explicit(&sites_lock, memory_order_release);
+}
+
+static bool tracking(void) {
+    return atomic_load_explicit(&track_enabled, memory_order_relaxed);
+}
+
+static bool sample(void) {
+    unsigned period = atomic_load_explicit(&sample_period, memory_order_relaxed);
+    if (!period) {
+        return false;
+    }
+    if (!sample_countdown) {
+        sample_countdown = period;
+    }
+    return !--sample_countdown;
+}
+
+/* Must be called with sites locked. Files are string literals, so their
+ * addresses identify them. */
+static struct jsonAllocationSite *find_site(const char *file, int line) {
+    size_t i = ((uintptr_t) file >> 3 ^ (size_t) line * 2654435761u) % TRACK_SITES;
+    for (size_t probes = 0; probes < TRACK_SITES; ++probes, i = (i + 1) % TRACK_SITES) {
+        struct jsonAllocationSite *site = &sites[i];
+        if (site->file == file && site->line == line) {
+            return site;
+        }
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+            return site;
+        }
+    }
+    sites[TRACK_SITES].file = "<other>";
+    return &sites[TRACK_SITES];
+}
+
+static void site_add_live(struct jsonAllocationSite *site, size_t size) {
+    ++live_blocks;
+    site->live_bytes += size;
+    ++site->live_blocks;
+    if (site->live_bytes > site->peak_live_bytes) {
+        site->peak_live_bytes = site->live_bytes;
+    }
+}
+
+static void site_remove_live(struct jsonAllocationSite *site, size_t size) {
+    --live_blocks;
+    site->live_bytes -= size;
+    --site->live_blocks;
+}
+
+static void mark_started(void) {
+    if (!atomic_load_explicit(&started, memory_order_relaxed)) {
+        atomic_store(&started, true);
+    }
+}
+
+static void *track_block(struct trackHeader *header, size_t size, const char *file, int line) {
+    header->size = size;
+    header->site = NULL;
+    if (sample()) {
+        lock_sites();
+        struct jsonAllocationSite *site = find_site(file, line);
+        ++site->allocations;
+        site->bytes += size;
+        site_add_live(site, size);
+        header->site = site;
+        unlock_sites();
+    }
+    return header + 1;
+}
+
+extern void *track_malloc(size_t size, const char *file, int line) {
+    mark_started();
+    if (!tracking()) {
+        return json_malloc_(size);
+    }
+    struct trackHeader *header = json_malloc_(sizeof(struct trackHeader) + size);
+    return header ? track_block(header, size, file, line) : NULL;
+}
+
+extern void *track_calloc(size_t size, const char *file, int line) {
+    mark_started();
+    if (!tracking()) {
+        return json_calloc_(size);
+    }
+    struct trackHeader *header = json_calloc_(sizeof(struct trackHeader) + size);
+    return header ? track_block(header, size, file, line) : NULL;
+}
+
+extern void *track_realloc(void *ptr, size_t size, const char *file, int line) {
+    // Realloc of NULL allocates, so it starts tracking like track_malloc().
+    mark_started();
+    if (!tracking()) {
+        return json_realloc_(ptr, size);
+    }
+    if (!ptr) {
+        return track_malloc(size, file, line);
+    }
+    struct trackHeader *header = (struct trackHeader *) ptr - 1;
+    size_t old_size = header->size;
+    header = json_realloc_(header, sizeof(struct trackHeader) + size);
+    if (!header) {
+        return NULL;
+    }
+    header->size = size | (old_size & DETACHED);
+    if (header->site && !(old_size & DETACHED)) {
+        // The block now belongs to the site that resized it.
+        lock_sites();
+        site_remove_live(header->site, old_size);
+        struct jsonAllocationSite *site = find_site(file, line);
+        ++site->reallocations;
+        site->bytes += size;
+        site_add_live(site, size);
+        header->site = site;
+        unlock_sites();
+    }
+    return header + 1;
+}
+
+extern void track_free(void *ptr) {
+    if (!tracking()) {
+        json_free_(ptr);
+        return;
+    }
+    if (!ptr) {
+        return;
+    }
+    struct trackHeader *header = (struct trackHeader *) ptr - 1;
+    if (!(header->size & DETACHED) && header->site) {
+        lock_sites();
+        ++header->site->frees;
+        site_remove_live(header->site, header->size);
+        unlock_sites();
+    }
+    json_free_(header);
+}
+
+/* Detached blocks are deliberately kept alive, e.g. the last error message,
+ * and aren't reported as leaks. */
+extern void track_detach(void *ptr) {
+    if (!tracking() || !ptr) {
+        return;
+    }
+    struct trackHeader *header = (struct trackHeader *) ptr - 1;
+    if (header->size & DETACHED) {
+        return;
+    }
+    if (header->site) {
+        lock_sites();
+        site_remove_live(header->site, header->size);
+        unlock_sites();
+    }
+    header->size |= DETACHED;
+}
+
+extern bool track_set(unsigned period) {
+    if (atomic_load(&started) && (period != 0) != tracking()) {
+        return false;
+    }
+#ifndef RELEASE
+    // Debug builds check for leaks, which needs every block to be tracked.
+    if (!period) {
+        return false;
+    }
+#endif
+    atomic_store_explicit(&sample_period, period, memory_order_relaxed);
+    atomic_store_explicit(&track_enabled, period != 0, memory_order_relaxed);
+    return true;
+}
+
+extern size_t track_sites(struct jsonAllocationSite *out, size_t size) {
+    size_t n = 0;
+    lock_sites();
+    for (size_t i = 0; i <= TRACK_SITES; ++i) {
+        if (!sites[i].file) {
+            continue;
+        }
+        if (n < size) {
+            out[n] = sites[i];
+        }
+        ++n;
+    }
+    unlock_sites();
+    return n;
+}
+
+extern void track_dump(FILE *out) {
+    fprintf(out, "%-40s %12s %12s %12s %16s %16s %16s\n", "site", "allocations", "reallocs", "frees", "bytes",
+            "live bytes", "peak bytes");
+    lock_sites();
+    for (size_t i = 0; i <= TRACK_SITES; ++i) {
+        struct jsonAllocationSite *site = &sites[i];
+        if (!site->file) {
+            continue;
+        }
+        fprintf(out, "%-34s:%-5d %12zu %12zu %12zu %16zu %16zu %16zu\n", site->file, site->line, site->allocations,
+                site->reallocations, site->frees, site->bytes, site->live_bytes, site->peak_live_bytes);
+    }
+    unlock_sites();
+}
+
+extern bool dbg_is_memory_clear(void) {
+    lock_sites();
+    size_t blocks = live_blocks;
+    unlock_sites();
+    return !blocks && !pool_live_objects();
+}
+
+extern void dbg_print_blocks(void) {
+    printf("%zu pooled objects are not freed\n", pool_live_objects());
+    lock_sites();
+    printf("%zu blocks are not freed:\n", live_blocks);
+    for (size_t i = 0; i <= TRACK_SITES; ++i) {
+        if (sites[i].live_blocks) {
+            printf("%zu\t%zu\t%s:%d\n", sites[i].live_blocks, sites[i].live_bytes, sites[i].file, sites[i].line);
+        }
+    }
+    unlock_sites();
+}
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+static void string_usage(struct jsonString *string, struct jsonMemoryUsage *usage) {
+    if (!string->data) {
+        return;
+    }
+    ++usage->allocations;
+    usage->string_bytes += string->size;
+    usage->string_unused_bytes += string->capacity - string->size;
+}
+
+/* Counts the array itself, its values are walked separately. */
+static void array_usage(struct jsonArray *array, struct jsonMemoryUsage *usage) {
+    if (array->values) {
+        ++usage->allocations;
+    }
+    usage->array_bytes += array->size * sizeof(struct jsonValue *);
+    usage->array_unused_bytes += (array->capacity - array->size) * sizeof(struct jsonValue *);
+}
+
+/* Counts the table and the keys, values are walked separately. */
+static void object_usage(struct jsonObject *object, struct jsonMemoryUsage *usage) {
+    if (object->entries) {
+        ++usage->allocations;
+    }
+    for (size_t i = 0; i < object->capacity; ++i) {
+        struct jsonObjectEntry *entry = &object->entries[i];
+        if (!entry->key) {
+            usage->entry_empty_bytes += sizeof(struct jsonObjectEntry);
+            continue;
+        }
+        if (entry->key == &key_deleted) {
+            usage->entry_deleted_bytes += sizeof(struct jsonObjectEntry);
+            continue;
+        }
+        usage->entry_bytes += sizeof(struct jsonObjectEntry);
+        ++usage->keys;
+        usage->key_bytes += sizeof(struct jsonString);
+        string_usage(entry->key, usage);
+    }
+}
+
+static bool value_usage(struct jsonValue *value, struct jsonMemoryUsage *usage) {
+    if (value_is_snapshot(value)) {
+        set_error(JSON_ERROR_READ_ONLY, "memory of snapshot values belongs to the snapshot");
+        return false;
+    }
+    ++usage->nodes;
+    usage->node_bytes += sizeof(struct jsonValue);
+    switch (value->kind) {
+    case JVK_STR:
+        string_usage(&value->v.string, usage);
+        break;
+    case JVK_ARR:
+        array_usage(&value->v.array, usage);
+        break;
+    case JVK_OBJ:
+        object_usage(&value->v.object, usage);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+/* Containers are walked with a stack instead of recursing. */
+static bool tree_usage(struct jsonValue *value, struct jsonMemoryUsage *usage) {
+    struct walk walk;
+    walk_init(&walk);
+    bool ok = true;
+    while (ok && value) {
+        ok = value_usage(value, usage)
+            && ((value->kind != JVK_ARR && value->kind != JVK_OBJ) || walk_push(&walk, value));
+        value = NULL;
+        struct jsonString *key;
+        while (ok && walk.depth && !(value = walk_next(&walk, &key))) {
+            --walk.depth;
+        }
+    }
+    walk_free(&walk);
+    return ok;
+}
+
+extern bool memory_usage(struct jsonValue *value, struct jsonMemoryUsage *usage) {
+    assert(value);
+    assert(usage);
+    memset(usage, 0, sizeof(*usage));
+    if (!tree_usage(value, usage)) {
+        return false;
+    }
+    usage->total_bytes = usage->node_bytes + usage->key_bytes + usage->string_bytes + usage->string_unused_bytes
+        + usage->array_bytes + usage->array_unused_bytes + usage->entry_bytes + usage->entry_empty_bytes
+        + usage->entry_deleted_bytes;
+    return true;
+}
@@ -12,7 +12,7 @@ extern int c16len(char16_t c16) {
 }
 
 extern enum c16Type c16type(char16_t c16) {
-    if (c16 & 0xD800) {
+    if ((c16 & 0xF800) == 0xD800) {
         if (c16 & 0x400) {
             return UTF16_SURROGATE_LOW;
         } else {
@@ -104,3 +104,53 @@ extern void c32toc16be(char32_t c32, char16_t out[2]) {
         out[1] = 0xDC00 | (c32 & 0x3FF);
     }
 }
+
+/* Length of the well-formed sequence c8 starts with, 0 if there's none:
+ * overlong forms, surrogates, code points above U+10FFFF and sequences cut
+ * by the end are rejected. Second bytes are range checked as in table 3-7
+ * of the Unicode standard. */
+extern size_t c8check(const char *c8, size_t n) {
+    assert(n);
+    const unsigned char *p = (const unsigned char *) c8;
+    unsigned char c = *p;
+    if (c < 0x80) {
+        return 1;
+    }
+    size_t len = c8len(c);
+    if (len < 2 || len > 4 || n < len) {
+        return 0;
+    }
+    unsigned char lower = 0x80, upper = 0xBF;
+    if (c == 0xC0 || c == 0xC1 || c > 0xF4) {
+        return 0;
+    } else if (c == 0xE0) {
+        lower = 0xA0;
+    } else if (c == 0xED) {
+        upper = 0x9F;
+    } else if (c == 0xF0) {
+        lower = 0x90;
+    } else if (c == 0xF4) {
+        upper = 0x8F;
+    }
+    if (p[1] < lower || p[1] > upper) {
+        return 0;
+    }
+    for (size_t i = 2; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+extern bool c8valid(const char *c8, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        size_t len = c8check(c8 + i, n - i);
+        if (!len) {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#include <assert.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+extern void walk_init(struct walk *walk) {
+    walk->frames = walk->inline_frames;
+    walk->capacity = WALK_INLINE_DEPTH;
+    walk->depth = 0;
+}
+
+extern void walk_free(struct walk *walk) {
+    if (walk->frames != walk->inline_frames) {
+        json_free(walk->frames);
+    }
+    walk_init(walk);
+}
+
+extern bool walk_push(struct walk *walk, struct jsonValue *container) {
+    assert(container->kind == JVK_ARR || container->kind == JVK_OBJ);
+    if (walk->depth == walk->capacity) {
+        size_t new_capacity = walk->capacity * 2;
+        struct walkFrame *new_frames = json_realloc(walk->frames == walk->inline_frames ? NULL : walk->frames,
+                new_capacity * sizeof(struct walkFrame));
+        if (!new_frames) {
+            return false;
+        }
+        if (walk->frames == walk->inline_frames) {
+            memcpy(new_frames, walk->inline_frames, sizeof(walk->inline_frames));
+        }
+        walk->frames = new_frames;
+        walk->capacity = new_capacity;
+    }
+    walk->frames[walk->depth++] = (struct walkFrame) { container, 0, 0, 0 };
+    return true;
+}
+
+/* Members of objects come in table order with their keys. */
+extern struct jsonValue *walk_next(struct walk *walk, struct jsonString **key) {
+    assert(walk->depth);
+    struct walkFrame *frame = &walk->frames[walk->depth - 1];
+    struct jsonValue *container = frame->container;
+    if (container->kind == JVK_ARR) {
+        if (frame->next == container->v.array.size) {
+            return NULL;
+        }
+        ++frame->count;
+        *key = NULL;
+        return container->v.array.values[frame->next++];
+    }
+    while (frame->next < container->v.object.capacity) {
+        struct jsonObjectEntry *entry = &container->v.object.entries[frame->next++];
+        if (entry->key && entry->key != &key_deleted) {
+            ++frame->count;
+            *key = entry->key;
+            return entry->value;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,268 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "json_internal.h"
+
+// Size of the buffer that collects text before it's handed to a sink.
+#define WRITER_BUFFER_SIZE 4096
+// Nesting depth a writer handles without allocating.
+#define WRITER_INLINE_DEPTH 32
+
+// State of an open container, or of the top level at depth 0.
+#define FRAME_OBJECT    0x1 // object, otherwise array
+#define FRAME_EMPTY     0x2 // nothing was written into it yet
+#define FRAME_AFTER_KEY 0x4 // key was written, its value is expected
+
+struct jsonWriter {
+    struct printer printer;
+    bool validate;
+    bool failed;
+    size_t capacity;
+    unsigned char *frames;
+    unsigned char inline_frames[WRITER_INLINE_DEPTH];
+    char buffer[];
+};
+
+static struct jsonWriter *writer_create(size_t buffer_size, char *out, size_t size,
+        const struct jsonPrintOptions *options, bool validate) {
+    struct jsonWriter *writer = json_malloc(sizeof(struct jsonWriter) + buffer_size);
+    if (!writer) {
+        return NULL;
+    }
+    printer_init(&writer->printer, out ? out : writer->buffer, out ? size : buffer_size, options);
+    writer->validate = validate;
+    writer->failed = false;
+    writer->capacity = WRITER_INLINE_DEPTH;
+    writer->frames = writer->inline_frames;
+    writer->frames[0] = FRAME_EMPTY;
+    return writer;
+}
+
+extern struct jsonWriter *writer_create_mem(char *out, size_t size, const struct jsonPrintOptions *options,
+        bool validate) {
+    return writer_create(0, out, size, options, validate);
+}
+
+extern struct jsonWriter *writer_create_sink(bool (*sink)(void *, const char *, size_t), void *context,
+        const struct jsonPrintOptions *options, bool validate) {
+    struct jsonWriter *writer = writer_create(WRITER_BUFFER_SIZE, NULL, 0, options, validate);
+    if (writer) {
+        printer_set_sink(&writer->printer, sink, context);
+    }
+    return writer;
+}
+
+/* Misuse makes the writer unusable, so the text is never silently broken. */
+static bool writer_fail(struct jsonWriter *writer, const char *message) {
+    set_error(JSON_ERROR_WRITER, message);
+    writer->failed = true;
+    return false;
+}
+
+static bool writer_usable(struct jsonWriter *writer) {
+    if (writer->failed) {
+        set_error(JSON_ERROR_WRITER, "writer has already failed");
+        return false;
+    }
+    if (writer->printer.failed) {
+        return writer_fail(writer, "sink failed");
+    }
+    return true;
+}
+
+/* Writes whatever separates the value from the previous one. */
+static bool begin_value(struct jsonWriter *writer) {
+    if (!writer_usable(writer)) {
+        return false;
+    }
+    unsigned char *frame = &writer->frames[writer->printer.depth];
+    if (!writer->printer.depth) {
+        if (writer->validate && !(*frame & FRAME_EMPTY)) {
+            return writer_fail(writer, "only one top level value is allowed");
+        }
+    } else if (*frame & FRAME_OBJECT) {
+        if (writer->validate && !(*frame & FRAME_AFTER_KEY)) {
+            return writer_fail(writer, "value in object must follow a key");
+        }
+        *frame &= ~FRAME_AFTER_KEY;
+    } else {
+        if (!(*frame & FRAME_EMPTY)) {
+            print_char(&writer->printer, ',');
+        }
+        print_newline(&writer->printer);
+    }
+    *frame &= ~FRAME_EMPTY;
+    return true;
+}
+
+static bool begin_container(struct jsonWriter *writer, unsigned char kind, char bracket) {
+    if (!begin_value(writer)) {
+        return false;
+    }
+    size_t depth = writer->printer.depth + 1;
+    if (depth == writer->capacity) {
+        size_t capacity = writer->capacity * 2;
+        unsigned char *frames = writer->frames == writer->inline_frames ? NULL : writer->frames;
+        frames = json_realloc(frames, capacity);
+        if (!frames) {
+            writer->failed = true;
+            return false;
+        }
+        if (writer->frames == writer->inline_frames) {
+            memcpy(frames, writer->inline_frames, sizeof(writer->inline_frames));
+        }
+        writer->frames = frames;
+        writer->capacity = capacity;
+    }
+    writer->frames[depth] = kind | FRAME_EMPTY;
+    ++writer->printer.depth;
+    print_char(&writer->printer, bracket);
+    return true;
+}
+
+static bool end_container(struct jsonWriter *writer, unsigned char kind, char bracket) {
+    if (!writer_usable(writer)) {
+        return false;
+    }
+    if (!writer->printer.depth) {
+        return writer_fail(writer, "there is no open object or array");
+    }
+    unsigned char frame = writer->frames[writer->printer.depth];
+    if (writer->validate && (frame & FRAME_OBJECT) != kind) {
+        return writer_fail(writer, kind ? "innermost open value is not an object"
+                : "innermost open value is not an array");
+    }
+    if (writer->validate && (frame & FRAME_AFTER_KEY)) {
+        return writer_fail(writer, "key has no value");
+    }
+    --writer->printer.depth;
+    if (frame & FRAME_EMPTY) {
+        if (writer->printer.options.pretty) {
+            print_char(&writer->printer, ' ');
+        }
+    } else {
+        print_newline(&writer->printer);
+    }
+    print_char(&writer->printer, bracket);
+    return true;
+}
+
+extern bool writer_begin_object(struct jsonWriter *writer) {
+    return begin_container(writer, FRAME_OBJECT, '{');
+}
+
+extern bool writer_end_object(struct jsonWriter *writer) {
+    return end_container(writer, FRAME_OBJECT, '}');
+}
+
+extern bool writer_begin_array(struct jsonWriter *writer) {
+    return begin_container(writer, 0, '[');
+}
+
+extern bool writer_end_array(struct jsonWriter *writer) {
+    return end_container(writer, 0, ']');
+}
+
+extern bool writer_key(struct jsonWriter *writer, const char *key, size_t n) {
+    if (!writer_usable(writer)) {
+        return false;
+    }
+    unsigned char *frame = &writer->frames[writer->printer.depth];
+    if (writer->validate) {
+        if (!writer->printer.depth || !(*frame & FRAME_OBJECT)) {
+            return writer_fail(writer, "key outside of object");
+        }
+        if (*frame & FRAME_AFTER_KEY) {
+            return writer_fail(writer, "previous key has no value");
+        }
+        if (!c8valid(key, n)) {
+            return writer_fail(writer, "key is not valid UTF-8");
+        }
+    }
+    if (!(*frame & FRAME_EMPTY)) {
+        print_char(&writer->printer, ',');
+    }
+    print_newline(&writer->printer);
+    print_string(&writer->printer, key, n);
+    if (writer->printer.options.pretty) {
+        print_mem(&writer->printer, ": ", 2);
+    } else {
+        print_char(&writer->printer, ':');
+    }
+    *frame = (*frame & ~FRAME_EMPTY) | FRAME_AFTER_KEY;
+    return true;
+}
+
+extern bool writer_string(struct jsonWriter *writer, const char *data, size_t n) {
+    if (writer->validate && !writer->failed && !c8valid(data, n)) {
+        return writer_fail(writer, "string is not valid UTF-8");
+    }
+    if (!begin_value(writer)) {
+        return false;
+    }
+    print_string(&writer->printer, data, n);
+    return true;
+}
+
+extern bool writer_number(struct jsonWriter *writer, double number) {
+    if (writer->validate && !writer->failed && !isfinite(number)) {
+        return writer_fail(writer, "number is not finite");
+    }
+    if (!begin_value(writer)) {
+        return false;
+    }
+    print_number(&writer->printer, number);
+    return true;
+}
+
+extern bool writer_boolean(struct jsonWriter *writer, bool boolean) {
+    if (!begin_value(writer)) {
+        return false;
+    }
+    if (boolean) {
+        print_mem(&writer->printer, "true", 4);
+    } else {
+        print_mem(&writer->printer, "false", 5);
+    }
+    return true;
+}
+
+extern bool writer_null(struct jsonWriter *writer) {
+    if (!begin_value(writer)) {
+        return false;
+    }
+    print_mem(&writer->printer, "null", 4);
+    return true;
+}
+
+/* The tree is printed at the writer's depth so it lines up with the rest. */
+extern bool writer_value(struct jsonWriter *writer, struct jsonValue *value) {
+    if (!begin_value(writer)) {
+        return false;
+    }
+    if (!print_json_value(&writer->printer, value)) {
+        writer->failed = true;
+        return false;
+    }
+    return true;
+}
+
+extern size_t writer_finish(struct jsonWriter *writer) {
+    bool result = writer_usable(writer);
+    if (result && writer->validate && writer->printer.depth) {
+        result = writer_fail(writer, "object or array is not closed");
+    } else if (result && writer->validate && (writer->frames[0] & FRAME_EMPTY)) {
+        result = writer_fail(writer, "nothing was written");
+    }
+    size_t size = printer_finish(&writer->printer);
+    if (writer->printer.failed) {
+        set_error(JSON_ERROR_WRITER, "sink failed");
+        result = false;
+    }
+    if (writer->frames != writer->inline_frames) {
+        json_free(writer->frames);
+    }
+    json_free(writer);
+    return result ? size : 0;
+}
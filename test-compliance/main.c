@@ -83,6 +83,10 @@ int main(int argc, char *argv[]) {
             }
             break;
         }
+        if (!json != !json_validate(file_bytes, file_size, NULL, NULL)) {
+            printf(RED "VALIDATOR DISAGREES" RESET " '%s'\n", filename);
+            ok = false;
+        }
         if (json) {
             json_value_free(json);
         }
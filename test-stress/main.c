@@ -108,15 +108,95 @@ static char json_str_parsed_buffer[100 * 1024];
 #define GREEN "\x1B[32m"
 #define RESET "\x1B[0m"
 
+static unsigned char binary_buffer[100 * 1024];
+
+static bool binary_round_trip(struct jsonValue *json, size_t (*encode)(void *, size_t, struct jsonValue *),
+        struct jsonValue *(*decode)(const void *, size_t, bool), const char *format) {
+    size_t size = encode(binary_buffer, sizeof(binary_buffer), json);
+    struct jsonValue *decoded = decode(binary_buffer, size, true);
+    bool ok = size <= sizeof(binary_buffer) && json_are_equal(json, decoded, NULL, NULL);
+    if (!ok) {
+        printf(RED "STRESS TEST FAILED\n" RESET);
+        printf("%s round trip changed the value (%s)\n", format, json_strerror());
+    }
+    json_value_free(decoded);
+    return ok;
+}
+
+static _Alignas(8) unsigned char snapshot_buffer[200 * 1024];
+
+static bool snapshot_round_trip(struct jsonValue *json) {
+    size_t size = json_snapshot_encode(snapshot_buffer, sizeof(snapshot_buffer), json);
+    struct jsonSnapshot *snapshot = size <= sizeof(snapshot_buffer)
+        ? json_snapshot_open_mem(snapshot_buffer, size) : NULL;
+    struct jsonValue *copy = snapshot ? json_copy(json_snapshot_root(snapshot)) : NULL;
+    bool ok = copy && json_are_equal(json, copy, NULL, NULL);
+    if (!ok) {
+        printf(RED "STRESS TEST FAILED\n" RESET);
+        printf("snapshot round trip changed the value (%s)\n", json_strerror());
+    }
+    json_value_free(copy);
+    json_snapshot_close(snapshot);
+    return ok;
+}
+
+static bool compact_round_trip(struct jsonValue *json) {
+    struct jsonValue *copy = json_copy(json);
+    bool ok = copy && json_compact(copy) && json_are_equal(json, copy, NULL, NULL);
+    if (!ok) {
+        printf(RED "STRESS TEST FAILED\n" RESET);
+        printf("compaction changed the value (%s)\n", json_strerror());
+    }
+    json_value_free(copy);
+    return ok;
+}
+
+/* Selecting every value from the tree and from its text must agree. */
+static bool query_round_trip(struct jsonValue *json, const char *text) {
+    struct jsonQuery *query = json_query_compile("$..*");
+    struct jsonValue *matches = query ? json_query_parse(query, text, strlen(text), NULL) : NULL;
+    bool ok = matches && json_array_size(matches) == json_query_select(query, json, NULL, 0);
+    if (!ok) {
+        printf(RED "STRESS TEST FAILED\n" RESET);
+        printf("query selected different values from the text (%s)\n", json_strerror());
+    }
+    json_value_free(matches);
+    json_query_free(query);
+    return ok;
+}
+
+/* Sharing equal values must not change what's parsed. */
+static bool intern_round_trip(struct jsonValue *json, const char *text) {
+    struct jsonParseOptions options = { .share_equal_values = true };
+    struct jsonValue *parsed = json_parse_with(text, strlen(text), &options);
+    bool ok = parsed && json_are_equal(json, parsed, NULL, NULL) && json_hash(json) == json_hash(parsed);
+    if (!ok) {
+        printf(RED "STRESS TEST FAILED\n" RESET);
+        printf("sharing equal values changed the parsed value (%s)\n", json_strerror());
+    }
+    json_value_free(parsed);
+    return ok;
+}
+
 int main(int argc, char * argv[]) {
     struct jsonValue * json, * json_parsed;
     int i;
     (void) argc;
     (void) argv;
+    if (!json_init()) {
+        printf("json_init failed\n");
+        return EXIT_FAILURE;
+    }
     srand(42);
     for (i = 0; i < REPEATS; ++i) {
         json = generate_json(JSON_SIZE);
-        json_pretty_print(json_str_buffer, sizeof(json_str_buffer), json);
+        size_t printed = json_pretty_print(json_str_buffer, sizeof(json_str_buffer), json);
+        if (printed != json_serialized_size(json, NULL)) {
+            printf(RED "STRESS TEST FAILED\n" RESET);
+            printf("Attempt #%d\n", i);
+            printf("json_serialized_size differs from printed size %zu\n", printed);
+            return EXIT_FAILURE;
+        }
         json_parsed = json_parse(json_str_buffer, true);
         //! @todo Show path to the first different node
         if (!json_are_equal(json, json_parsed, NULL, NULL)) {
@@ -131,6 +211,15 @@ int main(int argc, char * argv[]) {
             return EXIT_FAILURE;
         }
         json_value_free(json_parsed);
+        if (!binary_round_trip(json, json_cbor_encode, json_cbor_decode, "CBOR")
+                || !binary_round_trip(json, json_msgpack_encode, json_msgpack_decode, "MessagePack")
+                || !snapshot_round_trip(json)
+                || !compact_round_trip(json)
+                || !query_round_trip(json, json_str_buffer)
+                || !intern_round_trip(json, json_str_buffer)) {
+            printf("Attempt #%d\n", i);
+            return EXIT_FAILURE;
+        }
         json_value_free(json);
 #ifndef RELEASE
         if (!dbg_is_memory_clear()) {
@@ -142,6 +231,7 @@ int main(int argc, char * argv[]) {
         }
 #endif
     }
+    json_exit();
     printf(GREEN "STRESS TEST PASSED\n" RESET);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,61 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <json.h>
+
+struct counters {
+    size_t allocations;
+    size_t releases;
+};
+
+static void *counting_allocate(void *context, size_t size) {
+    ++((struct counters *) context)->allocations;
+    return malloc(size);
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size) {
+    if (!ptr) {
+        ++((struct counters *) context)->allocations;
+    }
+    return realloc(ptr, size);
+}
+
+static void counting_release(void *context, void *ptr) {
+    if (ptr) {
+        ++((struct counters *) context)->releases;
+    }
+    free(ptr);
+}
+
+static void *failing_allocate(void *context, size_t size) {
+    (void) context;
+    (void) size;
+    return NULL;
+}
+
+static void *failing_reallocate(void *context, void *ptr, size_t size) {
+    (void) context;
+    (void) ptr;
+    (void) size;
+    return NULL;
+}
+
+extern bool test_allocator(void) {
+    struct counters counters = { 0, 0 };
+    struct jsonAllocator counting = { counting_allocate, counting_reallocate, counting_release, &counters };
+    struct jsonAllocator failing = { failing_allocate, failing_reallocate, counting_release, &counters };
+    struct jsonAllocator incomplete = { counting_allocate, NULL, counting_release, &counters };
+    // Allocator may only be replaced while the library holds no memory.
+    json_exit();
+    bool ok = !json_set_allocator(&incomplete) && json_set_allocator(&counting) && json_init();
+    struct jsonValue *value = json_parse("{\"a\": [1, 2, \"three\"]}", true);
+    ok = ok && value && counters.allocations;
+    json_value_free(value);
+    json_exit();
+    ok = ok && counters.allocations == counters.releases;
+    ok = ok && json_set_allocator(&failing) && json_init() && !json_create_array(4);
+    json_exit();
+    ok = json_set_allocator(NULL) && json_init() && ok;
+    return ok;
+}
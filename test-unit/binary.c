@@ -0,0 +1,41 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <json.h>
+
+static bool encodes_as(const char *json, size_t (*encode)(void *, size_t, struct jsonValue *),
+        const unsigned char *expected, size_t expected_size) {
+    unsigned char buffer[64];
+    struct jsonValue *value = json_parse(json, true);
+    size_t size = encode(buffer, sizeof(buffer), value);
+    json_value_free(value);
+    return size == expected_size && !memcmp(buffer, expected, size);
+}
+
+static bool decodes_as(const unsigned char *bytes, size_t size, struct jsonValue *(*decode)(const void *, size_t, bool),
+        const char *json) {
+    struct jsonValue *decoded = decode(bytes, size, true);
+    struct jsonValue *expected = json_parse(json, true);
+    bool ok = decoded && json_are_equal(decoded, expected, NULL, NULL);
+    json_value_free(decoded);
+    json_value_free(expected);
+    return ok;
+}
+
+extern bool test_binary(void) {
+    static const unsigned char cbor[] = { 0x82, 0x18, 0x64, 0xA1, 0x61, 'a', 0x39, 0x01, 0xF3 };
+    static const unsigned char cbor_float[] = { 0xFA, 0x3F, 0xC0, 0x00, 0x00 };
+    static const unsigned char cbor_indefinite[] = {
+        0x9F, 0x7F, 0x62, 'a', 'b', 0x61, 'c', 0xFF, 0xF9, 0x3C, 0x00, 0xF6, 0xFF
+    };
+    static const unsigned char msgpack[] = { 0x92, 0x64, 0x81, 0xA1, 'a', 0xD1, 0xFE, 0x0C };
+    static const unsigned char msgpack_hostile[] = { 0xDD, 0xFF, 0xFF, 0xFF, 0xFF, 0xC0 };
+    return encodes_as("[100, {\"a\": -500}]", json_cbor_encode, cbor, sizeof(cbor))
+        && encodes_as("1.5", json_cbor_encode, cbor_float, sizeof(cbor_float))
+        && decodes_as(cbor, sizeof(cbor), json_cbor_decode, "[100, {\"a\": -500}]")
+        && decodes_as(cbor_indefinite, sizeof(cbor_indefinite), json_cbor_decode, "[\"abc\", 1, null]")
+        && encodes_as("[100, {\"a\": -500}]", json_msgpack_encode, msgpack, sizeof(msgpack))
+        && decodes_as(msgpack, sizeof(msgpack), json_msgpack_decode, "[100, {\"a\": -500}]")
+        && !json_msgpack_decode(msgpack_hostile, sizeof(msgpack_hostile), true);
+}
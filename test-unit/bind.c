@@ -0,0 +1,170 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+struct point {
+    double x;
+    double y;
+};
+
+struct shape {
+    char *name;
+    long long id;
+    bool visible;
+    struct point center;
+    struct jsonBoundArray points;
+    struct jsonBoundArray tags;
+};
+
+static const struct jsonField point_fields[] = {
+    { "x", offsetof(struct point, x), JSON_FIELD_DOUBLE, 0, NULL },
+    { "y", offsetof(struct point, y), JSON_FIELD_DOUBLE, 0, NULL },
+};
+
+static const struct jsonSchema point = { sizeof(struct point), point_fields, 2 };
+
+static const struct jsonField shape_fields[] = {
+    { "name", offsetof(struct shape, name), JSON_FIELD_STRING, 0, NULL },
+    { "id", offsetof(struct shape, id), JSON_FIELD_INT, 0, NULL },
+    { "visible", offsetof(struct shape, visible), JSON_FIELD_BOOL, 0, NULL },
+    { "center", offsetof(struct shape, center), JSON_FIELD_STRUCT, 0, &point },
+    { "points", offsetof(struct shape, points), JSON_FIELD_ARRAY, JSON_FIELD_STRUCT, &point },
+    { "tags", offsetof(struct shape, tags), JSON_FIELD_ARRAY, JSON_FIELD_STRING, NULL },
+};
+
+static const struct jsonSchema shape = { sizeof(struct shape), shape_fields, 6 };
+
+static bool bind(struct jsonBinder *binder, const char *text, void *out) {
+    return json_bind(binder, text, strlen(text), out, NULL);
+}
+
+static bool test_fields(void) {
+    struct jsonBinder *binder = json_binder_compile(&shape);
+    struct shape s;
+    const char *text = "{\"name\": \"tri\\u0061ngle\", \"id\": -9007199254740993, \"visible\": true, \"extra\": "
+        "{\"a\": [1, \"x\"]}, \"center\": {\"y\": 2.5, \"x\": -1e2, \"z\": null}, \"points\": [{\"x\": 1}, "
+        "{\"y\": 2}, null], \"tags\": [\"a\", \"b\"]}";
+    bool ok = binder && bind(binder, text, &s);
+    ok = ok && !strcmp(s.name, "triangle") && s.id == -9007199254740993LL && s.visible;
+    ok = ok && s.center.x == -100 && s.center.y == 2.5;
+    const struct point *points = s.points.items;
+    ok = ok && s.points.size == 3 && points[0].x == 1 && points[0].y == 0 && points[1].y == 2 && points[2].x == 0;
+    const char *const *tags = s.tags.items;
+    ok = ok && s.tags.size == 2 && !strcmp(tags[0], "a") && !strcmp(tags[1], "b");
+    json_bind_free(binder, &s);
+    ok = ok && !s.name && !s.points.items && !s.tags.size;
+    // Missing and null members are left zero, the last of repeated keys counts.
+    const char *repeated = "{\"name\": \"a\", \"points\": [{}], \"name\": \"b\", \"center\": null, \"points\": []}";
+    ok = ok && bind(binder, repeated, &s)
+        && !strcmp(s.name, "b") && !s.id && !s.visible && !s.center.x && !s.points.size && !s.tags.items;
+    json_bind_free(binder, &s);
+    ok = ok && bind(binder, "{}", &s) && !s.name;
+    json_binder_free(binder);
+    return ok;
+}
+
+struct node {
+    long long value;
+    struct jsonBoundArray children;
+};
+
+static const struct jsonSchema node;
+
+static const struct jsonField node_fields[] = {
+    { "value", offsetof(struct node, value), JSON_FIELD_INT, 0, NULL },
+    { "children", offsetof(struct node, children), JSON_FIELD_ARRAY, JSON_FIELD_STRUCT, &node },
+};
+
+static const struct jsonSchema node = { sizeof(struct node), node_fields, 2 };
+
+static bool test_recursive(void) {
+    struct jsonBinder *binder = json_binder_compile(&node);
+    struct node tree;
+    bool ok = binder && bind(binder, "{\"value\": 1, \"children\": [{\"value\": 2}, {\"children\": [{\"value\": 3}]}]}",
+            &tree);
+    const struct node *children = tree.children.items;
+    ok = ok && tree.value == 1 && tree.children.size == 2 && children[0].value == 2 && children[1].children.size == 1
+        && ((const struct node *) children[1].children.items)[0].value == 3;
+    json_bind_free(binder, &tree);
+    struct jsonParseOptions options = { .max_depth = 3 };
+    const char *deep = "{\"children\": [{\"children\": []}]}";
+    ok = ok && !json_bind(binder, deep, strlen(deep), &tree, &options) && json_last_error()->code == JSON_ERROR_LIMIT
+        && !tree.children.items;
+    // Binding recurses, so a higher limit in the options doesn't go past the fixed one.
+    size_t levels = JSON_BIND_MAX_DEPTH / 2 + 1;
+    char *deeper = malloc(levels * 16 + 3);
+    if (deeper) {
+        char *p = deeper;
+        for (size_t i = 0; i < levels; ++i) {
+            p += sprintf(p, "{\"children\": [");
+        }
+        p += sprintf(p, "{}");
+        for (size_t i = 0; i < levels; ++i) {
+            p += sprintf(p, "]}");
+        }
+    }
+    options.max_depth = 1000000;
+    ok = ok && deeper && !json_bind(binder, deeper, strlen(deeper), &tree, &options)
+        && json_last_error()->code == JSON_ERROR_LIMIT;
+    free(deeper);
+    json_binder_free(binder);
+    return ok;
+}
+
+static bool test_mismatches(void) {
+    static const char *bad[] = {
+        "[]", "{\"name\": 1}", "{\"id\": 1.5}", "{\"id\": 1e2}", "{\"id\": 9223372036854775808}", "{\"id\": \"1\"}",
+        "{\"visible\": 0}", "{\"center\": []}", "{\"points\": {}}", "{\"points\": [1]}", "{\"tags\": [\"a\", 1]}",
+    };
+    struct jsonBinder *binder = json_binder_compile(&shape);
+    struct shape s;
+    bool ok = binder;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !bind(binder, bad[i], &s) && json_last_error()->code == JSON_ERROR_SCHEMA && !s.tags.items;
+    }
+    ok = ok && !bind(binder, "{\"name\": \"a\", \"id\": 7, \"center\": {\"x\": \"1\"}}", &s)
+        && json_last_error()->code == JSON_ERROR_SCHEMA && json_last_error()->column == 40 && !s.name;
+    static const char *invalid[] = {
+        "{\"name\": \"a\", \"id\": 1,}", "{\"extra\": [1,], \"id\": 1}", "{\"tags\": [\"a\" \"b\"]}", "{\"id\": 1} x",
+        "{\"visible\": tru}",
+    };
+    for (size_t i = 0; ok && i < sizeof(invalid) / sizeof(*invalid); ++i) {
+        ok = !bind(binder, invalid[i], &s) && json_last_error()->code == JSON_ERROR_SYNTAX && !s.name;
+    }
+    json_binder_free(binder);
+    return ok;
+}
+
+static bool test_schemas(void) {
+    static const struct jsonField twice[] = {
+        { "x", 0, JSON_FIELD_DOUBLE, 0, NULL },
+        { "x", 0, JSON_FIELD_DOUBLE, 0, NULL },
+    };
+    static const struct jsonField no_schema[] = { { "p", 0, JSON_FIELD_STRUCT, 0, NULL } };
+    static const struct jsonField too_big[] = { { "p", 8, JSON_FIELD_DOUBLE, 0, NULL } };
+    static const struct jsonField nested_arrays[] = { { "p", 0, JSON_FIELD_ARRAY, JSON_FIELD_ARRAY, NULL } };
+    const struct jsonSchema bad[] = {
+        { sizeof(double), twice, 2 },
+        { sizeof(struct point), no_schema, 1 },
+        { 12, too_big, 1 },
+        { sizeof(struct jsonBoundArray), nested_arrays, 1 },
+    };
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !json_binder_compile(&bad[i]) && json_last_error()->code == JSON_ERROR_ARGUMENT;
+    }
+    const struct jsonSchema nothing = { 1, NULL, 0 };
+    struct jsonBinder *binder = json_binder_compile(&nothing);
+    char c = 'x';
+    ok = ok && binder && bind(binder, "{\"a\": 1}", &c) && !c;
+    json_binder_free(binder);
+    return ok;
+}
+
+extern bool test_bind(void) {
+    return test_fields() && test_recursive() && test_mismatches() && test_schemas();
+}
@@ -0,0 +1,65 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <json.h>
+
+#define TEXT_SIZE 256
+
+static bool same_text(struct jsonValue *value, const char *expected) {
+    char text[TEXT_SIZE];
+    struct jsonPrintOptions options = { .sort_keys = true };
+    size_t n = json_print(text, TEXT_SIZE, value, &options);
+    return n && n < TEXT_SIZE && !strcmp(text, expected);
+}
+
+static bool test_trim(void) {
+    const char *text = "{\"a\":[1,2,3],\"b\":{\"c\":\"d\"},\"e\":\"text\"}";
+    struct jsonValue *root = json_create_object(16);
+    struct jsonValue *array = json_create_array(100);
+    struct jsonValue *object = json_create_object(50);
+    bool ok = root && array && object;
+    for (int i = 1; ok && i <= 3; ++i) {
+        ok = json_array_append(array, json_create_number(i));
+    }
+    ok = ok && json_object_add(object, "c", json_create_string("d"));
+    ok = ok && json_object_add(root, "a", array) && json_object_add(root, "b", object);
+    ok = ok && json_object_add(root, "e", json_create_string("text"));
+    struct jsonMemoryUsage before, after;
+    ok = ok && json_memory_usage(root, &before) && json_compact(root) && json_memory_usage(root, &after);
+    ok = ok && same_text(root, text);
+    ok = ok && before.nodes == after.nodes && before.keys == after.keys;
+    ok = ok && !after.array_unused_bytes && !after.string_unused_bytes && after.total_bytes < before.total_bytes;
+    // Elements of the array come right after it.
+    array = json_object_lookup(root, "a");
+    uintptr_t first = (uintptr_t) json_array_at(array, 0);
+    uintptr_t step = (uintptr_t) json_array_at(array, 1) - first;
+    ok = ok && first - (uintptr_t) array == step && (uintptr_t) json_array_at(array, 2) - first == 2 * step;
+    json_value_free(root);
+    return ok;
+}
+
+static bool test_duplicates(void) {
+    struct jsonValue *value = json_parse("{\"k\": 1, \"x\": [], \"k\": 2, \"k\": 3}", true);
+    bool ok = value && json_compact(value);
+    double numbers[3] = { 0 };
+    struct jsonValue *k = json_object_lookup(value, "k");
+    for (int i = 0; ok && i < 3; ++i, k = json_object_lookup_next(value, "k", k)) {
+        ok = json_get_number(k, &numbers[i]);
+    }
+    ok = ok && numbers[0] == 3 && numbers[1] == 2 && numbers[2] == 1 && !k;
+    ok = ok && json_array_size(json_object_lookup(value, "x")) == 0;
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_scalar(void) {
+    struct jsonValue *value = json_create_string("");
+    bool ok = value && json_compact(value) && same_text(value, "\"\"") && !json_compact(NULL);
+    json_value_free(value);
+    return ok;
+}
+
+extern bool test_compact(void) {
+    return test_trim() && test_duplicates() && test_scalar();
+}
@@ -0,0 +1,135 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#define TEXT_SIZE 256
+#define DEPTH     5000
+
+static const char *text = "{\"a\":[1,\"two\",{\"b\":null}],\"c\":true,\"d\":\"\",\"e\":[],\"f\":{}}";
+
+static bool same_text(struct jsonValue *value, const char *expected) {
+    char buffer[TEXT_SIZE];
+    struct jsonPrintOptions options = { .sort_keys = true };
+    size_t n = json_print(buffer, TEXT_SIZE, value, &options);
+    return n && n < TEXT_SIZE && !strcmp(buffer, expected);
+}
+
+static bool test_structure(void) {
+    struct jsonValue *value = json_parse(text, true);
+    struct jsonValue *copy = json_copy(value);
+    bool ok = copy && copy != value && same_text(copy, text);
+    ok = ok && json_object_capacity(copy) == json_object_capacity(value);
+    ok = ok && json_object_lookup(copy, "a") != json_object_lookup(value, "a");
+    // Copy is independent of the original.
+    ok = ok && json_set_string(json_array_at(json_object_lookup(copy, "a"), 1), "2") && same_text(value, text);
+    json_value_free(copy);
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_duplicates(void) {
+    struct jsonValue *value = json_parse("{\"k\": 1, \"k\": 2}", true);
+    struct jsonValue *copy = json_copy(value);
+    double first = 0, second = 0;
+    struct jsonValue *k = json_object_lookup(copy, "k");
+    bool ok = json_get_number(k, &first) && json_get_number(json_object_lookup_next(copy, "k", k), &second);
+    ok = ok && first == 2 && second == 1 && json_object_number_of_keys(copy) == 1;
+    json_value_free(copy);
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_deep(void) {
+    struct jsonValue *value = json_create_array(1);
+    struct jsonValue *last = value;
+    for (int i = 0; last && i < DEPTH; ++i) {
+        struct jsonValue *next = json_create_array(1);
+        last = json_array_append(last, next) ? next : NULL;
+    }
+    struct jsonValue *copy = last ? json_copy(value) : NULL;
+    bool ok = copy != NULL;
+    last = copy;
+    for (int i = 0; ok && i < DEPTH; ++i) {
+        last = json_array_at(last, 0);
+        ok = last && json_array_size(last) == (i + 1 < DEPTH);
+    }
+    json_value_free(copy);
+    json_value_free(value);
+    return ok;
+}
+
+struct budget {
+    size_t left;
+    size_t allocations;
+    size_t releases;
+};
+
+static void *limited_allocate(void *context, size_t size) {
+    struct budget *budget = context;
+    if (!budget->left) {
+        return NULL;
+    }
+    --budget->left;
+    ++budget->allocations;
+    return malloc(size);
+}
+
+static void *limited_reallocate(void *context, void *ptr, size_t size) {
+    if (!ptr) {
+        return limited_allocate(context, size);
+    }
+    return realloc(ptr, size);
+}
+
+static void limited_release(void *context, void *ptr) {
+    if (ptr) {
+        ++((struct budget *) context)->releases;
+    }
+    free(ptr);
+}
+
+/* Copy fails at every allocation in turn and must clean up after itself,
+ * leaving the original as it was. */
+static bool copy_under_budget(struct budget *budget, const char *json) {
+    budget->left = (size_t) -1;
+    struct jsonValue *value = json_parse(json, true);
+    struct jsonValue *expected = json_parse(json, true);
+    struct jsonValue *copy = NULL;
+    bool ok = value && expected;
+    for (size_t n = 0; ok && !copy; ++n) {
+        budget->left = n;
+        copy = json_copy(value);
+        budget->left = (size_t) -1;
+        ok = n < 100 && json_are_equal(value, expected, NULL, NULL);
+    }
+    ok = ok && json_are_equal(copy, expected, NULL, NULL);
+    json_value_free(copy);
+    json_value_free(value);
+    json_value_free(expected);
+    return ok;
+}
+
+static bool test_out_of_memory(void) {
+    struct budget budget = { (size_t) -1, 0, 0 };
+    struct jsonAllocator limited = { limited_allocate, limited_reallocate, limited_release, &budget };
+    // More children than fit on the stack of json_copy() before it grows.
+    char wide[TEXT_SIZE * 2] = "{\"a\": [0";
+    for (int i = 1; i < 100; ++i) {
+        snprintf(wide + strlen(wide), sizeof(wide) - strlen(wide), ",%d", i);
+    }
+    strcat(wide, "]}");
+    json_exit();
+    bool ok = json_set_allocator(&limited) && json_init();
+    ok = ok && copy_under_budget(&budget, text) && copy_under_budget(&budget, wide);
+    json_exit();
+    ok = ok && budget.allocations == budget.releases;
+    ok = json_set_allocator(NULL) && json_init() && ok;
+    return ok;
+}
+
+extern bool test_copy(void) {
+    return test_structure() && test_duplicates() && test_deep() && test_out_of_memory();
+}
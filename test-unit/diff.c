@@ -0,0 +1,106 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#define TEXT_SIZE 512
+
+static const struct jsonPrintOptions compact = { .sort_keys = true };
+
+static bool same_text(struct jsonValue *left, struct jsonValue *right) {
+    char left_text[TEXT_SIZE];
+    char right_text[TEXT_SIZE];
+    size_t n = json_print(left_text, TEXT_SIZE, left, &compact);
+    size_t m = json_print(right_text, TEXT_SIZE, right, &compact);
+    return n && n < TEXT_SIZE && m && m < TEXT_SIZE && !strcmp(left_text, right_text);
+}
+
+/* Diffs two documents, applies the patch to the first one and compares the
+ * result with the second one. The patch must have n operations, unless n is
+ * SIZE_MAX, and be the expected one if that's given. */
+static bool check(const char *from, const char *to, size_t n, const char *expected) {
+    struct jsonValue *left = json_parse(from, true);
+    struct jsonValue *right = json_parse(to, true);
+    struct jsonValue *changes = left && right ? json_diff(left, right) : NULL;
+    struct jsonValue *wanted = expected ? json_parse(expected, true) : NULL;
+    bool ok = changes && (n == SIZE_MAX || json_array_size(changes) == n) && (!expected || same_text(changes, wanted));
+    ok = ok && json_patch_apply(left, changes) && same_text(left, right);
+    json_value_free(left);
+    json_value_free(right);
+    json_value_free(changes);
+    json_value_free(wanted);
+    return ok;
+}
+
+static bool test_scalars(void) {
+    return check("1", "1", 0, "[]")
+        && check("1", "2", 1, "[{\"op\": \"replace\", \"path\": \"\", \"value\": 2}]")
+        && check("\"a\"", "[\"a\"]", 1, NULL)
+        && check("{}", "[]", 1, NULL)
+        && check("-0", "0", 0, NULL)
+        && check("null", "false", 1, NULL);
+}
+
+static bool test_objects(void) {
+    return check("{\"a\": 1, \"b\": {\"c\": [1, 2]}}", "{\"a\": 1, \"b\": {\"c\": [1, 2]}}", 0, NULL)
+        && check("{\"a\": 1, \"b\": 2}", "{\"b\": 3, \"c\": 4}", 3, NULL)
+        && check("{\"a\": {\"b\": {\"c\": 1, \"d\": 2}}}", "{\"a\": {\"b\": {\"c\": 1, \"d\": 3}}}", 1,
+                "[{\"op\": \"replace\", \"path\": \"/a/b/d\", \"value\": 3}]")
+        && check("{\"a/b\": 1, \"m~n\": 2}", "{\"a/b\": 2}", 2, NULL)
+        && check("{}", "{\"x\": {\"y\": [1]}}", 1, "[{\"op\": \"add\", \"path\": \"/x\", \"value\": {\"y\": [1]}}]")
+        // A repeated key is removed with all of its values.
+        && check("{\"a\": 1, \"a\": 2, \"b\": 3}", "{\"b\": 3}", 2, NULL);
+}
+
+static bool test_arrays(void) {
+    return check("[1, 2, 3]", "[1, 9, 2, 3]", 1, "[{\"op\": \"add\", \"path\": \"/1\", \"value\": 9}]")
+        && check("[1, 2, 3, 4]", "[1, 3, 4]", 1, "[{\"op\": \"remove\", \"path\": \"/1\"}]")
+        && check("[1, 2, 3]", "[1, 5, 3]", 1, "[{\"op\": \"replace\", \"path\": \"/1\", \"value\": 5}]")
+        && check("[{\"id\": 1}, {\"id\": 2}, {\"id\": 3}]", "[{\"id\": 1}, {\"id\": 3}, {\"id\": 4}]", 2, NULL)
+        && check("[1, 2, 3, 4, 5, 6]", "[0, 2, 3, 7, 5, 6, 8]", 3, NULL)
+        && check("[1, 2, 3]", "[3, 2, 1]", SIZE_MAX, NULL)
+        && check("[]", "[1, 2]", 2, NULL)
+        && check("[1, 2]", "[]", 2, NULL)
+        && check("[[1, 2], [3, 4]]", "[[1, 2], [3, 5]]", 1,
+                "[{\"op\": \"replace\", \"path\": \"/1/1\", \"value\": 5}]");
+}
+
+static bool test_large(void) {
+    // Too long to be matched, elements are diffed in place.
+    size_t n = 1500;
+    struct jsonValue *left = json_create_array(n);
+    struct jsonValue *right = json_create_array(n);
+    bool ok = left && right;
+    for (size_t i = 0; ok && i < n; ++i) {
+        ok = json_array_append(left, json_create_number((double) i))
+            && json_array_append(right, json_create_number((double) (i == 0 || i == n - 1 ? i : i + 1)));
+    }
+    struct jsonValue *changes = ok ? json_diff(left, right) : NULL;
+    ok = changes && json_array_size(changes) == n - 2 && json_patch_apply(left, changes)
+        && json_are_equal(left, right, NULL, NULL);
+    json_value_free(changes);
+    json_value_free(left);
+    json_value_free(right);
+    return ok;
+}
+
+static bool test_equal(void) {
+    struct jsonValue *left = json_parse("{\"a\": \"x\", \"a\": \"y\", \"b\": [3]}", true);
+    struct jsonValue *same = json_parse("{\"b\": [3], \"a\": \"y\", \"a\": \"x\"}", true);
+    struct jsonValue *other = json_parse("{\"a\": \"x\", \"a\": \"x\", \"b\": [3]}", true);
+    struct jsonValue *left_diff = NULL;
+    struct jsonValue *right_diff = NULL;
+    bool ok = left && same && other && json_are_equal(left, same, NULL, NULL)
+        && !json_are_equal(left, other, &left_diff, &right_diff) && left_diff && !right_diff;
+    json_value_free(left);
+    json_value_free(same);
+    json_value_free(other);
+    return ok;
+}
+
+extern bool test_diff(void) {
+    return test_scalars() && test_objects() && test_arrays() && test_large() && test_equal();
+}
@@ -0,0 +1,69 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+static bool test_positions(void) {
+    bool ok = !json_parse("{\n  \"a\": [1, 2,]\n}", true);
+    const struct jsonError *error = json_last_error();
+    ok = ok && error->code == JSON_ERROR_SYNTAX && error->line == 2 && error->column == 14 && error->offset == 15;
+    ok = ok && !strcmp(error->message, "json value was expected");
+    ok = ok && !strcmp(json_strerror(), "at 2:14 json value was expected");
+    // Binary input has offsets only.
+    const unsigned char cbor[] = { 0x82, 0x01 };
+    ok = ok && !json_cbor_decode(cbor, sizeof(cbor), true) && json_last_error()->code == JSON_ERROR_SYNTAX;
+    ok = ok && !json_last_error()->line && !strcmp(json_strerror(), "unexpected end of input at byte 2");
+    ok = ok && !json_array_size(NULL) && json_last_error()->code == JSON_ERROR_ARGUMENT;
+    ok = ok && !strcmp(json_strerror(), "array == NULL");
+    struct jsonValue *value = json_parse("[]", true);
+    ok = ok && value && json_last_error()->code == JSON_ERROR_NONE && !strcmp(json_strerror(), "");
+    json_value_free(value);
+    return ok;
+}
+
+static size_t allocations;
+
+static void *counting_allocate(void *context, size_t size) {
+    (void) context;
+    ++allocations;
+    return malloc(size);
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size) {
+    (void) context;
+    allocations += !ptr;
+    return realloc(ptr, size);
+}
+
+static void counting_release(void *context, void *ptr) {
+    (void) context;
+    free(ptr);
+}
+
+/* Rejecting invalid input doesn't touch the allocator once the node pool is
+ * warm. Validating doesn't touch it at all. */
+static bool test_no_allocation(void) {
+    static const char *bad[] = { "", "x", "}", "tru", "nul", "-", "1e", "[", "{", "[,", "{1" };
+    struct jsonAllocator counting = { counting_allocate, counting_reallocate, counting_release, NULL };
+    json_exit();
+    bool ok = json_set_allocator(&counting) && json_init();
+    json_value_free(json_parse("{\"a\": [1, 2]}", true));
+    size_t before = allocations;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !json_parse(bad[i], true) && json_last_error()->code == JSON_ERROR_SYNTAX && *json_strerror();
+    }
+    const char *valid = "{\"a\": [1.5, \"\\ud83d\\ude00\", {\"b\": null}], \"c\": true}";
+    ok = ok && json_validate(valid, strlen(valid), NULL, NULL);
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !json_validate(bad[i], strlen(bad[i]), NULL, NULL) && json_last_error()->code == JSON_ERROR_SYNTAX;
+    }
+    ok = ok && allocations == before;
+    json_exit();
+    ok = json_set_allocator(NULL) && json_init() && ok;
+    return ok;
+}
+
+extern bool test_error(void) {
+    return test_positions() && test_no_allocation();
+}
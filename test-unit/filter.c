@@ -0,0 +1,70 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+/* Checks that filtering the text gives what parsing the expected text does. */
+static bool check(const char *text, const char *const *keys, size_t n, const char *expected) {
+    struct jsonValue *filtered = json_parse_filtered(text, strlen(text), keys, n, NULL);
+    struct jsonValue *value = json_parse(expected, true);
+    bool ok = filtered && value && json_are_equal(filtered, value, NULL, NULL);
+    json_value_free(filtered);
+    json_value_free(value);
+    return ok;
+}
+
+#define CHECK(text, expected, ...) \
+    check(text, (const char *[]) { __VA_ARGS__ }, sizeof((const char *[]) { __VA_ARGS__ }) / sizeof(const char *), \
+            expected)
+
+static const char user[] = "{\"id\": 7, \"name\": \"Ann\", \"tags\": [\"a\", \"b\\u0063\"],"
+    " \"address\": {\"city\": \"Oslo\", \"zip\": \"0150\", \"lines\": [\"x\", {\"y\": 1}]}, \"a/b\": true}";
+
+static bool test_keys(void) {
+    return CHECK(user, "{\"id\": 7}", "/id")
+        && CHECK(user, "{\"id\": 7, \"tags\": [\"a\", \"bc\"]}", "/tags", "/id")
+        && CHECK(user, "{\"address\": {\"city\": \"Oslo\"}}", "/address/city")
+        && CHECK(user, "{\"address\": {\"city\": \"Oslo\", \"zip\": \"0150\"}}", "/address/city", "/address/zip")
+        && CHECK(user, "{\"address\": {\"city\": \"Oslo\", \"zip\": \"0150\", \"lines\": [\"x\", {\"y\": 1}]}}",
+                "/address/city", "/address")
+        && CHECK(user, "{\"a/b\": true}", "/a~1b")
+        && CHECK(user, "{\"address\": {}}", "/missing", "/address/missing/deeper")
+        && CHECK(user, "{\"id\": 7}", "/id/x", "/id")
+        && CHECK(user, "{\"id\": 7}", "/id/x")
+        && check(user, NULL, 0, "{}")
+        && CHECK("[1, 2]", "[1, 2]", "")
+        && CHECK("\"x\"", "\"x\"", "/x");
+}
+
+static bool test_arrays(void) {
+    const char *text = "[{\"id\": 1, \"x\": [1, 2]}, 5, [{\"id\": 2, \"x\": {}}], {\"x\": null}]";
+    return CHECK(text, "[{\"id\": 1}, 5, [{\"id\": 2}], {}]", "/id")
+        && CHECK("{\"a\": [{\"b\": 1, \"c\": 2}], \"d\": 3}", "{\"a\": [{\"c\": 2}]}", "/a/c")
+        && CHECK("{\"a\": 1, \"a\": 2, \"b\": 3}", "{\"a\": 1, \"a\": 2}", "/a");
+}
+
+static bool test_invalid(void) {
+    static const char *bad[] = {
+        "{\"id\": 1, \"x\": [}", "{\"x\": tru, \"id\": 1}", "{\"id\": 1} x", "{\"id\": 1", "{\"id\": 1,}", "[1,]",
+        "{\"x\": \"\\q\"}",
+    };
+    const char *keys[] = { "/id" };
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !json_parse_filtered(bad[i], strlen(bad[i]), keys, 1, NULL)
+            && json_last_error()->code == JSON_ERROR_SYNTAX;
+    }
+    const char *deep = "{\"x\": [[1]], \"id\": 1}";
+    struct jsonParseOptions options = { .max_depth = 2 };
+    ok = ok && !json_parse_filtered(deep, strlen(deep), keys, 1, &options)
+        && json_last_error()->code == JSON_ERROR_LIMIT;
+    const char *not_pointer[] = { "id" };
+    ok = ok && !json_parse_filtered("{}", 2, not_pointer, 1, NULL) && json_last_error()->code == JSON_ERROR_SYNTAX;
+    ok = ok && !json_parse_filtered("{}", 2, NULL, 1, NULL) && json_last_error()->code == JSON_ERROR_ARGUMENT;
+    return ok;
+}
+
+extern bool test_filter(void) {
+    return test_keys() && test_arrays() && test_invalid();
+}
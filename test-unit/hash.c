@@ -0,0 +1,84 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include <json.h>
+
+static const char *config = "{\"name\": \"base\", \"limits\": {\"cpu\": 1, \"memory\": 2}, \"tags\": [\"a\", \"b\"]}";
+
+static bool same_hash(const char *left, const char *right) {
+    struct jsonValue *left_value = json_parse(left, true);
+    struct jsonValue *right_value = json_parse(right, true);
+    bool ok = left_value && right_value && json_hash(left_value) == json_hash(right_value)
+        && json_are_equal(left_value, right_value, NULL, NULL);
+    json_value_free(left_value);
+    json_value_free(right_value);
+    return ok;
+}
+
+static bool different(const char *left, const char *right) {
+    struct jsonValue *left_value = json_parse(left, true);
+    struct jsonValue *right_value = json_parse(right, true);
+    bool ok = left_value && right_value && json_hash(left_value) != json_hash(right_value)
+        && !json_are_equal(left_value, right_value, NULL, NULL);
+    json_value_free(left_value);
+    json_value_free(right_value);
+    return ok;
+}
+
+static bool test_structure(void) {
+    return same_hash("{\"a\": 1, \"b\": [1, 2]}", "{\"b\": [1, 2], \"a\": 1}")
+        && same_hash("{\"a\": 1, \"a\": 2}", "{\"a\": 2, \"a\": 1}")
+        && same_hash("[-0, \"x\", null]", "[0, \"x\", null]")
+        && different("1", "2")
+        && different("[1, 2]", "[2, 1]")
+        && different("{\"a\": 1}", "{\"b\": 1}")
+        && different("{\"a\": 1, \"b\": 2}", "{\"a\": 2, \"b\": 1}")
+        && different("\"1\"", "1")
+        && different("true", "1")
+        && different("[]", "{}")
+        && different("[[]]", "[]");
+}
+
+static bool test_kept(void) {
+    struct jsonValue *original = json_parse(config, true);
+    struct jsonValue *copy = original ? json_copy_shared(original) : NULL;
+    struct jsonValue *expected = json_parse("{\"name\": \"base\", \"limits\": {\"cpu\": 8, \"memory\": 2}, "
+            "\"tags\": [\"a\", \"b\"]}", true);
+    unsigned long long hash = copy ? json_hash(copy) : 0;
+    bool ok = copy && expected && hash && hash == json_hash(original) && hash == json_hash(copy);
+    // The copy gets the values to itself, a change drops the kept hash.
+    json_value_free(original);
+    ok = ok && json_set_number(json_object_lookup_mut(json_object_lookup_mut(copy, "limits"), "cpu"), 8);
+    ok = ok && json_hash(copy) != hash && json_hash(copy) == json_hash(expected);
+    ok = ok && !json_hash(NULL) && json_last_error()->code == JSON_ERROR_ARGUMENT;
+    json_value_free(copy);
+    json_value_free(expected);
+    return ok;
+}
+
+static bool test_equal_shared(void) {
+    struct jsonValue *left = json_parse("{\"a\": {\"b\": [1, 2, 3]}}", true);
+    struct jsonValue *right = json_parse("{\"a\": {\"b\": [1, 2, 4]}}", true);
+    struct jsonValue *left_copy = left ? json_copy_shared(left) : NULL;
+    struct jsonValue *right_copy = right ? json_copy_shared(right) : NULL;
+    struct jsonValue *left_out = NULL;
+    struct jsonValue *right_out = NULL;
+    double left_number = 0;
+    double right_number = 0;
+    bool ok = left_copy && right_copy && json_hash(left) != json_hash(right);
+    ok = ok && !json_are_equal(left, right, NULL, NULL);
+    // The differing nodes are still found when they're asked for.
+    ok = ok && !json_are_equal(left, right, &left_out, &right_out) && left_out && right_out
+        && json_get_number(left_out, &left_number) && json_get_number(right_out, &right_number)
+        && left_number == 3 && right_number == 4;
+    ok = ok && json_are_equal(json_object_lookup(left, "a"), json_object_lookup(left_copy, "a"), NULL, NULL);
+    json_value_free(left);
+    json_value_free(right);
+    json_value_free(left_copy);
+    json_value_free(right_copy);
+    return ok;
+}
+
+extern bool test_hash(void) {
+    return test_structure() && test_kept() && test_equal_shared();
+}
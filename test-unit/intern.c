@@ -0,0 +1,69 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include <json.h>
+
+#define TEXT_SIZE 256
+
+static const char catalog[] = "{\"seats\": [{\"area\": 1, \"prices\": [10, 20]}, "
+    "{\"area\": 1, \"prices\": [10, 20]}], \"default\": {\"prices\": [10, 20], \"area\": 1}, "
+    "\"name\": \"hall\", \"alias\": \"hall\", \"flags\": [true, true]}";
+
+static const struct jsonParseOptions sharing = { .share_equal_values = true };
+
+static bool same_text(struct jsonValue *value, const char *expected) {
+    char text[TEXT_SIZE];
+    struct jsonPrintOptions options = { .sort_keys = true };
+    size_t n = json_print(text, TEXT_SIZE, value, &options);
+    return n && n < TEXT_SIZE && !strcmp(text, expected);
+}
+
+static bool test_shared_nodes(void) {
+    struct jsonValue *shared = json_parse_with(catalog, strlen(catalog), &sharing);
+    struct jsonValue *plain = json_parse(catalog, true);
+    struct jsonValue *seats = shared ? json_object_lookup(shared, "seats") : NULL;
+    bool ok = seats && plain && json_are_equal(shared, plain, NULL, NULL) && json_hash(shared) == json_hash(plain);
+    struct jsonValue *flags = seats ? json_object_lookup(shared, "flags") : NULL;
+    ok = ok && json_array_at(seats, 0) == json_array_at(seats, 1)
+        && json_array_at(seats, 0) == json_object_lookup(shared, "default")
+        && json_object_lookup(shared, "name") == json_object_lookup(shared, "alias")
+        && json_array_at(flags, 0) == json_array_at(flags, 1);
+    ok = ok && !json_is_shared(shared) && json_is_shared(seats) && json_is_shared(json_array_at(seats, 0));
+    json_value_free(shared);
+    json_value_free(plain);
+    return ok;
+}
+
+static bool test_change(void) {
+    struct jsonValue *root = json_parse_with(catalog, strlen(catalog), &sharing);
+    struct jsonValue *area = root ? json_object_lookup(json_object_lookup(root, "default"), "area") : NULL;
+    // Shared values are sealed, a change copies the path to it.
+    bool ok = area && !json_set_number(area, 2);
+    ok = ok && json_set_number(json_object_lookup_mut(json_object_lookup_mut(root, "default"), "area"), 2);
+    ok = ok && same_text(root, "{\"alias\":\"hall\",\"default\":{\"area\":2,\"prices\":[10,20]},"
+            "\"flags\":[true,true],\"name\":\"hall\",\"seats\":[{\"area\":1,\"prices\":[10,20]},"
+            "{\"area\":1,\"prices\":[10,20]}]}");
+    json_value_free(root);
+    return ok;
+}
+
+static bool test_failure(void) {
+    const char *bad = "[[1, 2], [1, 2], [1, 2}";
+    bool ok = !json_parse_with(bad, strlen(bad), &sharing) && json_last_error()->code == JSON_ERROR_SYNTAX;
+    // Scalars at the root aren't shared with anything.
+    struct jsonValue *number = json_parse_with("5", 1, &sharing);
+    ok = ok && number && !json_is_shared(number) && json_set_number(number, 6);
+    json_value_free(number);
+    // Later parses don't share values with earlier ones.
+    struct jsonValue *first = json_parse_with("[[1], [1]]", 10, &sharing);
+    struct jsonValue *second = json_parse_with("[[1], [1]]", 10, &sharing);
+    ok = ok && first && second && json_array_at(first, 0) == json_array_at(first, 1)
+        && json_array_at(first, 0) != json_array_at(second, 0);
+    json_value_free(first);
+    json_value_free(second);
+    return ok;
+}
+
+extern bool test_intern(void) {
+    return test_shared_nodes() && test_change() && test_failure();
+}
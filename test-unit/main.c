@@ -21,6 +21,25 @@ static struct {
     { test_string, "STRING" },
     { test_parser, "PARSER" },
     { test_pretty_printer, "PRETTY PRINTER" },
+    { test_binary, "BINARY FORMATS" },
+    { test_snapshot, "SNAPSHOT" },
+    { test_writer, "WRITER" },
+    { test_allocator, "ALLOCATOR" },
+    { test_pool, "POOL" },
+    { test_track, "ALLOCATION TRACKING" },
+    { test_usage, "MEMORY USAGE" },
+    { test_compact, "COMPACT" },
+    { test_share, "SHARING" },
+    { test_copy, "COPY" },
+    { test_error, "ERROR" },
+    { test_pointer, "POINTER" },
+    { test_query, "QUERY" },
+    { test_filter, "FILTER" },
+    { test_bind, "BIND" },
+    { test_patch, "PATCH" },
+    { test_diff, "DIFF" },
+    { test_hash, "HASH" },
+    { test_intern, "INTERN" },
 };
 
 int main(int argc, char *argv[]) {
@@ -30,6 +49,7 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "json_init failed\n");
         return EXIT_FAILURE;
     }
+    bool all_ok = true;
     for (size_t i = 0; i < sizeof(tests) / sizeof(*tests); ++i) {
         bool ok = tests[i].run();
         if (ok) {
@@ -37,7 +57,8 @@ int main(int argc, char *argv[]) {
         } else {
             printf(RED "%s UNIT TEST FAILED\n" RESET, tests[i].name);
         }
+        all_ok = all_ok && ok;
     }
     json_exit();
-    return EXIT_SUCCESS;
+    return all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,5 +1,10 @@
 #include <stdbool.h>
+#include <stdint.h>
+
+#include <json.h>
 
 extern bool test_object(void) {
-    return true;
+    // Objects can't have 2^31 members or more.
+    return !json_create_object(SIZE_MAX) && json_last_error()->code == JSON_ERROR_LIMIT
+        && !json_create_object((size_t) 1 << 31) && json_last_error()->code == JSON_ERROR_LIMIT;
 }
@@ -1,5 +1,240 @@
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#define DEEP 10000
+
+/* Text of n arrays nested in each other. */
+static char *nested_arrays(size_t n) {
+    char *text = malloc(2 * n + 1);
+    if (text) {
+        memset(text, '[', n);
+        memset(text + n, ']', n);
+        text[2 * n] = '\0';
+    }
+    return text;
+}
+
+static bool test_depth(void) {
+    char *limit = nested_arrays(JSON_DEFAULT_MAX_DEPTH);
+    char *deep = nested_arrays(DEEP);
+    bool ok = limit && deep;
+    struct jsonValue *value = ok ? json_parse(limit, true) : NULL;
+    ok = ok && value && !json_parse(deep, true) && !strcmp(json_strerror(), "at 1:129 maximum nesting depth exceeded");
+    json_value_free(value);
+    struct jsonParseOptions options = { .max_depth = DEEP };
+    value = ok ? json_parse_with(deep, strlen(deep), &options) : NULL;
+    ok = ok && value;
+    options.max_depth = DEEP - 1;
+    ok = ok && !json_parse_with(deep, strlen(deep), &options);
+    json_value_free(value);
+    free(limit);
+    free(deep);
+    return ok;
+}
+
+#define DEEPEST 1000000
+
+/* Text of n objects nested in each other, the innermost one holds a number. */
+static char *nested_objects(size_t n) {
+    char *text = malloc(6 * n + 2);
+    if (text) {
+        for (size_t i = 0; i < n; ++i) {
+            memcpy(text + 5 * i, "{\"a\":", 5);
+        }
+        text[5 * n] = '1';
+        memset(text + 5 * n + 1, '}', n);
+        text[6 * n + 1] = '\0';
+    }
+    return text;
+}
+
+/* Walks over the tree don't recurse, so the depth is only limited by memory. */
+static bool check_deep_tree(const char *text) {
+    size_t n = strlen(text);
+    struct jsonParseOptions options = { .max_depth = DEEPEST };
+    struct jsonPrintOptions compact = { .sort_keys = true };
+    struct jsonValue *value = json_parse_with(text, n, &options);
+    struct jsonValue *shared = value ? json_copy_shared(value) : NULL;
+    char *printed = malloc(n + 1);
+    struct jsonMemoryUsage usage;
+    bool ok = shared && printed && json_serialized_size(value, &compact) == n
+        && json_print(printed, n + 1, value, &compact) == n && !strcmp(printed, text)
+        && json_memory_usage(value, &usage) && usage.nodes == DEEPEST + (text[0] == '{');
+    free(printed);
+    json_value_free(shared);
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_deep_tree(void) {
+    char *arrays = nested_arrays(DEEPEST);
+    char *objects = nested_objects(DEEPEST);
+    bool ok = arrays && objects && check_deep_tree(arrays) && check_deep_tree(objects);
+    free(arrays);
+    free(objects);
+    return ok;
+}
+
+static bool test_trailing_bytes(void) {
+    const char *text = "{\"a\": [1, 2]} [3]";
+    struct jsonParseOptions options = { .allow_trailing_bytes = true };
+    struct jsonValue *value = json_parse_with(text, strlen(text), &options);
+    bool ok = value && json_array_size(json_object_lookup(value, "a")) == 2 && !json_parse(text, true);
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_errors(void) {
+    static const char *bad[] = {
+        "", "[", "[1,]", "[1 2]", "{\"a\" 1}", "{\"a\": 1,}", "{,}", "{1: 2}", "[1, {\"a\": [tru]}]", "[\"\\x\"]",
+        "[1]\xFF",
+    };
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !json_parse(bad[i], true) && strcmp(json_strerror(), "");
+        ok = ok && !json_validate(bad[i], strlen(bad[i]), NULL, NULL) && strcmp(json_strerror(), "");
+    }
+    return ok;
+}
+
+static bool test_values(void) {
+    struct jsonValue *value = json_parse(" {\"a\": [true, false, null, -1.5e2, \"s\"], \"b\": {}, \"c\": []} ", true);
+    double number = 0;
+    bool boolean = false;
+    const char *string = NULL;
+    struct jsonValue *a = json_object_lookup(value, "a");
+    bool ok = value && json_array_size(a) == 5 && json_get_boolean(json_array_at(a, 0), &boolean) && boolean;
+    ok = ok && json_get_number(json_array_at(a, 3), &number) && number == -150;
+    ok = ok && json_get_string(json_array_at(a, 4), &string) && !strcmp(string, "s");
+    ok = ok && json_object_number_of_keys(json_object_lookup(value, "b")) == 0;
+    ok = ok && json_array_size(json_object_lookup(value, "c")) == 0;
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_validate(void) {
+    const char *text = " {\"a\": [1, {\"b\": [[]]}], \"c\": \"\\u00e9\"} [2]";
+    struct jsonParseOptions options = { .allow_trailing_bytes = true };
+    struct jsonValidation validation = { 0, 0 };
+    bool ok = json_validate(text, strlen(text), &options, &validation) && validation.depth == 5;
+    ok = ok && validation.end == strlen(text) - 4 && !json_validate(text, strlen(text), NULL, NULL);
+    ok = ok && json_validate("-0.5e+3 ", 8, NULL, &validation) && validation.depth == 0 && validation.end == 7;
+    ok = ok && !json_validate("[1, {\"a\": tru}]", 16, NULL, NULL);
+    ok = ok && !strcmp(json_strerror(), "at 1:11 'true' was expected");
+    char *deep = nested_arrays(DEEP);
+    options = (struct jsonParseOptions) { .max_depth = DEEP };
+    ok = ok && deep && json_validate(deep, strlen(deep), &options, &validation) && validation.depth == DEEP;
+    ok = ok && deep && !json_validate(deep, strlen(deep), NULL, NULL);
+    free(deep);
+    return ok;
+}
+
+static bool test_utf8(void) {
+    static const char *bad[] = {
+        "\"\xC0\x80\"", "\"\x80\"", "\"\xE0\x80\x80\"", "\"\xED\xA0\x80\"", "\"\xF4\x90\x80\x80\"", "\"\xE2\x82\"",
+        "\"\\ud800\"", "\"\\udc00\\ud800\"", "\"\\ud800\\u0041\"", "\"\\u0x12\"",
+    };
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !json_parse(bad[i], true) && !json_validate(bad[i], strlen(bad[i]), NULL, NULL);
+    }
+    ok = ok && !json_parse("[\"0123456789abcdef\xFF\"]", true);
+    ok = ok && !strcmp(json_strerror(), "at 1:19 invalid UTF-8 sequence");
+    // Surrogates that don't come in pairs are kept as they are for trusted input.
+    struct jsonParseOptions options = { .trusted_utf8 = true };
+    struct jsonValue *value = json_parse_with(bad[1], strlen(bad[1]), &options);
+    const char *string = NULL;
+    ok = ok && value && json_get_string(value, &string) && !strcmp(string, "\x80");
+    json_value_free(value);
+    value = json_parse_with(bad[8], strlen(bad[8]), &options);
+    ok = ok && value && json_get_string(value, &string) && !strcmp(string, "\xED\xA0\x80" "A");
+    json_value_free(value);
+    const char *text = "[\"long enough to take a few words: \xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80, "
+        "\\u5000\\u6400\\ud83d\\ude00\"]";
+    value = json_parse(text, true);
+    ok = ok && value && json_get_string(json_array_at(value, 0), &string);
+    ok = ok && !strcmp(string, "long enough to take a few words: \xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80, "
+            "\xE5\x80\x80\xE6\x90\x80\xF0\x9F\x98\x80");
+    json_value_free(value);
+    return ok;
+}
+
+/* Encodes code points the way UTF-16 or UTF-32 does, little or big endian.
+ * Returns the number of bytes written. */
+static size_t encode_wide(const uint32_t *text, size_t n, size_t unit, bool big, unsigned char *out) {
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t units[2] = { text[i], 0 };
+        size_t count = 1;
+        if (unit == 2 && text[i] >= 0x10000) {
+            units[0] = 0xD800 | (text[i] - 0x10000) >> 10;
+            units[1] = 0xDC00 | (text[i] & 0x3FF);
+            count = 2;
+        }
+        for (size_t j = 0; j < count; ++j) {
+            for (size_t k = 0; k < unit; ++k) {
+                out[size++] = units[j] >> 8 * (big ? unit - 1 - k : k) & 0xFF;
+            }
+        }
+    }
+    return size;
+}
+
+static bool test_encodings(void) {
+    static const uint32_t text[] = {
+        0xFEFF, '{', '"', 'k', 0xE9, 'y', '"', ':', ' ', '[', '1', ',', '"', 0x20AC, 0x1F600, '\\', 'n', '"', ']', '}',
+    };
+    static const struct {
+        enum jsonEncoding encoding;
+        size_t unit;
+        bool big;
+    } encodings[] = {
+        { JSON_ENCODING_UTF16LE, 2, false },
+        { JSON_ENCODING_UTF16BE, 2, true },
+        { JSON_ENCODING_UTF32LE, 4, false },
+        { JSON_ENCODING_UTF32BE, 4, true },
+    };
+    const size_t n = sizeof(text) / sizeof(*text);
+    unsigned char buffer[sizeof(text) * 2];
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(encodings) / sizeof(*encodings); ++i) {
+        size_t unit = encodings[i].unit;
+        // With the byte order mark, without it, and told explicitly.
+        for (int way = 0; ok && way < 3; ++way) {
+            size_t skip = way ? unit : 0;
+            size_t size = encode_wide(text, n, unit, encodings[i].big, buffer) - skip;
+            struct jsonParseOptions options = { .encoding = way == 2 ? encodings[i].encoding : JSON_ENCODING_AUTO };
+            struct jsonValue *value = json_parse_with((const char *) buffer + skip, size, &options);
+            const char *string = NULL;
+            struct jsonValue *array = json_object_lookup(value, "k\xC3\xA9y");
+            ok = value && json_array_size(array) == 2 && json_get_string(json_array_at(array, 1), &string);
+            ok = ok && !strcmp(string, "\xE2\x82\xAC\xF0\x9F\x98\x80\n");
+            json_value_free(value);
+            struct jsonValidation validation = { 0, 0 };
+            ok = ok && json_validate((const char *) buffer + skip, size, &options, &validation);
+            ok = ok && validation.depth == 2 && validation.end == size;
+            // A unit cut by the end is an error.
+            ok = ok && !json_parse_with((const char *) buffer + skip, size + 1, &options);
+        }
+    }
+    // Half a surrogate pair.
+    static const uint32_t lone[] = { '"', 0xD800, '"' };
+    struct jsonParseOptions options = { .encoding = JSON_ENCODING_UTF16LE };
+    size_t size = encode_wide(lone, 3, 2, false, buffer);
+    ok = ok && !json_parse_with((const char *) buffer, size, &options);
+    ok = ok && !strcmp(json_strerror(), "at 1:2 invalid UTF-16 sequence");
+    // UTF-8 with a byte order mark.
+    struct jsonValue *value = json_parse("\xEF\xBB\xBF[true]", true);
+    ok = ok && json_array_size(value) == 1;
+    json_value_free(value);
+    return ok;
+}
 
 extern bool test_parser(void) {
-    return true;
+    return test_values() && test_depth() && test_deep_tree() && test_trailing_bytes() && test_errors()
+        && test_validate() && test_utf8() && test_encodings();
 }
@@ -0,0 +1,229 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#define TEXT_SIZE 512
+
+static const struct jsonPrintOptions compact = { .sort_keys = true };
+
+/* Compact text of a value, so values can be compared as text. */
+static bool text_of(struct jsonValue *value, char *out) {
+    size_t n = json_print(out, TEXT_SIZE, value, &compact);
+    return n && n < TEXT_SIZE;
+}
+
+static bool same_text(struct jsonValue *value, const char *json) {
+    char actual[TEXT_SIZE];
+    char expected[TEXT_SIZE];
+    struct jsonValue *parsed = json_parse(json, true);
+    bool ok = parsed && text_of(value, actual) && text_of(parsed, expected) && !strcmp(actual, expected);
+    json_value_free(parsed);
+    return ok;
+}
+
+/* Applies a patch to a document and compares the result with the expected
+ * one. A NULL result means the patch must fail with the code and leave the
+ * document unchanged. */
+static bool check(bool (*apply)(struct jsonValue *, struct jsonValue *), const char *document, const char *patch,
+        const char *result, enum jsonErrorCode code) {
+    struct jsonValue *target = json_parse(document, true);
+    struct jsonValue *changes = json_parse(patch, true);
+    struct jsonValue *root = target;
+    bool ok = target && changes;
+    if (ok && result) {
+        ok = apply(target, changes) && same_text(target, result);
+    } else if (ok) {
+        ok = !apply(target, changes) && json_last_error()->code == code && same_text(target, document);
+    }
+    ok = ok && target == root;
+    json_value_free(target);
+    json_value_free(changes);
+    return ok;
+}
+
+static bool patch(const char *document, const char *patch, const char *result) {
+    return check(json_patch_apply, document, patch, result, JSON_ERROR_NONE);
+}
+
+static bool patch_fails(const char *document, const char *patch, enum jsonErrorCode code) {
+    return check(json_patch_apply, document, patch, NULL, code);
+}
+
+static bool merge(const char *document, const char *patch, const char *result) {
+    return check(json_merge_patch_apply, document, patch, result, JSON_ERROR_NONE);
+}
+
+// Examples of RFC 6902, appendix A.
+static bool test_operations(void) {
+    return patch("{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/baz\", \"value\": \"qux\"}]",
+            "{\"baz\": \"qux\", \"foo\": \"bar\"}")
+        && patch("{\"foo\": [\"bar\", \"baz\"]}", "[{\"op\": \"add\", \"path\": \"/foo/1\", \"value\": \"qux\"}]",
+            "{\"foo\": [\"bar\", \"qux\", \"baz\"]}")
+        && patch("{\"baz\": \"qux\", \"foo\": \"bar\"}", "[{\"op\": \"remove\", \"path\": \"/baz\"}]",
+            "{\"foo\": \"bar\"}")
+        && patch("{\"foo\": [\"bar\", \"qux\", \"baz\"]}", "[{\"op\": \"remove\", \"path\": \"/foo/1\"}]",
+            "{\"foo\": [\"bar\", \"baz\"]}")
+        && patch("{\"baz\": \"qux\", \"foo\": \"bar\"}",
+            "[{\"op\": \"replace\", \"path\": \"/baz\", \"value\": \"boo\"}]",
+            "{\"baz\": \"boo\", \"foo\": \"bar\"}")
+        && patch("{\"foo\": {\"bar\": \"baz\", \"waldo\": \"fred\"}, \"qux\": {\"corge\": \"grault\"}}",
+            "[{\"op\": \"move\", \"from\": \"/foo/waldo\", \"path\": \"/qux/thud\"}]",
+            "{\"foo\": {\"bar\": \"baz\"}, \"qux\": {\"corge\": \"grault\", \"thud\": \"fred\"}}")
+        && patch("{\"foo\": [\"all\", \"grass\", \"cows\", \"eat\"]}",
+            "[{\"op\": \"move\", \"from\": \"/foo/1\", \"path\": \"/foo/3\"}]",
+            "{\"foo\": [\"all\", \"cows\", \"eat\", \"grass\"]}")
+        && patch("{\"baz\": \"qux\", \"foo\": [\"a\", 2, \"c\"]}",
+            "[{\"op\": \"test\", \"path\": \"/baz\", \"value\": \"qux\"}, "
+            "{\"op\": \"test\", \"path\": \"/foo/1\", \"value\": 2}]", "{\"baz\": \"qux\", \"foo\": [\"a\", 2, \"c\"]}")
+        && patch("{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/child\", \"value\": {\"grandchild\": {}}}]",
+            "{\"foo\": \"bar\", \"child\": {\"grandchild\": {}}}")
+        && patch("{\"foo\": [\"bar\"]}", "[{\"op\": \"add\", \"path\": \"/foo/-\", \"value\": [\"abc\", \"def\"]}]",
+            "{\"foo\": [\"bar\", [\"abc\", \"def\"]]}")
+        && patch("{\"/\": 9, \"~1\": 10}", "[{\"op\": \"test\", \"path\": \"/~01\", \"value\": 10}]",
+            "{\"/\": 9, \"~1\": 10}")
+        && patch("{\"a\": [1]}", "[{\"op\": \"copy\", \"from\": \"/a\", \"path\": \"/b\"}, "
+            "{\"op\": \"add\", \"path\": \"/b/0\", \"value\": 0}]", "{\"a\": [1], \"b\": [0, 1]}")
+        && patch("{\"a\": {\"b\": [1, 2]}}", "[{\"op\": \"move\", \"from\": \"/a/b\", \"path\": \"/a\"}]",
+            "{\"a\": [1, 2]}")
+        && patch("[1, 2]", "[{\"op\": \"replace\", \"path\": \"/1\", \"value\": 3}]", "[1, 3]");
+}
+
+static bool test_root(void) {
+    return patch("{\"a\": 1}", "[{\"op\": \"replace\", \"path\": \"\", \"value\": [1]}]", "[1]")
+        && patch("{\"a\": 1}", "[{\"op\": \"add\", \"path\": \"\", \"value\": \"x\"}]", "\"x\"")
+        && patch("{\"a\": {\"b\": 1}}", "[{\"op\": \"move\", \"from\": \"/a\", \"path\": \"\"}]", "{\"b\": 1}")
+        && patch("{\"a\": 1}", "[{\"op\": \"copy\", \"from\": \"\", \"path\": \"/b\"}]",
+            "{\"a\": 1, \"b\": {\"a\": 1}}")
+        && patch_fails("{\"a\": 1}", "[{\"op\": \"remove\", \"path\": \"\"}]", JSON_ERROR_PATCH);
+}
+
+static bool test_failures(void) {
+    // Every failure comes after changes that must be undone.
+    const char *document = "{\"a\": {\"b\": [1, 2, {\"c\": true}]}, \"d\": \"e\", \"d\": \"f\"}";
+    const char *changes = "{\"op\": \"remove\", \"path\": \"/d\"}, "
+        "{\"op\": \"add\", \"path\": \"/a/b/0\", \"value\": 0}, "
+        "{\"op\": \"move\", \"from\": \"/a/b/3\", \"path\": \"/g\"}, "
+        "{\"op\": \"replace\", \"path\": \"/a/b/1\", \"value\": null}, "
+        "{\"op\": \"add\", \"path\": \"/h\", \"value\": [1]}, "
+        "{\"op\": \"remove\", \"path\": \"/a/b/0\"}, "
+        "{\"op\": \"replace\", \"path\": \"\", \"value\": {\"a\": 1}}, "
+        "{\"op\": \"copy\", \"from\": \"/a\", \"path\": \"/i\"}";
+    static const char *failing[] = {
+        "{\"op\": \"test\", \"path\": \"/a\", \"value\": \"1\"}",
+        "{\"op\": \"remove\", \"path\": \"/x\"}",
+        "{\"op\": \"add\", \"path\": \"/x/y\", \"value\": 1}",
+        "{\"op\": \"move\", \"from\": \"/a\", \"path\": \"/a/x\"}",
+    };
+    char text[TEXT_SIZE];
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(failing) / sizeof(*failing); ++i) {
+        size_t n = (size_t) snprintf(text, sizeof(text), "[%s, %s]", changes, failing[i]);
+        ok = n < sizeof(text) && patch_fails(document, text, JSON_ERROR_PATCH);
+    }
+    snprintf(text, sizeof(text), "[%s]", changes);
+    ok = ok && patch(document, text, "{\"a\": 1, \"i\": 1}");
+    static const char *malformed[] = {
+        "{}", "[1]", "[{\"path\": \"/a\"}]", "[{\"op\": \"add\", \"path\": \"/a\"}]",
+        "[{\"op\": \"get\", \"path\": \"\"}]",
+        "[{\"op\": \"copy\", \"path\": \"/a\"}]",
+    };
+    for (size_t i = 0; ok && i < sizeof(malformed) / sizeof(*malformed); ++i) {
+        ok = patch_fails("{\"a\": 1}", malformed[i], JSON_ERROR_ARGUMENT);
+    }
+    return ok && patch_fails("{\"a\": 1}", "[{\"op\": \"remove\", \"path\": \"a\"}]", JSON_ERROR_SYNTAX)
+        && patch_fails("[1]", "[{\"op\": \"add\", \"path\": \"/2\", \"value\": 1}]", JSON_ERROR_PATCH)
+        && patch_fails("{\"a\": 1}", "[{\"op\": \"test\", \"path\": \"/a\", \"value\": 2}]", JSON_ERROR_PATCH)
+        && patch_fails("[1]", "[{\"op\": \"add\", \"path\": \"/01\", \"value\": 1}]", JSON_ERROR_PATCH);
+}
+
+static bool test_shared(void) {
+    struct jsonValue *original = json_parse("{\"a\": {\"b\": [1, 2]}, \"c\": {}}", true);
+    struct jsonValue *copy = original ? json_copy_shared(original) : NULL;
+    struct jsonValue *changes = json_parse("[{\"op\": \"remove\", \"path\": \"/a/b/0\"}]", true);
+    bool ok = copy && changes && json_patch_apply(copy, changes) && same_text(copy, "{\"a\": {\"b\": [2]}, \"c\": {}}")
+        && same_text(original, "{\"a\": {\"b\": [1, 2]}, \"c\": {}}");
+    ok = ok && !json_patch_apply(json_object_lookup(original, "c"), changes)
+        && json_last_error()->code == JSON_ERROR_READ_ONLY;
+    json_value_free(changes);
+    json_value_free(copy);
+    json_value_free(original);
+    return ok;
+}
+
+// Removed members leave deleted entries behind, which must not fill the table.
+static bool test_churn(void) {
+    struct jsonValue *target = json_parse("{\"a\": 1}", true);
+    bool ok = target;
+    for (int i = 0; ok && i < 1000; ++i) {
+        char text[128];
+        snprintf(text, sizeof(text), "[{\"op\": \"add\", \"path\": \"/k%d\", \"value\": %d}, "
+                "{\"op\": \"remove\", \"path\": \"/k%d\"}]", i, i, i);
+        struct jsonValue *changes = json_parse(text, true);
+        ok = changes && json_patch_apply(target, changes);
+        json_value_free(changes);
+    }
+    ok = ok && json_object_number_of_keys(target) == 1 && json_object_capacity(target) < 100
+        && !json_object_lookup(target, "missing") && same_text(target, "{\"a\": 1}");
+    json_value_free(target);
+    return ok;
+}
+
+// An add after many removals drops deleted entries, undoing must still put
+// the removed members back.
+static bool test_undo_after_rehash(void) {
+    struct jsonValue *target = json_create_object(0);
+    struct jsonValue *changes = json_create_array(0);
+    bool ok = target && changes;
+    for (int i = 0; ok && i < 111; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        ok = json_object_add(target, key, json_create_number(i));
+    }
+    for (int i = 0; ok && i < 102; ++i) {
+        char text[64];
+        if (i < 100) {
+            snprintf(text, sizeof(text), "{\"op\": \"remove\", \"path\": \"/k%d\"}", i);
+        } else if (i == 100) {
+            snprintf(text, sizeof(text), "{\"op\": \"add\", \"path\": \"/new\", \"value\": 1}");
+        } else {
+            snprintf(text, sizeof(text), "{\"op\": \"test\", \"path\": \"/k110\", \"value\": 0}");
+        }
+        ok = json_array_append(changes, json_parse(text, true));
+    }
+    struct jsonValue *original = ok ? json_copy(target) : NULL;
+    ok = original && !json_patch_apply(target, changes) && json_last_error()->code == JSON_ERROR_PATCH
+        && json_are_equal(target, original, NULL, NULL) && !json_object_lookup(target, "new");
+    json_value_free(original);
+    json_value_free(changes);
+    json_value_free(target);
+    return ok;
+}
+
+// Examples of RFC 7386, appendix A.
+static bool test_merge(void) {
+    return merge("{\"a\": \"b\"}", "{\"a\": \"c\"}", "{\"a\": \"c\"}")
+        && merge("{\"a\": \"b\"}", "{\"b\": \"c\"}", "{\"a\": \"b\", \"b\": \"c\"}")
+        && merge("{\"a\": \"b\"}", "{\"a\": null}", "{}")
+        && merge("{\"a\": \"b\", \"b\": \"c\"}", "{\"a\": null}", "{\"b\": \"c\"}")
+        && merge("{\"a\": [\"b\"]}", "{\"a\": \"c\"}", "{\"a\": \"c\"}")
+        && merge("{\"a\": \"c\"}", "{\"a\": [\"b\"]}", "{\"a\": [\"b\"]}")
+        && merge("{\"a\": {\"b\": \"c\"}}", "{\"a\": {\"b\": \"d\", \"c\": null}}", "{\"a\": {\"b\": \"d\"}}")
+        && merge("{\"a\": [{\"b\": \"c\"}]}", "{\"a\": [1]}", "{\"a\": [1]}")
+        && merge("[\"a\", \"b\"]", "[\"c\", \"d\"]", "[\"c\", \"d\"]")
+        && merge("{\"a\": \"b\"}", "[\"c\"]", "[\"c\"]")
+        && merge("{\"a\": \"foo\"}", "null", "null")
+        && merge("{\"a\": \"foo\"}", "\"bar\"", "\"bar\"")
+        && merge("{\"e\": null}", "{\"a\": 1}", "{\"e\": null, \"a\": 1}")
+        && merge("[1, 2]", "{\"a\": \"b\", \"c\": null}", "{\"a\": \"b\"}")
+        && merge("{}", "{\"a\": {\"bb\": {\"ccc\": null}}}", "{\"a\": {\"bb\": {}}}")
+        && merge("{\"a\": 1, \"a\": 2, \"b\": {\"c\": 1}}", "{\"a\": null, \"b\": {\"d\": 2}}",
+            "{\"b\": {\"c\": 1, \"d\": 2}}");
+}
+
+extern bool test_patch(void) {
+    return test_operations() && test_root() && test_failures() && test_shared() && test_churn()
+        && test_undo_after_rehash() && test_merge();
+}
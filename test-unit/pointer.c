@@ -0,0 +1,84 @@
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <json.h>
+
+// Example document of RFC 6901.
+static const char document[] = "{\"foo\": [\"bar\", \"baz\"], \"\": 0, \"a/b\": 1, \"c%d\": 2, \"e^f\": 3, \"g|h\": 4, "
+    "\"i\\\\j\": 5, \"k\\\"l\": 6, \" \": 7, \"m~n\": 8}";
+
+static bool number_at(struct jsonValue *value, const char *text, double expected) {
+    struct jsonPointer *pointer = json_pointer_compile(text);
+    double number = -1;
+    bool ok = pointer && json_get_number(json_pointer_get(pointer, value), &number) && number == expected;
+    json_pointer_free(pointer);
+    return ok;
+}
+
+static bool missing(struct jsonValue *value, const char *text) {
+    struct jsonPointer *pointer = json_pointer_compile(text);
+    bool ok = pointer && !json_pointer_get(pointer, value);
+    json_pointer_free(pointer);
+    return ok;
+}
+
+static bool test_rfc_examples(struct jsonValue *value) {
+    struct jsonPointer *root = json_pointer_compile("");
+    struct jsonPointer *foo = json_pointer_compile("/foo");
+    struct jsonPointer *baz = json_pointer_compile("/foo/1");
+    const char *string = NULL;
+    bool ok = root && foo && baz && json_pointer_get(root, value) == value;
+    ok = ok && json_pointer_get(foo, value) == json_object_lookup(value, "foo");
+    ok = ok && json_get_string(json_pointer_get(baz, value), &string) && !strcmp(string, "baz");
+    json_pointer_free(root);
+    json_pointer_free(foo);
+    json_pointer_free(baz);
+    ok = ok && number_at(value, "/", 0) && number_at(value, "/a~1b", 1) && number_at(value, "/c%d", 2);
+    ok = ok && number_at(value, "/e^f", 3) && number_at(value, "/g|h", 4) && number_at(value, "/i\\j", 5);
+    ok = ok && number_at(value, "/k\"l", 6) && number_at(value, "/ ", 7) && number_at(value, "/m~0n", 8);
+    return ok;
+}
+
+static bool test_missing(struct jsonValue *value) {
+    return missing(value, "/bar") && missing(value, "/foo/2") && missing(value, "/foo/-") && missing(value, "/foo/01")
+        && missing(value, "/foo/x") && missing(value, "/a~1b/c") && missing(value, "/foo/99999999999999999999999");
+}
+
+static bool test_syntax(void) {
+    bool ok = !json_pointer_compile("foo") && json_last_error()->code == JSON_ERROR_SYNTAX;
+    ok = ok && !json_pointer_compile("/a~2") && json_last_error()->offset == 2;
+    ok = ok && !json_pointer_compile("/a~") && !json_pointer_compile(NULL);
+    return ok;
+}
+
+/* Keys added more than once resolve to the value added last. */
+static bool test_duplicate_keys(void) {
+    struct jsonValue *value = json_parse("{\"a\": 1, \"b\": {\"a\": [true]}, \"a\": 2}", true);
+    bool ok = value && number_at(value, "/a", 2);
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_snapshot_values(struct jsonValue *value) {
+    static alignas(8) char buffer[4096];
+    size_t size = json_snapshot_encode(buffer, sizeof(buffer), value);
+    struct jsonSnapshot *snapshot = size && size <= sizeof(buffer) ? json_snapshot_open_mem(buffer, size) : NULL;
+    struct jsonValue *root = json_snapshot_root(snapshot);
+    bool ok = root && number_at(root, "/m~0n", 8) && missing(root, "/foo/2");
+    struct jsonPointer *pointer = json_pointer_compile("/foo/0");
+    const char *string = NULL;
+    ok = ok && pointer && json_get_string(json_pointer_get(pointer, root), &string) && !strcmp(string, "bar");
+    json_pointer_free(pointer);
+    json_snapshot_close(snapshot);
+    return ok;
+}
+
+extern bool test_pointer(void) {
+    struct jsonValue *value = json_parse(document, true);
+    bool ok = value && test_rfc_examples(value) && test_missing(value) && test_syntax() && test_duplicate_keys()
+        && test_snapshot_values(value);
+    json_value_free(value);
+    return ok;
+}
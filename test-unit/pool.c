@@ -0,0 +1,130 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include <json.h>
+
+#define THREADS 4
+#define VALUES  5000
+#define LEAVERS 64
+#define SMALL   100
+
+/* Builds an array of numbers and checks nothing else reused its nodes. */
+static struct jsonValue *build_size(int seed, int size) {
+    struct jsonValue *array = json_create_array(size);
+    for (int i = 0; array && i < size; ++i) {
+        if (!json_array_append(array, json_create_number(seed + i))) {
+            json_value_free(array);
+            return NULL;
+        }
+    }
+    return array;
+}
+
+static struct jsonValue *build(int seed) {
+    return build_size(seed, VALUES);
+}
+
+static bool check(struct jsonValue *array, int seed) {
+    for (int i = 0; i < VALUES; ++i) {
+        double number = 0;
+        if (!json_get_number(json_array_at(array, i), &number) || number != seed + i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int churn(void *arg) {
+    int seed = *(int *) arg;
+    bool ok = true;
+    for (int round = 0; ok && round < 10; ++round) {
+        struct jsonValue *array = build(seed + round);
+        ok = array && check(array, seed + round);
+        json_value_free(array);
+    }
+    return ok;
+}
+
+static int release(void *arg) {
+    json_value_free(arg);
+    return true;
+}
+
+// Only the main thread allocates while it's counted.
+static void *counting_allocate(void *context, size_t size) {
+    ++*(size_t *) context;
+    return malloc(size);
+}
+
+static void *counting_reallocate(void *context, void *ptr, size_t size) {
+    if (!ptr) {
+        ++*(size_t *) context;
+    }
+    return realloc(ptr, size);
+}
+
+static void plain_release(void *context, void *ptr) {
+    (void) context;
+    free(ptr);
+}
+
+/* Builds small arrays and frees each of them on a thread that does nothing
+ * else. Returns how many blocks the library allocated meanwhile. */
+static size_t build_and_leave(size_t *allocations, bool *ok) {
+    size_t before = *allocations;
+    struct jsonValue *arrays[LEAVERS];
+    for (int i = 0; i < LEAVERS; ++i) {
+        arrays[i] = build_size(i, SMALL);
+        *ok = *ok && arrays[i];
+    }
+    size_t built = *allocations - before;
+    for (int i = 0; i < LEAVERS; ++i) {
+        thrd_t thread;
+        int result = 0;
+        *ok = *ok && thrd_create(&thread, release, arrays[i]) == thrd_success
+                && thrd_join(thread, &result) == thrd_success && result;
+    }
+    return built;
+}
+
+/* Threads that only free give the nodes back when they exit, so building the
+ * same arrays again takes no new slabs, only blocks of array slots. */
+static bool test_leavers(void) {
+    size_t allocations = 0;
+    struct jsonAllocator counting = { counting_allocate, counting_reallocate, plain_release, &allocations };
+    json_exit();
+    bool ok = json_set_allocator(&counting) && json_init();
+    size_t first = build_and_leave(&allocations, &ok);
+    size_t second = build_and_leave(&allocations, &ok);
+    ok = ok && first > LEAVERS && second == LEAVERS;
+    json_exit();
+    return json_set_allocator(NULL) && json_init() && ok;
+}
+
+extern bool test_pool(void) {
+    thrd_t threads[THREADS];
+    int seeds[THREADS];
+    bool ok = true;
+    // Nodes freed by other threads come back through the global pool.
+    for (int i = 0; i < THREADS; ++i) {
+        struct jsonValue *array = build(i);
+        ok = ok && array && thrd_create(&threads[i], release, array) == thrd_success;
+    }
+    for (int i = 0; i < THREADS; ++i) {
+        int result = 0;
+        thrd_join(threads[i], &result);
+        ok = ok && result;
+    }
+    for (int i = 0; i < THREADS; ++i) {
+        seeds[i] = i * VALUES * 10;
+        ok = ok && thrd_create(&threads[i], churn, &seeds[i]) == thrd_success;
+    }
+    for (int i = 0; i < THREADS; ++i) {
+        int result = 0;
+        thrd_join(threads[i], &result);
+        ok = ok && result;
+    }
+    return ok && test_leavers();
+}
@@ -1,5 +1,41 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
-extern bool test_pretty_printer(void) {
+#include <json.h>
+
+static bool prints_as(const char *json, const struct jsonPrintOptions *options, const char *expected) {
+    char buffer[256];
+    struct jsonValue *value = json_parse(json, true);
+    if (!value) {
+        return false;
+    }
+    size_t n = json_print(buffer, sizeof(buffer), value, options);
+    size_t size = json_serialized_size(value, options);
+    json_value_free(value);
+    if (n != strlen(expected) || size != n || strcmp(buffer, expected)) {
+        printf("expected: %s\ngot: %s\n", expected, buffer);
+        return false;
+    }
     return true;
 }
+
+extern bool test_pretty_printer(void) {
+    struct jsonPrintOptions compact = { 0 };
+    struct jsonPrintOptions sorted = { .sort_keys = true, .ascii_only = true };
+    struct jsonPrintOptions spaces = {
+        .pretty = true,
+        .indent_char = ' ',
+        .indent_width = 2,
+        .newline = JSON_NEWLINE_CRLF,
+    };
+    return prints_as("[1, 2.5, \"a/b\\u0001\", true, null, {}, []]", &compact,
+                "[1,2.500000,\"a/b\\u0001\",true,null,{},[]]")
+        && prints_as("{\"b\": 1, \"a\": \"\\u00e9\\ud834\\udd1e\", \"b\": 2}", &sorted,
+                "{\"a\":\"\\u00e9\\ud834\\udd1e\",\"b\":1,\"b\":2}")
+        && prints_as("{\"a\": [1, {}]}", &spaces,
+                "{\r\n  \"a\": [\r\n    1,\r\n    { }\r\n  ]\r\n}")
+        && prints_as("[[]]", NULL, "[\n\t[ ]\n]")
+        && prints_as("[-0.25, 0.9999999, -12, 1e20]", &compact,
+                "[-0.250000,1.000000,-12,100000000000000000000.000000]");
+}
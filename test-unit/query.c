@@ -0,0 +1,160 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#define MAX_MATCHES 16
+#define TEXT_SIZE 256
+
+static const char store[] = "{\"store\": {"
+    "\"book\": ["
+        "{\"category\": \"reference\", \"author\": \"Nigel Rees\", \"title\": \"Sayings\", \"price\": 8.95},"
+        "{\"category\": \"fiction\", \"author\": \"Evelyn Waugh\", \"title\": \"Sword\", \"price\": 12.99},"
+        "{\"category\": \"fiction\", \"author\": \"Herman Melville\", \"title\": \"Moby Dick\", \"isbn\": \"0-553\","
+            " \"price\": 8.99},"
+        "{\"category\": \"fiction\", \"author\": \"J. R. R. Tolkien\", \"title\": \"The Lord\", \"isbn\": \"0-395\","
+            " \"price\": 22.99}"
+    "],"
+    "\"bicycle\": {\"color\": \"red\", \"price\": 19.95}"
+"}}";
+
+static const struct jsonPrintOptions compact = { .sort_keys = true };
+
+/* Compact text of a value, so values can be compared as text. */
+static bool text_of(struct jsonValue *value, char *out) {
+    size_t n = json_print(out, TEXT_SIZE, value, &compact);
+    return n && n < TEXT_SIZE;
+}
+
+static bool text_of_json(const char *json, char *out) {
+    struct jsonValue *value = json_parse(json, true);
+    bool ok = value && text_of(value, out);
+    json_value_free(value);
+    return ok;
+}
+
+/* Checks that both ways of applying the query select the expected values.
+ * Parsing gives them in the order of the text, the order of selecting from a
+ * tree isn't checked. */
+static bool check(const char *document, const char *text, size_t n, const char *const *expected) {
+    char texts[MAX_MATCHES][TEXT_SIZE];
+    bool found[MAX_MATCHES] = { false };
+    struct jsonQuery *query = json_query_compile(text);
+    struct jsonValue *tree = json_parse(document, true);
+    struct jsonValue *matches = query ? json_query_parse(query, document, strlen(document), NULL) : NULL;
+    bool ok = query && tree && matches && json_array_size(matches) == n;
+    for (size_t i = 0; ok && i < n; ++i) {
+        char actual[TEXT_SIZE];
+        ok = text_of_json(expected[i], texts[i]) && text_of(json_array_at(matches, i), actual);
+        ok = ok && !strcmp(texts[i], actual);
+    }
+    struct jsonValue *selected[MAX_MATCHES];
+    ok = ok && json_query_select(query, tree, selected, MAX_MATCHES) == n;
+    for (size_t i = 0; ok && i < n; ++i) {
+        char actual[TEXT_SIZE];
+        ok = text_of(selected[i], actual);
+        size_t j = 0;
+        while (j < n && (found[j] || strcmp(texts[j], actual))) {
+            ++j;
+        }
+        ok = ok && j < n;
+        if (ok) {
+            found[j] = true;
+        }
+    }
+    json_value_free(matches);
+    json_value_free(tree);
+    json_query_free(query);
+    return ok;
+}
+
+#define CHECK(document, query, ...) \
+    check(document, query, sizeof((const char *[]) { __VA_ARGS__ }) / sizeof(const char *), \
+            (const char *[]) { __VA_ARGS__ })
+
+static bool check_none(const char *document, const char *text) {
+    return check(document, text, 0, NULL);
+}
+
+static bool test_children(void) {
+    return CHECK(store, "$.store.bicycle.color", "\"red\"")
+        && CHECK(store, "$['store']['bicycle'][\"price\"]", "19.95")
+        && CHECK(store, "$.store.book[*].author", "\"Nigel Rees\"", "\"Evelyn Waugh\"", "\"Herman Melville\"",
+                "\"J. R. R. Tolkien\"")
+        && CHECK(store, "$.store.bicycle.*", "\"red\"", "19.95")
+        && CHECK("[1, 2]", "$", "[1, 2]")
+        && check_none(store, "$.store.car")
+        && check_none(store, "$.store.book.title")
+        && check_none(store, "$.store[0]");
+}
+
+static bool test_indices(void) {
+    return CHECK(store, "$.store.book[2].title", "\"Moby Dick\"")
+        && CHECK(store, "$.store.book[-1].title", "\"The Lord\"")
+        && CHECK(store, "$.store.book[:2].price", "8.95", "12.99")
+        && CHECK(store, "$.store.book[1:3].price", "12.99", "8.99")
+        && CHECK(store, "$.store.book[-2:].price", "8.99", "22.99")
+        && CHECK("[0, 1, 2, 3, 4, 5]", "$[::2]", "0", "2", "4")
+        && CHECK("[0, 1, 2, 3, 4, 5]", "$[1::3]", "1", "4")
+        && CHECK("[0, 1, 2, 3, 4, 5]", "$[::-2]", "1", "3", "5")
+        && CHECK("[0, 1, 2, 3, 4, 5]", "$[4:1:-1]", "2", "3", "4")
+        && check_none("[0, 1]", "$[2]")
+        && check_none("[0, 1]", "$[-3]");
+}
+
+static bool test_descendants(void) {
+    return CHECK(store, "$..price", "8.95", "12.99", "8.99", "22.99", "19.95")
+        && CHECK(store, "$..book[0].author", "\"Nigel Rees\"")
+        && CHECK(store, "$.store..color", "\"red\"")
+        // Values selected inside of selected values.
+        && CHECK("{\"a\": {\"a\": {\"b\": 1}}, \"c\": [{\"a\": 2}]}", "$..a", "{\"a\": {\"b\": 1}}", "{\"b\": 1}", "2")
+        // Several paths lead to the same value.
+        && CHECK("{\"a\": {\"a\": {\"b\": 1}}}", "$..a..b", "1");
+}
+
+static bool test_filters(void) {
+    return CHECK(store, "$.store.book[?(@.price < 10)].title", "\"Sayings\"", "\"Moby Dick\"")
+        && CHECK(store, "$.store.book[?(@.isbn)].author", "\"Herman Melville\"", "\"J. R. R. Tolkien\"")
+        && CHECK(store, "$.store.book[?(@.category == 'reference')].price", "8.95")
+        && CHECK(store, "$.store.book[?(@['category'] != \"fiction\")].price", "8.95")
+        && CHECK(store, "$..[?(@.color)].price", "19.95")
+        && CHECK("[1, 5, \"5\", true, null, [5]]", "$[?(@ >= 5)]", "5")
+        && CHECK("[1, 5, \"5\", true, null, [5]]", "$[?(@ == null)]", "null")
+        && CHECK("[1, 5, \"5\", true, null, [5]]", "$[?(@[0] == 5)]", "[5]")
+        && CHECK("[{\"a\": [1, 2]}, {\"a\": [3]}]", "$[?(@.a[1])].a", "[1, 2]");
+}
+
+static bool test_syntax(void) {
+    static const char *bad[] = {
+        "", "store", "$.", "$..", "$[", "$[1", "$['a", "$[1:2:0]", "$[?(@.a ==)]", "$[?(@.a == [1])]", "$[?@.a]",
+        "$[?(@.a > 1]", "$.a b", "$[99999999999999999999]",
+    };
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        struct jsonQuery *query = json_query_compile(bad[i]);
+        ok = !query && json_last_error()->code == JSON_ERROR_SYNTAX;
+        json_query_free(query);
+    }
+    ok = ok && !json_query_compile("$.a b") && json_last_error()->offset == 3;
+    return ok;
+}
+
+static bool test_invalid_text(void) {
+    struct jsonQuery *query = json_query_compile("$.a");
+    static const char *bad[] = { "{\"a\": 1, \"b\": [}", "{\"b\": tru, \"a\": 1}", "{\"a\": 1} x", "[1, 2" };
+    bool ok = query;
+    for (size_t i = 0; ok && i < sizeof(bad) / sizeof(*bad); ++i) {
+        ok = !json_query_parse(query, bad[i], strlen(bad[i]), NULL) && json_last_error()->code == JSON_ERROR_SYNTAX;
+    }
+    struct jsonParseOptions options = { .max_depth = 2 };
+    const char *deep = "{\"b\": [[1]], \"a\": 1}";
+    ok = ok && !json_query_parse(query, deep, strlen(deep), &options) && json_last_error()->code == JSON_ERROR_LIMIT;
+    json_query_free(query);
+    return ok;
+}
+
+extern bool test_query(void) {
+    return test_children() && test_indices() && test_descendants() && test_filters() && test_syntax()
+        && test_invalid_text();
+}
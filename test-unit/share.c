@@ -0,0 +1,121 @@
+#include <stdbool.h>
+#include <string.h>
+#include <threads.h>
+
+#include <json.h>
+
+#define THREADS 4
+#define COPY_THREADS 8
+#define COPY_ROUNDS 200
+#define TEXT_SIZE 256
+
+static const char *config = "{\"name\": \"base\", \"limits\": {\"cpu\": 1, \"memory\": 2}, \"tags\": [\"a\", \"b\"]}";
+
+static bool same_text(struct jsonValue *value, const char *expected) {
+    char text[TEXT_SIZE];
+    struct jsonPrintOptions options = { .sort_keys = true };
+    size_t n = json_print(text, TEXT_SIZE, value, &options);
+    return n && n < TEXT_SIZE && !strcmp(text, expected);
+}
+
+static bool test_copy_on_write(void) {
+    struct jsonValue *original = json_parse(config, true);
+    struct jsonValue *copy = original ? json_copy_shared(original) : NULL;
+    bool ok = copy && !json_is_shared(copy) && json_is_shared(json_object_lookup(original, "limits"));
+    // Shared values can't be changed in place.
+    ok = ok && !json_set_number(json_object_lookup(json_object_lookup(copy, "limits"), "cpu"), 8);
+    struct jsonValue *null = json_create_null();
+    ok = ok && !json_array_append(json_object_lookup(copy, "tags"), null);
+    json_value_free(null);
+    struct jsonValue *limits = json_object_lookup_mut(copy, "limits");
+    ok = ok && limits && limits != json_object_lookup(original, "limits");
+    ok = ok && json_set_number(json_object_lookup_mut(limits, "cpu"), 8);
+    // Only the path to the change is copied.
+    ok = ok && json_object_lookup(limits, "memory") == json_object_lookup(json_object_lookup(original, "limits"),
+            "memory");
+    ok = ok && json_object_lookup(copy, "tags") == json_object_lookup(original, "tags");
+    ok = ok && same_text(original, "{\"limits\":{\"cpu\":1,\"memory\":2},\"name\":\"base\",\"tags\":[\"a\",\"b\"]}");
+    ok = ok && same_text(copy, "{\"limits\":{\"cpu\":8,\"memory\":2},\"name\":\"base\",\"tags\":[\"a\",\"b\"]}");
+    // Compaction leaves values shared with the original alone.
+    ok = ok && json_compact(copy) && json_object_lookup(copy, "tags") == json_object_lookup(original, "tags");
+    ok = ok && same_text(copy, "{\"limits\":{\"cpu\":8,\"memory\":2},\"name\":\"base\",\"tags\":[\"a\",\"b\"]}");
+    json_value_free(original);
+    // The last owner gets the values to itself without copying.
+    struct jsonValue *tags = json_object_lookup(copy, "tags");
+    ok = ok && json_object_lookup_mut(copy, "tags") == tags && json_set_string(json_array_at_mut(tags, 1), "c");
+    ok = ok && same_text(copy, "{\"limits\":{\"cpu\":8,\"memory\":2},\"name\":\"base\",\"tags\":[\"a\",\"c\"]}");
+    json_value_free(copy);
+    return ok;
+}
+
+static bool test_setters(void) {
+    struct jsonValue *number = json_create_number(1);
+    struct jsonValue *boolean = json_create_boolean(true);
+    double n = 1;
+    bool b = true;
+    bool ok = json_set_number(number, 0) && json_get_number(number, &n) && n == 0;
+    ok = ok && json_set_boolean(boolean, false) && json_get_boolean(boolean, &b) && !b;
+    json_value_free(number);
+    json_value_free(boolean);
+    return ok;
+}
+
+static int worker(void *arg) {
+    struct jsonValue *copy = json_copy_shared(arg);
+    struct jsonValue *limits = copy ? json_object_lookup_mut(copy, "limits") : NULL;
+    bool ok = limits && json_set_number(json_object_lookup_mut(limits, "cpu"), 4);
+    ok = ok && same_text(copy, "{\"limits\":{\"cpu\":4,\"memory\":2},\"name\":\"base\",\"tags\":[\"a\",\"b\"]}");
+    json_value_free(copy);
+    return ok;
+}
+
+static bool test_threads(void) {
+    struct jsonValue *original = json_parse(config, true);
+    thrd_t threads[THREADS];
+    int started = 0;
+    bool ok = original != NULL;
+    for (; ok && started < THREADS; ++started) {
+        ok = thrd_create(&threads[started], worker, original) == thrd_success;
+    }
+    for (int i = 0; i < started; ++i) {
+        int result = 0;
+        ok = thrd_join(threads[i], &result) == thrd_success && result && ok;
+    }
+    ok = ok && same_text(original, "{\"limits\":{\"cpu\":1,\"memory\":2},\"name\":\"base\",\"tags\":[\"a\",\"b\"]}");
+    json_value_free(original);
+    return ok;
+}
+
+static const char *nested = "{\"a\":[[1,2],{\"b\":[3,{\"c\":[4,5]}]}],\"d\":{\"e\":{\"f\":[6]}},\"g\":\"h\"}";
+
+// Copies and reads the same document while other threads seal it.
+static int copier(void *arg) {
+    bool ok = true;
+    for (int i = 0; ok && i < COPY_ROUNDS; ++i) {
+        struct jsonValue *copy = json_copy_shared(arg);
+        ok = copy && same_text(copy, nested) && same_text(arg, nested);
+        json_value_free(copy);
+    }
+    return ok;
+}
+
+static bool test_copy_threads(void) {
+    struct jsonValue *original = json_parse(nested, true);
+    thrd_t threads[COPY_THREADS];
+    int started = 0;
+    bool ok = original != NULL;
+    for (; ok && started < COPY_THREADS; ++started) {
+        ok = thrd_create(&threads[started], copier, original) == thrd_success;
+    }
+    for (int i = 0; i < started; ++i) {
+        int result = 0;
+        ok = thrd_join(threads[i], &result) == thrd_success && result && ok;
+    }
+    ok = ok && json_is_shared(json_object_lookup(original, "a")) && same_text(original, nested);
+    json_value_free(original);
+    return ok;
+}
+
+extern bool test_share(void) {
+    return test_copy_on_write() && test_setters() && test_threads() && test_copy_threads();
+}
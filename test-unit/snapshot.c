@@ -0,0 +1,71 @@
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <json.h>
+
+#define SAVED_PATH "test-unit-snapshot.tmp"
+
+static const char *text = "{\"a\": [1, \"x\", true, null], \"b\": \"x\", \"a\": -2.5}";
+
+/* Reads the snapshot of the text back and compares it with the parsed value. */
+static bool check_root(struct jsonValue *root, struct jsonValue *value) {
+    struct jsonValue *last = json_object_lookup(root, "a");
+    struct jsonValue *first = json_object_lookup_next(root, "a", last);
+    double number = 0;
+    const char *string = NULL;
+    bool boolean = false;
+    bool ok = json_object_number_of_keys(root) == 2 && json_object_number_of_values(root) == 3
+        && json_get_number(last, &number) && number == -2.5
+        && json_array_size(first) == 4 && !json_object_lookup_next(root, "a", first)
+        && json_get_string(json_array_at(first, 1), &string) && !strcmp(string, "x")
+        && json_get_boolean(json_array_at(first, 2), &boolean) && boolean
+        && !json_object_lookup(root, "c") && !json_set_number(last, 1);
+    struct jsonPrintOptions options = { .sort_keys = true };
+    char expected[128], copied[128];
+    struct jsonValue *copy = json_copy(root);
+    ok = ok && copy && json_print(expected, sizeof(expected), value, &options)
+        && json_print(copied, sizeof(copied), copy, &options) && !strcmp(expected, copied);
+    json_value_free(copy);
+    return ok;
+}
+
+/* Snapshot values can't become children of other values without a copy. */
+static bool check_adopt(struct jsonValue *root) {
+    struct jsonValue *array = json_create_array(1);
+    struct jsonValue *object = json_create_object(1);
+    bool ok = array && object
+        && !json_array_append(array, root) && json_last_error()->code == JSON_ERROR_READ_ONLY
+        && !json_object_add(object, "a", json_object_lookup(root, "b"))
+        && json_last_error()->code == JSON_ERROR_READ_ONLY
+        && json_array_size(array) == 0 && json_object_number_of_values(object) == 0;
+    json_value_free(array);
+    json_value_free(object);
+    return ok;
+}
+
+static bool test_memory(struct jsonValue *value) {
+    static alignas(8) unsigned char buffer[1024];
+    size_t size = json_snapshot_encode(NULL, 0, value);
+    bool ok = size && size <= sizeof(buffer) && json_snapshot_encode(buffer, sizeof(buffer), value) == size;
+    struct jsonSnapshot *snapshot = ok ? json_snapshot_open_mem(buffer, size) : NULL;
+    ok = snapshot && check_root(json_snapshot_root(snapshot), value) && check_adopt(json_snapshot_root(snapshot));
+    json_snapshot_close(snapshot);
+    return ok && !json_snapshot_open_mem(buffer, 8);
+}
+
+static bool test_file(struct jsonValue *value) {
+    struct jsonSnapshot *snapshot = json_snapshot_save(SAVED_PATH, value) ? json_snapshot_open(SAVED_PATH) : NULL;
+    bool ok = snapshot && check_root(json_snapshot_root(snapshot), value);
+    json_snapshot_close(snapshot);
+    remove(SAVED_PATH);
+    return ok;
+}
+
+extern bool test_snapshot(void) {
+    struct jsonValue *value = json_parse(text, true);
+    bool ok = value && test_memory(value) && test_file(value);
+    json_value_free(value);
+    return ok;
+}
@@ -10,5 +10,24 @@ bool test_utf(void);
 bool test_string(void);
 bool test_parser(void);
 bool test_pretty_printer(void);
+bool test_binary(void);
+bool test_snapshot(void);
+bool test_writer(void);
+bool test_allocator(void);
+bool test_pool(void);
+bool test_track(void);
+bool test_usage(void);
+bool test_compact(void);
+bool test_share(void);
+bool test_copy(void);
+bool test_error(void);
+bool test_pointer(void);
+bool test_query(void);
+bool test_filter(void);
+bool test_bind(void);
+bool test_patch(void);
+bool test_diff(void);
+bool test_hash(void);
+bool test_intern(void);
 
 #endif
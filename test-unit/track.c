@@ -0,0 +1,28 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <json.h>
+
+#define SITES 64
+
+extern bool test_track(void) {
+    struct jsonAllocationSite sites[SITES];
+    struct jsonValue *value = json_parse("{\"key\": \"value\"}", true);
+    size_t n = json_allocation_sites(sites, SITES);
+    bool ok = value != NULL;
+#ifndef RELEASE
+    // Debug builds track every allocation from the start.
+    bool string_site = false;
+    for (size_t i = 0; i < n && i < SITES; ++i) {
+        string_site = string_site || (strstr(sites[i].file, "string.c") && sites[i].live_blocks);
+    }
+    ok = ok && n && string_site && json_track_allocations(4) && !json_track_allocations(0)
+        && json_track_allocations(1);
+#else
+    // Tracking can't be switched on once memory was allocated without it.
+    ok = ok && !n && !json_track_allocations(1) && json_track_allocations(0);
+#endif
+    json_value_free(value);
+    return ok;
+}
@@ -0,0 +1,46 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <json.h>
+
+static bool test_tree(void) {
+    struct jsonValue *value = json_parse("{\"a\": \"xyz\", \"bc\": [1, 2]}", true);
+    struct jsonMemoryUsage usage;
+    bool ok = value && json_memory_usage(value, &usage);
+    size_t entries = json_object_capacity(value) * (sizeof(unsigned long long) + 2 * sizeof(void *));
+    ok = ok && usage.nodes == 5 && usage.keys == 2;
+    ok = ok && usage.string_bytes == sizeof("a") + sizeof("xyz") + sizeof("bc");
+    ok = ok && usage.array_bytes == 2 * sizeof(void *);
+    ok = ok && usage.entry_bytes + usage.entry_empty_bytes + usage.entry_deleted_bytes == entries;
+    ok = ok && usage.entry_bytes == 2 * entries / json_object_capacity(value);
+    // text of the string and the keys, entries of the object and the array
+    ok = ok && usage.allocations == 5;
+    ok = ok && usage.total_bytes == usage.node_bytes + usage.key_bytes + usage.string_bytes
+        + usage.string_unused_bytes + usage.array_bytes + usage.array_unused_bytes + entries;
+    json_value_free(value);
+    return ok;
+}
+
+static bool test_growth(void) {
+    struct jsonValue *array = json_create_array(4);
+    bool ok = array && json_array_append(array, json_create_null());
+    struct jsonMemoryUsage usage;
+    ok = ok && json_memory_usage(array, &usage);
+    ok = ok && usage.nodes == 2 && usage.array_bytes == sizeof(void *)
+        && usage.array_unused_bytes == 3 * sizeof(void *);
+    json_value_free(array);
+    return ok;
+}
+
+static bool test_errors(void) {
+    struct jsonMemoryUsage usage;
+    struct jsonValue *value = json_create_number(1);
+    bool ok = !json_memory_usage(NULL, &usage) && !json_memory_usage(value, NULL);
+    ok = ok && json_memory_usage(value, &usage) && usage.total_bytes == usage.node_bytes && !usage.allocations;
+    json_value_free(value);
+    return ok;
+}
+
+extern bool test_usage(void) {
+    return test_tree() && test_growth() && test_errors();
+}
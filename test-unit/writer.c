@@ -0,0 +1,83 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <json.h>
+
+static const char expected_text[] = "{\"id\":7,\"tags\":[\"a\\\"b\",true,null],\"empty\":{},\"tree\":[1,2]}";
+
+static bool write_document(struct jsonWriter *writer, struct jsonValue *tree) {
+    return json_writer_begin_object(writer)
+        && json_writer_key(writer, "id") && json_writer_number(writer, 7)
+        && json_writer_key(writer, "tags") && json_writer_begin_array(writer)
+        && json_writer_string(writer, "a\"b") && json_writer_boolean(writer, true) && json_writer_null(writer)
+        && json_writer_end_array(writer)
+        && json_writer_key(writer, "empty") && json_writer_begin_object(writer) && json_writer_end_object(writer)
+        && json_writer_key(writer, "tree") && json_writer_value(writer, tree)
+        && json_writer_end_object(writer);
+}
+
+struct chunks {
+    char text[256];
+    size_t size;
+    size_t calls;
+};
+
+static bool collect(void *context, const char *data, size_t size) {
+    struct chunks *chunks = context;
+    if (chunks->size + size >= sizeof(chunks->text)) {
+        return false;
+    }
+    memcpy(chunks->text + chunks->size, data, size);
+    chunks->size += size;
+    ++chunks->calls;
+    return true;
+}
+
+static bool writes_like_printer(struct jsonValue *tree) {
+    static const char pretty_text[] = "{\n\t\"id\": 7,\n\t\"tags\": [\n\t\t\"a\\\"b\",\n\t\ttrue,\n\t\tnull\n\t],"
+        "\n\t\"empty\": { },\n\t\"tree\": [\n\t\t1,\n\t\t2\n\t]\n}";
+    char text[256];
+    struct jsonPrintOptions compact = { 0 };
+    struct jsonWriter *writer = json_writer_create(text, sizeof(text), NULL, true);
+    bool ok = write_document(writer, tree);
+    ok = json_writer_finish(writer) == strlen(pretty_text) && ok && !strcmp(text, pretty_text);
+    writer = json_writer_create(text, sizeof(text), &compact, true);
+    ok = ok && write_document(writer, tree) && json_writer_finish(writer) == strlen(expected_text)
+        && !strcmp(text, expected_text);
+    return ok;
+}
+
+static bool writes_to_sink(struct jsonValue *tree) {
+    struct chunks chunks = { .size = 0, .calls = 0 };
+    struct jsonPrintOptions compact = { 0 };
+    struct jsonWriter *writer = json_writer_create_sink(collect, &chunks, &compact, false);
+    bool ok = write_document(writer, tree);
+    ok = json_writer_finish(writer) == strlen(expected_text) && ok;
+    return ok && chunks.calls == 1 && chunks.size == strlen(expected_text)
+        && !memcmp(chunks.text, expected_text, chunks.size);
+}
+
+static bool rejects_misuse(void) {
+    struct jsonWriter *writer = json_writer_create(NULL, 0, NULL, true);
+    bool ok = json_writer_begin_object(writer) && !json_writer_number(writer, 1) && !json_writer_key(writer, "a")
+        && !json_writer_finish(writer);
+    writer = json_writer_create(NULL, 0, NULL, true);
+    ok = ok && json_writer_begin_array(writer) && !json_writer_key(writer, "a") && !json_writer_finish(writer);
+    writer = json_writer_create(NULL, 0, NULL, true);
+    ok = ok && json_writer_begin_array(writer) && !json_writer_end_object(writer) && !json_writer_finish(writer);
+    writer = json_writer_create(NULL, 0, NULL, true);
+    ok = ok && json_writer_null(writer) && !json_writer_null(writer) && !json_writer_finish(writer);
+    writer = json_writer_create(NULL, 0, NULL, true);
+    ok = ok && !json_writer_string(writer, "\xC0\x80") && !json_writer_finish(writer);
+    writer = json_writer_create(NULL, 0, NULL, true);
+    ok = ok && json_writer_begin_array(writer) && !json_writer_finish(writer);
+    return ok;
+}
+
+extern bool test_writer(void) {
+    struct jsonValue *tree = json_parse("[1, 2]", true);
+    bool ok = tree && writes_like_printer(tree) && writes_to_sink(tree) && rejects_misuse();
+    json_value_free(tree);
+    return ok;
+}